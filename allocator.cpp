@@ -0,0 +1,228 @@
+#include <atomic>
+#include <new>
+#include <cassert>
+#include <cstdlib>
+#include "allocator.hpp"
+
+namespace BwTree {
+
+    namespace {
+        // multiples of the cache line size above 64 bytes, so larger nodes are cache line aligned inside their slab
+        constexpr std::size_t sizeClasses[] = {16, 32, 48, 64, 128, 192, 256, 320, 384, 448, 512, 640, 768, 896, 1024,
+                                               1280, 1536, 1792, 2048, 2560, 3072, 3584, 4096, 5120, 6144, 7168, 8192,
+                                               10240, 12288, 14336, 16384, 20480, 24576, 28672, 32768, 40960, 49152, 57344, 65536};
+        constexpr std::size_t sizeClassCount = sizeof(sizeClasses) / sizeof(sizeClasses[0]);
+        constexpr std::size_t noSizeClass = sizeClassCount;
+        constexpr std::size_t maxSmallSize = 1024;
+        // the first cache line of a slab holds its header
+        constexpr std::size_t slabHeaderSize = NodeAllocator::alignment;
+        // number of objects freed for another thread before they are handed back
+        constexpr std::size_t remoteBatchSize = 64;
+        constexpr std::size_t remoteBatchSlots = 8;
+
+        struct SmallSizeClassTable {
+            std::uint8_t table[maxSmallSize / 16 + 1];
+
+            constexpr SmallSizeClassTable() : table() {
+                std::size_t sizeClass = 0;
+                for (std::size_t i = 0; i <= maxSmallSize / 16; ++i) {
+                    while (sizeClasses[sizeClass] < i * 16) {
+                        ++sizeClass;
+                    }
+                    table[i] = static_cast<std::uint8_t>(sizeClass);
+                }
+            }
+        };
+
+        constexpr SmallSizeClassTable smallSizeClasses;
+
+        std::size_t sizeClassOf(std::size_t size) {
+            if (size <= maxSmallSize) {
+                return smallSizeClasses.table[(size + 15) / 16];
+            }
+            std::size_t sizeClass = smallSizeClasses.table[maxSmallSize / 16];
+            while (sizeClass < sizeClassCount && sizeClasses[sizeClass] < size) {
+                ++sizeClass;
+            }
+            return sizeClass;
+        }
+
+        struct FreeObject {
+            FreeObject *next;
+        };
+
+        struct ThreadCache {
+            FreeObject *freeLists[sizeClassCount] = {};
+            char *bump[sizeClassCount] = {};
+            char *bumpEnd[sizeClassCount] = {};
+            std::atomic<FreeObject *> remoteFrees[sizeClassCount];
+            std::atomic<bool> inUse{true};
+            ThreadCache *nextCache = nullptr;
+
+            ThreadCache() {
+                for (auto &remote : remoteFrees) {
+                    remote.store(nullptr, std::memory_order_relaxed);
+                }
+            }
+        };
+
+        struct SlabHeader {
+            ThreadCache *owner;
+            std::size_t sizeClass;
+        };
+
+        struct RemoteBatch {
+            ThreadCache *owner = nullptr;
+            std::size_t sizeClass = 0;
+            FreeObject *head = nullptr;
+            FreeObject *tail = nullptr;
+            std::size_t count = 0;
+
+            void flush() {
+                if (count == 0) {
+                    return;
+                }
+                std::atomic<FreeObject *> &remote = owner->remoteFrees[sizeClass];
+                FreeObject *remoteHead = remote.load(std::memory_order_relaxed);
+                do {
+                    tail->next = remoteHead;
+                } while (!remote.compare_exchange_weak(remoteHead, head, std::memory_order_release, std::memory_order_relaxed));
+                head = tail = nullptr;
+                count = 0;
+            }
+        };
+
+        std::atomic<ThreadCache *> cacheRegistry{nullptr};
+        std::atomic<std::size_t> slabBytesTotal{0};
+
+        ThreadCache *acquireCache() {
+            for (ThreadCache *cache = cacheRegistry.load(std::memory_order_acquire); cache != nullptr; cache = cache->nextCache) {
+                bool expected = false;
+                if (!cache->inUse.load(std::memory_order_relaxed) && cache->inUse.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+                    return cache;
+                }
+            }
+            ThreadCache *cache = new ThreadCache();
+            ThreadCache *head = cacheRegistry.load(std::memory_order_relaxed);
+            do {
+                cache->nextCache = head;
+            } while (!cacheRegistry.compare_exchange_weak(head, cache, std::memory_order_release, std::memory_order_relaxed));
+            return cache;
+        }
+
+        struct ThreadState {
+            ThreadCache *cache = nullptr;
+            RemoteBatch remoteBatches[remoteBatchSlots];
+            std::uint64_t allocations = 0;
+
+            ThreadCache *getCache() {
+                if (cache == nullptr) {
+                    cache = acquireCache();
+                }
+                return cache;
+            }
+
+            void flushRemoteFrees() {
+                for (auto &batch : remoteBatches) {
+                    batch.flush();
+                }
+            }
+
+            ~ThreadState() {
+                flushRemoteFrees();
+                if (cache != nullptr) {
+                    cache->inUse.store(false, std::memory_order_release);
+                }
+            }
+        };
+
+        thread_local ThreadState threadState;
+
+        void *allocateSlab(ThreadCache *cache, std::size_t sizeClass) {
+            void *mem;
+            if (posix_memalign(&mem, NodeAllocator::slabSize, NodeAllocator::slabSize) != 0) {
+                throw std::bad_alloc();
+            }
+            slabBytesTotal.fetch_add(NodeAllocator::slabSize, std::memory_order_relaxed);
+            SlabHeader *header = static_cast<SlabHeader *>(mem);
+            header->owner = cache;
+            header->sizeClass = sizeClass;
+            return mem;
+        }
+    }
+
+    void *NodeAllocator::allocate(std::size_t size) {
+        threadState.allocations++;
+        const std::size_t sizeClass = sizeClassOf(size);
+        if (sizeClass == noSizeClass) {
+            void *mem;
+            if (posix_memalign(&mem, alignment, (size + alignment - 1) & ~(alignment - 1)) != 0) {
+                throw std::bad_alloc();
+            }
+            return mem;
+        }
+        ThreadCache *cache = threadState.getCache();
+        FreeObject *object = cache->freeLists[sizeClass];
+        if (object != nullptr) {
+            cache->freeLists[sizeClass] = object->next;
+            return object;
+        }
+        if (cache->remoteFrees[sizeClass].load(std::memory_order_relaxed) != nullptr) {
+            object = cache->remoteFrees[sizeClass].exchange(nullptr, std::memory_order_acquire);
+            cache->freeLists[sizeClass] = object->next;
+            return object;
+        }
+        const std::size_t objectSize = sizeClasses[sizeClass];
+        if (cache->bump[sizeClass] + objectSize > cache->bumpEnd[sizeClass]) {
+            char *slab = static_cast<char *>(allocateSlab(cache, sizeClass));
+            cache->bump[sizeClass] = slab + slabHeaderSize;
+            cache->bumpEnd[sizeClass] = slab + slabSize;
+        }
+        void *mem = cache->bump[sizeClass];
+        cache->bump[sizeClass] += objectSize;
+        return mem;
+    }
+
+    void NodeAllocator::deallocate(void *ptr, std::size_t size) {
+        const std::size_t sizeClass = sizeClassOf(size);
+        if (sizeClass == noSizeClass) {
+            free(ptr);
+            return;
+        }
+        SlabHeader *slab = reinterpret_cast<SlabHeader *>(reinterpret_cast<std::uintptr_t>(ptr) & ~(slabSize - 1));
+        assert(slab->sizeClass == sizeClass);
+        FreeObject *object = static_cast<FreeObject *>(ptr);
+        ThreadCache *owner = slab->owner;
+        if (owner == threadState.cache) {
+            object->next = owner->freeLists[sizeClass];
+            owner->freeLists[sizeClass] = object;
+            return;
+        }
+        RemoteBatch &batch = threadState.remoteBatches[(reinterpret_cast<std::uintptr_t>(owner) / sizeof(ThreadCache) + sizeClass) % remoteBatchSlots];
+        if (batch.owner != owner || batch.sizeClass != sizeClass) {
+            batch.flush();
+            batch.owner = owner;
+            batch.sizeClass = sizeClass;
+        }
+        object->next = batch.head;
+        batch.head = object;
+        if (batch.tail == nullptr) {
+            batch.tail = object;
+        }
+        if (++batch.count == remoteBatchSize) {
+            batch.flush();
+        }
+    }
+
+    void NodeAllocator::flushRemoteFrees() {
+        threadState.flushRemoteFrees();
+    }
+
+    std::uint64_t NodeAllocator::threadAllocations() {
+        return threadState.allocations;
+    }
+
+    std::size_t NodeAllocator::slabBytes() {
+        return slabBytesTotal.load(std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,49 @@
+#ifndef ALLOCATOR_HPP
+#define ALLOCATOR_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+namespace BwTree {
+
+    /**
+    * Size class based allocator for tree nodes.
+    *
+    * Every thread allocates from its own cache of 1 MB slabs, one free list and bump pointer per size class, so allocations
+    * need no synchronization. A slab belongs to the cache which carved it, the owner is found by masking the object address.
+    * Objects freed by another thread (typically the thread which reclaimed a retired delta chain) are collected in small
+    * per owner batches and handed back to the owning cache with a single CAS per batch.
+    *
+    * Objects of 64 bytes and more are 64 byte aligned, objects larger than the biggest size class are allocated from the heap.
+    * A cache is handed to a new thread when its thread exits, slabs are never returned to the operating system.
+    */
+    class NodeAllocator {
+    public:
+        static constexpr std::size_t slabSize = 1024 * 1024;
+        static constexpr std::size_t alignment = 64;
+
+        static void *allocate(std::size_t size);
+
+        /**
+        * size has to be the size which was passed to allocate
+        */
+        static void deallocate(void *ptr, std::size_t size);
+
+        /**
+        * hands all objects of other threads which were freed by this thread back to their owners
+        */
+        static void flushRemoteFrees();
+
+        /**
+        * number of allocations done by the calling thread
+        */
+        static std::uint64_t threadAllocations();
+
+        /**
+        * memory reserved for slabs by all threads
+        */
+        static std::size_t slabBytes();
+    };
+}
+
+#endif
@@ -6,69 +6,76 @@
 namespace BwTree {
 
     template<typename Key, typename Data>
-    FindDataPageResult<Key, Data>::FindDataPageResult(PID const pid, Node<Key, Data> *startNode, Node<Key, Data> const *dataNode, PID const needConsolidatePage, PID const needSplitPage, PID const needSplitPageParent)
+    FindDataPageResult<Key, Data>::FindDataPageResult(PID const pid, Node<Key, Data> *startNode, Node<Key, Data> const *dataNode, PID const needConsolidatePage, PID const needSplitPage, PID const needSplitPageParent, std::uint64_t const lsn)
             : pid(pid),
               startNode(startNode),
               dataNode(dataNode),
               needConsolidatePage(needConsolidatePage),
               needSplitPage(needSplitPage),
-              needSplitPageParent(needSplitPageParent) {
+              needSplitPageParent(needSplitPageParent),
+              lsn(lsn) {
     }
 
     template<typename Key, typename Data>
-    FindDataPageResult<Key, Data>::FindDataPageResult(PID const pid, Node<Key, Data> *startNode, Node<Key, Data> const *dataNode, Data const *data, PID const needConsolidatePage, PID const needSplitPage, PID const needSplitPageParent)
+    FindDataPageResult<Key, Data>::FindDataPageResult(PID const pid, Node<Key, Data> *startNode, Node<Key, Data> const *dataNode, Data const *data, PID const needConsolidatePage, PID const needSplitPage, PID const needSplitPageParent, std::uint64_t const lsn)
             : pid(pid),
               startNode(startNode),
               dataNode(dataNode),
               data(data),
               needConsolidatePage(needConsolidatePage),
               needSplitPage(needSplitPage),
-              needSplitPageParent(needSplitPageParent) {
+              needSplitPageParent(needSplitPageParent),
+              lsn(lsn) {
     }
 
     template<typename Key, typename Data>
-    Data *Tree<Key, Data>::search(Key key, ThreadInfo<Key, Data> &threadInfo) {
+    SearchResult<Data> Tree<Key, Data>::search(Key key, ThreadInfo<Key, Data> &threadInfo) {
         EpocheGuard<Key, Data> epoqueGuard(threadInfo);
         FindDataPageResult<Key, Data> res = findDataPage(key);
-        Data *returnValue;
-        if (res.dataNode == nullptr) {
-            returnValue = nullptr;
-        } else {
-            returnValue = const_cast<Data *>(res.data);
-        }
-        if (res.needSplitPage != NotExistantPID) {
-            splitPage(res.needSplitPage, res.needSplitPageParent);
-        } else if (res.needConsolidatePage != NotExistantPID) {
-            consolidatePage(res.needConsolidatePage, threadInfo);
+        SearchResult<Data> returnValue;
+        if (res.dataNode != nullptr) {
+            returnValue = SearchResult<Data>(res.data);
         }
+        smoPolicy->observeRead();
+        executeSMO(res, threadInfo);
         return returnValue;
     }
 
     template<typename Key, typename Data>
-    template<typename T>
-    size_t Tree<Key, Data>::binarySearch(T array, std::size_t length, Key key) {
-        //std cpp code lower_bound
-        std::size_t first = 0;
-        std::size_t i;
-        std::size_t count, step;
-        count = length;
-        while (count > 0) {
-            i = first;
-            step = count / 2;
-            i += step;
-            if (array[i].key < key) {
-                first = ++i;
-                count -= step + 1;
-            } else {
-                count = step;
+    bool Tree<Key, Data>::lookup(Key key, Data &value, ThreadInfo<Key, Data> &threadInfo) {
+        EpocheGuard<Key, Data> epoqueGuard(threadInfo);
+        FindDataPageResult<Key, Data> res = findDataPage(key);
+        const bool found = res.dataNode != nullptr;
+        if (found) {
+            value = *res.data;
+        }
+        smoPolicy->observeRead();
+        executeSMO(res, threadInfo);
+        return found;
+    }
+
+    template<typename Key, typename Data>
+    size_t Tree<Key, Data>::binarySearch(const Key *keys, std::size_t length, const Key &key, std::uint32_t prefixLength) {
+        if (KeyTraits<Key>::variableLength && prefixLength > 0) {
+            int cmp = KeyTraits<Key>::comparePrefix(key, keys[0], prefixLength);
+            if (cmp < 0) {
+                return 0;
+            } else if (cmp > 0) {
+                return length;
             }
         }
-        return first;
+        if (KeyTraits<Key>::variableLength) {
+            return lowerBoundScalar(keys, length, key, [prefixLength](const Key &a, const Key &b) {
+                return KeyTraits<Key>::less(a, b, prefixLength);
+            });
+        }
+        return SearchKernel<Key>::lowerBound(keys, length, key);
     }
 
     template<typename Key, typename Data>
-    FindDataPageResult<Key, Data> Tree<Key, Data>::findDataPage(Key key) {
+    FindDataPageResult<Key, Data> Tree<Key, Data>::findDataPage(Key key, const Key **separator) {
         PID nextPID = root;
+        const Key *parentSeparator = nullptr;
         std::size_t debugTMPCheck = 0;
         PID needConsolidatePage = NotExistantPID;
         PID needSplitPage = NotExistantPID;
@@ -92,16 +99,17 @@ namespace BwTree {
                 ++pageDepth;
                 assert(pageDepth < 10000);
                 if (needConsolidatePage == NotExistantPID && (
-                        (pageDepth == settings.getConsolidateLimitInner(level) && this->rand(this->d) - level < 40)
+                        (pageDepth == smoPolicy->getConsolidateLimitInner(level) && smoPolicy->tryInnerConsolidate(level))
                 )) {//TODO save for later
                     needConsolidatePage = nextPID;
                 }
                 switch (nextNode->getType()) {
                     case PageType::deltaIndex: {
                         auto node1 = static_cast<DeltaIndex<Key, Data> *>(nextNode);
-                        if (key > node1->keyLeft && key <= node1->keyRight) {
+                        if (key > node1->keyLeft && (node1->keyRightInfinity || key <= node1->keyRight)) {
                             level++;
                             parent = nextPID;
+                            parentSeparator = node1->keyRightInfinity ? nullptr : &node1->keyRight;
                             doNotSplit = false;
                             nextPID = node1->child;
                             nextNode = nullptr;
@@ -114,12 +122,13 @@ namespace BwTree {
                     };
                     case PageType::inner: {
                         auto node1 = static_cast<InnerNode<Key, Data> *>(nextNode);
-                        if (!doNotSplit && (node1->nodeCount + deltaNodeCount - removedBySplit) > settings.getSplitLimitInner(level) && needSplitPage == NotExistantPID && this->rand(this->d) - level * 5 < 30) {
+                        if (!doNotSplit && (node1->nodeCount + deltaNodeCount - removedBySplit) > smoPolicy->getSplitLimitInner(level) && needSplitPage == NotExistantPID && smoPolicy->tryInnerSplit(level)) {
                             if (DEBUG) std::cout << "inner count" << node1->nodeCount << " " << deltaNodeCount << " " << removedBySplit;
                             needSplitPage = nextPID;
                             needSplitPageParent = parent;
                         }
-                        auto res = binarySearch<decltype(node1->nodes)>(node1->nodes, node1->nodeCount, key);
+                        // the infinity element is found if the key is larger than all separators
+                        auto res = binarySearch(node1->keys(), node1->separatorCount(), key, node1->prefixLength);
                         if (res == node1->nodeCount) {
                             assert(node1->next != NotExistantPID);
 
@@ -128,8 +137,9 @@ namespace BwTree {
                         } else {
                             level++;
                             parent = nextPID;
+                            parentSeparator = res < node1->separatorCount() ? &node1->keys()[res] : nullptr;
                             doNotSplit = false;
-                            nextPID = node1->nodes[res].pid;
+                            nextPID = node1->children()[res];
                         }
                         nextNode = nullptr;
                         continue;
@@ -155,7 +165,16 @@ namespace BwTree {
             }
         }
 
+        if (separator != nullptr) {
+            *separator = parentSeparator;
+        }
+
         // Handle leaf
+        // a record is logged with an LSN above those of all leaves passed, its key may have been on any of them before
+        std::uint64_t lsn = 0;
+        const std::uint64_t keyFilterBits = DeltaSummary<Key, Data>::filterBits(key);
+        // one draw decides for the whole walk whether it is recorded in the histograms and summary counters
+        const bool sampled = SMOPolicy::random() % histogramSampleRate == 0;
         while (nextPID != NotExistantPID) {
             if (debugTMPCheck++ > 50000) {
                 assert(false);
@@ -163,31 +182,54 @@ namespace BwTree {
             }
             std::size_t pageDepth = 0;
             Node<Key, Data> *startNode = PIDToNodePtr(nextPID);
+            lsn = std::max(lsn, startNode->getLSN());
+            if (pageStore) {
+                mapping.setReferenced(nextPID);
+            }
             Node<Key, Data> *nextNode = startNode;
             long deltaNodeCount = 0;
             long removedBySplit = 0;
             while (nextNode != nullptr) {
                 ++pageDepth;
                 assert(pageDepth < 10000);
-                if (needConsolidatePage == NotExistantPID && pageDepth == settings.getConsolidateLimitLeaf()) {
-                    //TODO save for later asynchrounous consolidate
+                if (RecordDelta<Key, Data>::isRecordDelta(nextNode)) {
+                    // a key which is in none of the record deltas above the next split delta or the leaf skips all of them
+                    const DeltaSummary<Key, Data> &summary = static_cast<RecordDelta<Key, Data> *>(nextNode)->summary;
+                    const bool skip = !summary.mayContain(key, keyFilterBits);
+                    if (sampled) {
+                        ++deltaSummaryChecks;
+                        if (skip) {
+                            ++deltaSummarySkips;
+                        }
+                    }
+                    if (skip) {
+                        deltaNodeCount += summary.recordCount;
+                        pageDepth += summary.depth;
+                        nextNode = summary.base;
+                    }
+                }
+                if (needConsolidatePage == NotExistantPID && pageDepth >= smoPolicy->getConsolidateLimitLeaf()) {
                     needConsolidatePage = nextPID;
                 }
                 switch (nextNode->getType()) {
                     case PageType::leaf: {
                         auto node1 = static_cast<Leaf<Key, Data> *>(nextNode);
-                        if (!doNotSplit && node1->recordCount + deltaNodeCount - removedBySplit > settings.getSplitLimitLeaf() && needSplitPage == NotExistantPID) {
+                        if (sampled) {
+                            deltaChainLength.record(pageDepth - 1);
+                            treeHeight.record(level + 1);
+                        }
+                        if (!doNotSplit && node1->recordCount + deltaNodeCount - removedBySplit > smoPolicy->getSplitLimitLeaf() && needSplitPage == NotExistantPID) {
                             if (DEBUG) std::cout << "leaf count" << node1->recordCount << " " << deltaNodeCount << " " << removedBySplit;
                             needSplitPage = nextPID;
                             needSplitPageParent = parent;
                         }
-                        auto res = binarySearch<decltype(node1->records)>(node1->records, node1->recordCount, key);
+                        auto res = binarySearch(node1->keys(), node1->recordCount, key, node1->prefixLength);
                         if (res < node1->recordCount) {
-                            if (node1->records[res].key == key) {
+                            if (node1->keys()[res] == key) {
                                 return FindDataPageResult<Key, Data>(nextPID, startNode, nextNode,
-                                                                     node1->records[res].data,
+                                                                     node1->data(res),
                                                                      needConsolidatePage, needSplitPage,
-                                                                     needSplitPageParent);
+                                                                     needSplitPageParent, lsn);
                             }
                         } else if (node1->next != NotExistantPID) {
                             doNotSplit = true;
@@ -195,22 +237,36 @@ namespace BwTree {
                             nextNode = nullptr;
                             continue;
                         }
-                        return FindDataPageResult<Key, Data>(nextPID, startNode, nullptr, needConsolidatePage, needSplitPage, needSplitPageParent);
+                        return FindDataPageResult<Key, Data>(nextPID, startNode, nullptr, needConsolidatePage, needSplitPage, needSplitPageParent, lsn);
                     };
                     case PageType::deltaInsert: {
                         auto node1 = static_cast<DeltaInsert<Key, Data> *>(nextNode);
                         if (node1->record.key == key) {
-                            return FindDataPageResult<Key, Data>(nextPID, startNode, nextNode, node1->record.data, needConsolidatePage, needSplitPage, needSplitPageParent);
+                            return FindDataPageResult<Key, Data>(nextPID, startNode, nextNode, node1->record.data(), needConsolidatePage, needSplitPage, needSplitPageParent, lsn);
                         }
                         deltaNodeCount++;
                         nextNode = node1->origin;
                         assert(nextNode != nullptr);
                         continue;
                     };
+                    case PageType::deltaInsertBatch: {
+                        auto node1 = static_cast<DeltaInsertBatch<Key, Data> *>(nextNode);
+                        auto end = node1->records + node1->recordCount;
+                        auto record = std::lower_bound(node1->records, end, key, [](const KeyValue<Key, Data> &record, const Key &key) {
+                            return record.key < key;
+                        });
+                        if (record != end && record->key == key) {
+                            return FindDataPageResult<Key, Data>(nextPID, startNode, nextNode, record->data(), needConsolidatePage, needSplitPage, needSplitPageParent, lsn);
+                        }
+                        deltaNodeCount += node1->recordCount;
+                        nextNode = node1->origin;
+                        assert(nextNode != nullptr);
+                        continue;
+                    };
                     case PageType::deltaDelete: {
                         auto node1 = static_cast<DeltaDelete<Key, Data> *>(nextNode);
                         if (node1->key == key) {
-                            return FindDataPageResult<Key, Data>(nextPID, startNode, nullptr, needConsolidatePage, needSplitPage, needSplitPageParent);
+                            return FindDataPageResult<Key, Data>(nextPID, startNode, nullptr, needConsolidatePage, needSplitPage, needSplitPageParent, lsn);
                         }
                         deltaNodeCount--;
                         nextNode = node1->origin;
@@ -239,11 +295,34 @@ namespace BwTree {
         }
 
         assert(false); // I think this should not happen
-        return FindDataPageResult<Key, Data>(NotExistantPID, nullptr, nullptr, needConsolidatePage, needSplitPage, needSplitPageParent);
+        return FindDataPageResult<Key, Data>(NotExistantPID, nullptr, nullptr, needConsolidatePage, needSplitPage, needSplitPageParent, lsn);
+    }
+
+    template<typename Key, typename Data>
+    const Key *Tree<Key, Data>::getLeafUpperBound(Node<Key, Data> *startNode, const Key *separator) {
+        const Key *upperBound = separator;
+        auto lowerBound = [&upperBound](const Key &key) {
+            if (upperBound == nullptr || key < *upperBound) {
+                upperBound = &key;
+            }
+        };
+        Node<Key, Data> *node = startNode;
+        while (node->getType() != PageType::leaf) {
+            if (node->getType() == PageType::deltaSplit) {
+                lowerBound(static_cast<DeltaSplit<Key, Data> *>(node)->key);
+            }
+            node = static_cast<DeltaNode<Key, Data> *>(node)->origin;
+        }
+        // larger keys are routed to the next leaf
+        auto leaf = static_cast<Leaf<Key, Data> *>(node);
+        if (leaf->next != NotExistantPID && leaf->recordCount > 0) {
+            lowerBound(leaf->keys()[leaf->recordCount - 1]);
+        }
+        return upperBound;
     }
 
     template<typename Key, typename Data>
-    std::tuple<PID, Node<Key, Data> *> Tree<Key, Data>::findInnerNodeOnLevel(PID pid, const Key key) {
+    std::tuple<PID, Node<Key, Data> *> Tree<Key, Data>::findInnerNodeOnLevel(PID pid, const Key key, bool keyIsInfinity) {
         PID nextPID = pid;
         std::size_t debugTMPCheck = 0;
         while (nextPID != NotExistantPID) {
@@ -255,7 +334,7 @@ namespace BwTree {
                 switch (nextNode->getType()) {
                     case PageType::deltaIndex: {
                         auto node1 = static_cast<DeltaIndex<Key, Data> *>(nextNode);
-                        if (key > node1->keyLeft && key <= node1->keyRight) {
+                        if (keyIsInfinity ? node1->keyRightInfinity : (key > node1->keyLeft && (node1->keyRightInfinity || key <= node1->keyRight))) {
                             return std::make_tuple(nextPID, startNode);
                         } else {
                             nextNode = node1->origin;
@@ -264,7 +343,7 @@ namespace BwTree {
                     };
                     case PageType::inner: {
                         auto node1 = static_cast<InnerNode<Key, Data> *>(nextNode);
-                        auto res = binarySearch<decltype(node1->nodes)>(node1->nodes, node1->nodeCount, key);
+                        auto res = keyIsInfinity ? node1->nodeCount : binarySearch(node1->keys(), node1->separatorCount(), key, node1->prefixLength);
                         if (res == node1->nodeCount && node1->next != NotExistantPID) {
                             nextPID = node1->next;
                         } else {
@@ -275,7 +354,7 @@ namespace BwTree {
                     };
                     case PageType::deltaSplitInner: {
                         auto node1 = static_cast<DeltaSplit<Key, Data> *>(nextNode);
-                        if (key > node1->key) {
+                        if (keyIsInfinity || key > node1->key) {
                             nextPID = node1->sidelink;
                             nextNode = nullptr;
                             continue;
@@ -297,66 +376,239 @@ namespace BwTree {
 
     template<typename Key, typename Data>
     void Tree<Key, Data>::insert(Key key, const Data *const record, ThreadInfo<Key, Data> &threadInfo) {
-        EpocheGuard<Key, Data> epoqueGuard(threadInfo);
-        restartInsert:
-        FindDataPageResult<Key, Data> res = findDataPage(key);
-        assert(isLeaf(res.startNode));
-        if (res.needConsolidatePage == res.pid) {
-            consolidateLeafPage(res.pid, res.startNode, threadInfo);
-            goto restartInsert;
+        std::uint64_t logEnd;
+        {
+            EpocheGuard<Key, Data> epoqueGuard(threadInfo);
+            restartInsert:
+            FindDataPageResult<Key, Data> res = findDataPage(key);
+            assert(isLeaf(res.startNode));
+            if (res.needConsolidatePage == res.pid && !smoQueue) {
+                consolidateLeafPage(res.pid, res.startNode, threadInfo);
+                goto restartInsert;
+            }
+            checkLog();
+            DeltaInsert<Key, Data> *newNode = DeltaInsert<Key, Data>::create(res.startNode, KeyValue<Key, Data>(key, record), (res.dataNode != nullptr));
+            newNode->setLSN(nextLSN(res.lsn));
+            if (!mapping[res.pid].compare_exchange_weak(res.startNode, newNode)) {
+                ++atomicCollisions;
+                smoPolicy->observeUpdate(false);
+                freeNodeSingle<Key, Data>(newNode);
+                goto restartInsert;
+            }
+            smoPolicy->observeUpdate(true);
+            logEnd = logRecord(WALRecordType::insert, key, record, newNode->getLSN(), threadInfo);
+            executeSMO(res, threadInfo);
         }
-        DeltaInsert<Key, Data> *newNode = DeltaInsert<Key, Data>::create(res.startNode, KeyValue<Key, Data>(key, record), (res.dataNode != nullptr));
-        if (!mapping[res.pid].compare_exchange_weak(res.startNode, newNode)) {
-            ++atomicCollisions;
-            freeNodeSingle<Key, Data>(newNode);
-            goto restartInsert;
-        } else {
-            if (res.needSplitPage != NotExistantPID) {
-                splitPage(res.needSplitPage, res.needSplitPageParent);
-            } else if (res.needConsolidatePage != NotExistantPID) {
-                consolidatePage(res.needConsolidatePage, threadInfo);
+        // the wait for the log does not hold back reclamation
+        commitLog(logEnd, threadInfo);
+    }
+
+
+    template<typename Key, typename Data>
+    void Tree<Key, Data>::insertBatch(const std::vector<KeyValue<Key, Data>> &batch, ThreadInfo<Key, Data> &threadInfo) {
+        static thread_local std::vector<KeyValue<Key, Data>> recordsStatic;
+        auto &records = recordsStatic;
+        records.assign(batch.begin(), batch.end());
+        std::stable_sort(records.begin(), records.end(), [](const KeyValue<Key, Data> &t1, const KeyValue<Key, Data> &t2) {
+            return t1.key < t2.key;
+        });
+        std::size_t uniqueCount = 0;
+        for (std::size_t i = 0; i < records.size(); ++i) {
+            if (i + 1 == records.size() || records[i].key != records[i + 1].key) {
+                records[uniqueCount++] = records[i];
+            }
+        }
+        records.resize(uniqueCount);
+
+        std::uint64_t logEnd = 0;
+        {
+            EpocheGuard<Key, Data> epoqueGuard(threadInfo);
+            auto begin = records.begin();
+            while (begin != records.end()) {
+                const Key *separator;
+                FindDataPageResult<Key, Data> res = findDataPage(begin->key, &separator);
+                assert(isLeaf(res.startNode));
+                if (res.needConsolidatePage == res.pid && !smoQueue) {
+                    consolidateLeafPage(res.pid, res.startNode, threadInfo);
+                    continue;
+                }
+                const Key *upperBound = getLeafUpperBound(res.startNode, separator);
+                auto end = upperBound == nullptr ? records.end() : std::upper_bound(begin + 1, records.end(), *upperBound, [](const Key &key, const KeyValue<Key, Data> &record) {
+                    return key < record.key;
+                });
+                // the page is split afterwards anyway, keep the delta in the size range of a page
+                if (static_cast<std::size_t>(std::distance(begin, end)) > smoPolicy->getSplitLimitLeaf()) {
+                    end = begin + smoPolicy->getSplitLimitLeaf();
+                }
+                // the deltas installed before a failure of the log stay, their records were logged
+                checkLog();
+                DeltaInsertBatch<Key, Data> *newNode = DeltaInsertBatch<Key, Data>::create(res.startNode, begin, end);
+                newNode->setLSN(nextLSN(res.lsn));
+                if (!mapping[res.pid].compare_exchange_weak(res.startNode, newNode)) {
+                    ++atomicCollisions;
+                    smoPolicy->observeUpdate(false);
+                    freeNodeSingle<Key, Data>(newNode);
+                    continue;
+                }
+                smoPolicy->observeUpdate(true);
+                // the keys of a delta are distinct, its records share its LSN
+                for (auto record = begin; record != end; ++record) {
+                    logEnd = std::max(logEnd, logRecord(WALRecordType::insert, record->key, record->data(), newNode->getLSN(), threadInfo));
+                }
+                executeSMO(res, threadInfo);
+                begin = end;
             }
-            return;
         }
+        commitLog(logEnd, threadInfo);
     }
 
+    template<typename Key, typename Data>
+    std::tuple<PID, PID> Tree<Key, Data>::getEmptyTreePages(const std::string &operation) {
+        const PID rootPID = root.load();
+        Node<Key, Data> *const rootNode = PIDToNodePtr(rootPID);
+        if (rootNode->getType() != PageType::inner || static_cast<InnerNode<Key, Data> *>(rootNode)->nodeCount != 1) {
+            throw std::logic_error(operation + " requires an empty tree");
+        }
+        const PID leafPID = static_cast<InnerNode<Key, Data> *>(rootNode)->children()[0];
+        Node<Key, Data> *const leaf = PIDToNodePtr(leafPID);
+        if (leaf->getType() != PageType::leaf || static_cast<Leaf<Key, Data> *>(leaf)->recordCount != 0) {
+            throw std::logic_error(operation + " requires an empty tree");
+        }
+        return std::make_tuple(rootPID, leafPID);
+    }
 
     template<typename Key, typename Data>
-    void Tree<Key, Data>::deleteKey(Key key, ThreadInfo<Key, Data> &threadInfo) {
+    void Tree<Key, Data>::bulkLoad(SortedIterator begin, SortedIterator end, double fillFactor, ThreadInfo<Key, Data> &threadInfo, unsigned threads) {
         EpocheGuard<Key, Data> epoqueGuard(threadInfo);
-        restartDelete:
-        FindDataPageResult<Key, Data> res = findDataPage(key);
-        if (res.dataNode == nullptr) {
+        PID oldRootPID, oldLeafPID;
+        std::tie(oldRootPID, oldLeafPID) = getEmptyTreePages("BwTree::bulkLoad");
+        Node<Key, Data> *const oldRoot = PIDToNodePtr(oldRootPID);
+        Node<Key, Data> *const oldLeaf = PIDToNodePtr(oldLeafPID);
+        const std::size_t recordCount = std::distance(begin, end);
+        if (recordCount == 0) {
             return;
         }
-        assert(isLeaf(res.startNode));
-        DeltaDelete<Key, Data> *newDeleteNode = DeltaDelete<Key, Data>::create(res.startNode, key);
-        if (!mapping[res.pid].compare_exchange_weak(res.startNode, newDeleteNode)) {
-            ++atomicCollisions;
-            freeNodeSingle<Key, Data>(newDeleteNode);
-            goto restartDelete;
+        assert(std::adjacent_find(begin, end, [](const KeyValue<Key, Data> &t1, const KeyValue<Key, Data> &t2) {
+            return t1.key >= t2.key;
+        }) == end);
+
+        // leaves, neighbouring leaves get consecutive PIDs so prev and next are known up front
+        const std::size_t recordsPerLeaf = std::max<std::size_t>(1, static_cast<std::size_t>(settings.getSplitLimitLeaf() * fillFactor));
+        const std::size_t leafCount = (recordCount + recordsPerLeaf - 1) / recordsPerLeaf;
+        const PID firstLeafPID = mapping.reserve(leafCount);
+        std::vector<Key> maxKeys(leafCount);
+        auto buildLeaves = [&](std::size_t from, std::size_t to) {
+            for (std::size_t i = from; i < to; ++i) {
+                auto leafBegin = begin + recordCount * i / leafCount;
+                auto leafEnd = begin + recordCount * (i + 1) / leafCount;
+                const PID prev = i == 0 ? NotExistantPID : firstLeafPID + i - 1;
+                const PID next = i + 1 == leafCount ? NotExistantPID : firstLeafPID + i + 1;
+                Leaf<Key, Data> *leaf = Helper<Key, Data>::CreateLeafNodeFromSorted(leafBegin, leafEnd, prev, next);
+                maxKeys[i] = (leafEnd - 1)->key;
+                mapping[firstLeafPID + i].store(leaf, std::memory_order_relaxed);
+            }
+        };
+        const std::size_t threadCount = std::max<std::size_t>(1, std::min<std::size_t>(threads, leafCount));
+        std::vector<std::thread> builders;
+        for (std::size_t thread_i = 1; thread_i < threadCount; ++thread_i) {
+            builders.push_back(std::thread(buildLeaves, leafCount * thread_i / threadCount, leafCount * (thread_i + 1) / threadCount));
         }
+        buildLeaves(0, leafCount / threadCount);
+        for (auto &builder : builders) {
+            builder.join();
+        }
+
+        const PID rootPID = buildInnerLevels(maxKeys, firstLeafPID, fillFactor, [this](std::size_t count) {
+            return mapping.reserve(count);
+        }, [this](PID pid, InnerNode<Key, Data> *innerNode) {
+            mapping[pid].store(innerNode, std::memory_order_relaxed);
+        }, NodeAllocation());
+
+        root.store(rootPID);
+        epoque.markNodeForDeletion(oldRoot, threadInfo);
+        retirePID(oldRootPID, threadInfo);
+        epoque.markNodeForDeletion(oldLeaf, threadInfo);
+        retirePID(oldLeafPID, threadInfo);
+    }
+
+    template<typename Key, typename Data>
+    template<typename ReservePIDs, typename Sink, typename Allocation>
+    PID Tree<Key, Data>::buildInnerLevels(std::vector<Key> &maxKeys, PID firstChildPID, double fillFactor, ReservePIDs reservePIDs, Sink sink,
+                                          Allocation allocation) {
+        // the separator of a child is its largest key and the last entry of a level is the infinity element
+        const std::size_t entriesPerInner = std::max<std::size_t>(2, static_cast<std::size_t>(settings.getSplitLimitInner(0) * fillFactor));
+        std::size_t childCount = maxKeys.size();
+        std::vector<KeyPid<Key, Data>> entries;
+        do {
+            const std::size_t nodeCount = (childCount + entriesPerInner - 1) / entriesPerInner;
+            const PID firstNodePID = reservePIDs(nodeCount);
+            std::vector<Key> nodeMaxKeys(nodeCount);
+            for (std::size_t i = 0; i < nodeCount; ++i) {
+                const std::size_t childBegin = childCount * i / nodeCount;
+                const std::size_t childEnd = childCount * (i + 1) / nodeCount;
+                const PID prev = i == 0 ? NotExistantPID : firstNodePID + i - 1;
+                const PID next = i + 1 == nodeCount ? NotExistantPID : firstNodePID + i + 1;
+                entries.clear();
+                for (std::size_t child = childBegin; child < childEnd; ++child) {
+                    entries.emplace_back(maxKeys[child], firstChildPID + child);
+                }
+                InnerNode<Key, Data> *innerNode = Helper<Key, Data>::CreateInnerNodeFromSorted(entries.begin(), entries.end(), prev, next, NotExistantPID, allocation);
+                nodeMaxKeys[i] = maxKeys[childEnd - 1];
+                sink(firstNodePID + i, innerNode);
+            }
+            maxKeys.swap(nodeMaxKeys);
+            firstChildPID = firstNodePID;
+            childCount = nodeCount;
+        } while (childCount > 1);
+        return firstChildPID;
+    }
+
+    template<typename Key, typename Data>
+    void Tree<Key, Data>::deleteKey(Key key, ThreadInfo<Key, Data> &threadInfo) {
+        std::uint64_t logEnd;
+        {
+            EpocheGuard<Key, Data> epoqueGuard(threadInfo);
+            restartDelete:
+            FindDataPageResult<Key, Data> res = findDataPage(key);
+            if (res.dataNode == nullptr) {
+                return;
+            }
+            assert(isLeaf(res.startNode));
+            checkLog();
+            DeltaDelete<Key, Data> *newDeleteNode = DeltaDelete<Key, Data>::create(res.startNode, key);
+            newDeleteNode->setLSN(nextLSN(res.lsn));
+            if (!mapping[res.pid].compare_exchange_weak(res.startNode, newDeleteNode)) {
+                ++atomicCollisions;
+                smoPolicy->observeUpdate(false);
+                freeNodeSingle<Key, Data>(newDeleteNode);
+                goto restartDelete;
+            }
+            smoPolicy->observeUpdate(true);
+            logEnd = logRecord(WALRecordType::remove, key, nullptr, newDeleteNode->getLSN(), threadInfo);
+        }
+        commitLog(logEnd, threadInfo);
     }
 
     template<typename Key, typename Data>
-    void Tree<Key, Data>::splitPage(const PID needSplitPage, PID needSplitPageParent) {
+    void Tree<Key, Data>::splitPage(const PID needSplitPage, PID needSplitPageParent, ThreadInfo<Key, Data> &threadInfo) {
         assert(needSplitPage != needSplitPageParent);
         if (DEBUG) std::cout << "split page" << std::endl;
         Node<Key, Data> *startNode = PIDToNodePtr(needSplitPage);
         bool leaf = isLeaf(startNode);
 
         Key Kp, Kq;
+        // the right page of an inner split can be the rightmost page of its level, its index entry is the infinity element then
+        bool KqIsInfinity = false;
         LinkedNode<Key, Data> *newRightNode;
         std::size_t removedElements;
         if (!leaf) {
             static thread_local std::vector<KeyPid<Key, Data>> nodesStatic;
             auto &nodes = nodesStatic;
             nodes.clear();
-            PID prev, next;
-            bool hadInfinityElement;
-            std::tie(prev, next, hadInfinityElement) = getConsolidatedInnerData(startNode, needSplitPage, nodes);
+            PID prev, next, infinityChild;
+            std::tie(prev, next, infinityChild) = getConsolidatedInnerData(startNode, needSplitPage, nodes);
 
-            if (nodes.size() < settings.getSplitLimitInner(0)) {
+            if (nodes.size() + (infinityChild != NotExistantPID ? 1 : 0) < smoPolicy->getSplitLimitInner(0) || nodes.size() < 2) {
                 return;
             }
             if (DEBUG) std::cout << "inner size: " << nodes.size() << std::endl;
@@ -368,9 +620,10 @@ namespace BwTree {
 
             Kp = middle->key;
 
-            auto newRightInner = Helper<Key, Data>::CreateInnerNodeFromUnsorted(middle + 1, nodes.end(), needSplitPage, next, hadInfinityElement);
+            auto newRightInner = Helper<Key, Data>::CreateInnerNodeFromUnsorted(middle + 1, nodes.end(), needSplitPage, next, infinityChild);
             assert(newRightInner->nodeCount > 0);
-            Kq = newRightInner->nodes[newRightInner->nodeCount - 1].key;
+            Kq = newRightInner->keys()[newRightInner->nodeCount - 1];
+            KqIsInfinity = newRightInner->next == NotExistantPID;
             removedElements = newRightInner->nodeCount;
             newRightNode = newRightInner;
         } else {
@@ -380,7 +633,7 @@ namespace BwTree {
             PID prev, next;
             std::tie(prev, next) = getConsolidatedLeafData(startNode, records);
             if (DEBUG) std::cout << "leaf size: " << records.size() << std::endl;
-            if (records.size() < settings.getSplitLimitLeaf()) {
+            if (records.size() < smoPolicy->getSplitLimitLeaf()) {
                 return;
             }
             auto middle = records.begin();
@@ -390,14 +643,16 @@ namespace BwTree {
             auto newRightLeaf = Helper<Key, Data>::CreateLeafNodeFromSorted(middle + 1, records.end(), needSplitPage,
                                                                             next);
             assert(newRightLeaf->recordCount > 0);
-            Kq = newRightLeaf->records[newRightLeaf->recordCount - 1].key;
+            // the records keep the LSN of the page they come from, later deltas on the right page order after them
+            newRightLeaf->setLSN(startNode->getLSN());
+            Kq = newRightLeaf->keys()[newRightLeaf->recordCount - 1];
             removedElements = newRightLeaf->recordCount;
             newRightNode = newRightLeaf;
         }
 
 
         newRightNode->prev = needSplitPage;
-        const PID newRightNodePID = newNode(newRightNode);
+        const PID newRightNodePID = newNode(newRightNode, threadInfo);
         DeltaSplit<Key, Data> *splitNode;
 
         splitNode = DeltaSplit<Key, Data>::create(startNode, Kp, newRightNodePID, removedElements, leaf);
@@ -407,34 +662,35 @@ namespace BwTree {
             if (!leaf) ++failedInnerSplit; else ++failedLeafSplit;
             freeNodeSingle<Key, Data>(splitNode);
             freeNodeSingle<Key, Data>(newRightNode);
-            mapping[newRightNodePID].store(nullptr);
+            retirePID(newRightNodePID, threadInfo);
             return;
         }
+        if (!leaf) ++successfulInnerSplit; else ++successfulLeafSplit;
 
         if (needSplitPageParent == NotExistantPID) {
-            InnerNode<Key, Data> *newRoot = InnerNode<Key, Data>::create(2, NotExistantPID, NotExistantPID);
-            newRoot->nodes[0] = KeyPid<Key, Data>(Kp, needSplitPage);
-            newRoot->nodes[1] = KeyPid<Key, Data>(std::numeric_limits<Key>::max(), newRightNodePID);
-            PID newRootPid = newNode(newRoot);
+            std::array<KeyPid<Key, Data>, 2> entries{{KeyPid<Key, Data>(Kp, needSplitPage), KeyPid<Key, Data>(Kq, newRightNodePID)}};
+            InnerNode<Key, Data> *newRoot = Helper<Key, Data>::CreateInnerNodeFromSorted(entries.begin(), entries.end(), NotExistantPID, NotExistantPID, NotExistantPID);
+            PID newRootPid = newNode(newRoot, threadInfo);
             PID curRoot = needSplitPage;
             if (root.compare_exchange_strong(curRoot, newRootPid)) {
                 return;
             }
             freeNodeSingle<Key, Data>(newRoot);
+            retirePID(newRootPid, threadInfo);
             ++atomicCollisions;
             needSplitPageParent = root.load();
         }
         assert(root.load() != needSplitPage);
         std::size_t TMPsplitCollisions = 0;
         while (true) {
-            Node<Key, Data> *parentNode = PIDToNodePtr(needSplitPageParent);
+            // the parent may have been split since it was determined, the index entry has to go to the page which covers Kq
+            Node<Key, Data> *parentNode;
+            std::tie(needSplitPageParent, parentNode) = findInnerNodeOnLevel(needSplitPageParent, Kq, KqIsInfinity);
             assert(!isLeaf(parentNode));
-            DeltaIndex<Key, Data> *indexNode = DeltaIndex<Key, Data>::create(parentNode, Kp, Kq, newRightNodePID, needSplitPage);
+            DeltaIndex<Key, Data> *indexNode = DeltaIndex<Key, Data>::create(parentNode, Kp, Kq, KqIsInfinity, newRightNodePID, needSplitPage);
             if (!mapping[needSplitPageParent].compare_exchange_strong(parentNode, indexNode)) {
                 freeNodeSingle<Key, Data>(indexNode);
                 ++atomicCollisions;
-                // check if parent has been split
-                std::tie(needSplitPageParent, parentNode) = findInnerNodeOnLevel(needSplitPageParent, Kq);
                 if (++TMPsplitCollisions > 0)
                     assert(TMPsplitCollisions < 100);
             } else {
@@ -448,6 +704,7 @@ namespace BwTree {
     void Tree<Key, Data>::consolidateLeafPage(const PID pid, Node<Key, Data> *startNode,
                                               ThreadInfo<Key, Data> &threadInfo) {
         if (DEBUG) std::cout << "consolidate leaf page" << std::endl;
+        const auto consolidationStart = std::chrono::steady_clock::now();
 
         static thread_local std::vector<KeyValue<Key, Data>> recordsStatic;
         auto &records = recordsStatic;
@@ -456,6 +713,7 @@ namespace BwTree {
         std::tie(prev, next) = getConsolidatedLeafData(startNode, records);
         Leaf<Key, Data> *newNode = Helper<Key, Data>::CreateLeafNodeFromSorted(records.begin(), records.end(), prev,
                                                                                next);
+        newNode->setLSN(startNode->getLSN());
 
         Node<Key, Data> *previousNode = startNode;
 
@@ -467,47 +725,78 @@ namespace BwTree {
             ++successfulLeafConsolidate;
             epoque.markNodeForDeletion(previousNode, threadInfo);
         }
+        consolidationNs.record(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - consolidationStart).count());
     }
 
     template<typename Key, typename Data>
     std::tuple<PID, PID> Tree<Key, Data>::getConsolidatedLeafData(Node<Key, Data> *node, std::vector<KeyValue<Key, Data>> &records) {
-        std::array<KeyValue<Key, Data>, 100> deltaInsertRecords;
-        std::size_t deltaInsertRecordsCount = 0;
+        // delta chains can get long if consolidation is left to the SMO workers
+        static thread_local std::vector<KeyValue<Key, Data>> deltaInsertRecordsStatic;
+        auto &deltaInsertRecords = deltaInsertRecordsStatic;
+        deltaInsertRecords.clear();
 
-        std::array<Key, 100> deletedOrUpdatedDeltaKeys;
-        std::size_t deletedOrUpdatedDeltaKeysCount = 0;
+        // kept sorted, batch deltas add many keys at once
+        static thread_local std::vector<Key> deletedOrUpdatedDeltaKeysStatic;
+        auto &deletedOrUpdatedDeltaKeys = deletedOrUpdatedDeltaKeysStatic;
+        deletedOrUpdatedDeltaKeys.clear();
+        static thread_local std::vector<Key> mergedDeltaKeysStatic;
+        auto isDeletedOrUpdated = [&deletedOrUpdatedDeltaKeys](const Key &key) {
+            return std::binary_search(deletedOrUpdatedDeltaKeys.begin(), deletedOrUpdatedDeltaKeys.end(), key);
+        };
+        auto markDeletedOrUpdated = [&deletedOrUpdatedDeltaKeys](const Key &key) {
+            auto it = std::lower_bound(deletedOrUpdatedDeltaKeys.begin(), deletedOrUpdatedDeltaKeys.end(), key);
+            if (it == deletedOrUpdatedDeltaKeys.end() || *it != key) {
+                deletedOrUpdatedDeltaKeys.insert(it, key);
+            }
+        };
 
-        Key stopAtKey = std::numeric_limits<Key>::max();
+        Key stopAtKey = Key();
         bool pageSplit = false;
+        // keys above the split key belong to the right page
+        auto belowSplitKey = [&stopAtKey, &pageSplit](const Key &key) {
+            return !pageSplit || key <= stopAtKey;
+        };
         PID prev, next;
         while (node->getType() != PageType::leaf) {
             switch (node->getType()) {
                 case PageType::deltaInsert: {
                     auto node1 = static_cast<DeltaInsert<Key, Data> *>(node);
                     auto &curKey = node1->record.key;
-                    if (curKey <= stopAtKey
-                            && std::find(deletedOrUpdatedDeltaKeys.begin(), deletedOrUpdatedDeltaKeys.begin() +
-                                                                      deletedOrUpdatedDeltaKeysCount, curKey) == deletedOrUpdatedDeltaKeys.begin() +
-                                                                                                                 deletedOrUpdatedDeltaKeysCount) {
-                        deltaInsertRecords[deltaInsertRecordsCount++] = node1->record;
-                        assert(deltaInsertRecordsCount != deltaInsertRecords.size());
+                    if (belowSplitKey(curKey) && !isDeletedOrUpdated(curKey)) {
+                        deltaInsertRecords.push_back(node1->record);
                         if (node1->keyExistedBefore) {
-                            deletedOrUpdatedDeltaKeys[deletedOrUpdatedDeltaKeysCount++] = curKey;
-                            assert(deletedOrUpdatedDeltaKeysCount != deletedOrUpdatedDeltaKeys.size());
+                            markDeletedOrUpdated(curKey);
+                        }
+                    }
+                    node = node1->origin;
+                    continue;
+                }
+                case PageType::deltaInsertBatch: {
+                    auto node1 = static_cast<DeltaInsertBatch<Key, Data> *>(node);
+                    // whether a key existed before is not tracked for batches, all keys hide older records
+                    auto &mergedDeltaKeys = mergedDeltaKeysStatic;
+                    mergedDeltaKeys.clear();
+                    auto deltaKey = deletedOrUpdatedDeltaKeys.begin();
+                    for (std::size_t i = 0; i < node1->recordCount; ++i) {
+                        const KeyValue<Key, Data> &record = node1->records[i];
+                        while (deltaKey != deletedOrUpdatedDeltaKeys.end() && *deltaKey < record.key) {
+                            mergedDeltaKeys.push_back(*deltaKey++);
+                        }
+                        if (deltaKey != deletedOrUpdatedDeltaKeys.end() && *deltaKey == record.key) {
+                            ++deltaKey;
+                        } else if (belowSplitKey(record.key)) {
+                            deltaInsertRecords.push_back(record);
                         }
+                        mergedDeltaKeys.push_back(record.key);
                     }
+                    mergedDeltaKeys.insert(mergedDeltaKeys.end(), deltaKey, deletedOrUpdatedDeltaKeys.end());
+                    deletedOrUpdatedDeltaKeys.swap(mergedDeltaKeys);
                     node = node1->origin;
                     continue;
                 }
                 case PageType::deltaDelete: {
                     auto node1 = static_cast<DeltaDelete<Key, Data> *>(node);
-                    auto &curKey = node1->key;
-                    if (std::find(deletedOrUpdatedDeltaKeys.begin(), deletedOrUpdatedDeltaKeys.begin() +
-                                                               deletedOrUpdatedDeltaKeysCount, curKey) == deletedOrUpdatedDeltaKeys.begin() +
-                                                                                                          deletedOrUpdatedDeltaKeysCount) {
-                        deletedOrUpdatedDeltaKeys[deletedOrUpdatedDeltaKeysCount++] = curKey;
-                        assert(deletedOrUpdatedDeltaKeysCount != deletedOrUpdatedDeltaKeys.size());
-                    }
+                    markDeletedOrUpdated(node1->key);
                     node = node1->origin;
                     continue;
                 }
@@ -528,34 +817,33 @@ namespace BwTree {
         }
         //case PageType::leaf:
         const auto node1 = static_cast<Leaf<Key, Data> *>(node);
-        std::sort(deltaInsertRecords.begin(), deltaInsertRecords.begin() + deltaInsertRecordsCount, [](const KeyValue<Key, Data> &t1, const KeyValue<Key, Data> &t2) {
+        std::sort(deltaInsertRecords.begin(), deltaInsertRecords.end(), [](const KeyValue<Key, Data> &t1, const KeyValue<Key, Data> &t2) {
             return t1.key < t2.key;
         });
-        std::sort(deletedOrUpdatedDeltaKeys.begin(), deletedOrUpdatedDeltaKeys.begin() + deletedOrUpdatedDeltaKeysCount);
-        KeyValue<Key, Data> *recordsdata[] = {const_cast<KeyValue<Key, Data> *>(deltaInsertRecords.data()), node1->records};
+        const std::size_t deltaInsertRecordsCount = deltaInsertRecords.size();
+        const std::size_t deletedOrUpdatedDeltaKeysCount = deletedOrUpdatedDeltaKeys.size();
+        const Key *const keys = node1->keys();
         std::size_t nextConsideredDeltaKey = 0;
-        std::size_t nextrecords[] = {0, 0};
-        std::size_t &nextdelta = nextrecords[0];
-        std::size_t &nextrecord = nextrecords[1];
+        std::size_t nextdelta = 0;
+        std::size_t nextrecord = 0;
         while (nextrecord < node1->recordCount && nextdelta < deltaInsertRecordsCount) {
             const bool hasMoreDeltaKeys = nextConsideredDeltaKey < deletedOrUpdatedDeltaKeysCount;
             const bool advanceDeletedOrUpdatedDeltaKeys =
-                    hasMoreDeltaKeys && node1->records[nextrecord].key > deletedOrUpdatedDeltaKeys[nextConsideredDeltaKey];
+                    hasMoreDeltaKeys && keys[nextrecord] > deletedOrUpdatedDeltaKeys[nextConsideredDeltaKey];
             if (advanceDeletedOrUpdatedDeltaKeys) {
                 nextConsideredDeltaKey++;
                 continue;
             }
             bool recordUpdatedOrDeleted =
-                    hasMoreDeltaKeys && node1->records[nextrecord].key == deletedOrUpdatedDeltaKeys[nextConsideredDeltaKey];
+                    hasMoreDeltaKeys && keys[nextrecord] == deletedOrUpdatedDeltaKeys[nextConsideredDeltaKey];
             if (recordUpdatedOrDeleted) {
                 nextrecord++;
                 continue;
             }
 
-            std::int8_t choice = (node1->records[nextrecord].key < deltaInsertRecords[nextdelta].key);
-            KeyValue<Key, Data> record = recordsdata[choice][nextrecords[choice]];
-            ++nextrecords[choice];
-            if (record.key <= stopAtKey) {
+            // the value of a base record is only loaded once it is taken
+            KeyValue<Key, Data> record = keys[nextrecord] < deltaInsertRecords[nextdelta].key ? node1->record(nextrecord++) : deltaInsertRecords[nextdelta++];
+            if (belowSplitKey(record.key)) {
                 records.push_back(record);
             } else {
                 nextrecord = node1->recordCount;
@@ -563,16 +851,14 @@ namespace BwTree {
                 break;
             }
         }
-        while (nextrecord < node1->recordCount && node1->records[nextrecord].key <= stopAtKey) {
-            if (std::find(deletedOrUpdatedDeltaKeys.begin(),
-                          deletedOrUpdatedDeltaKeys.begin() + deletedOrUpdatedDeltaKeysCount, node1->records[nextrecord].key) ==
-                    deletedOrUpdatedDeltaKeys.begin() + deletedOrUpdatedDeltaKeysCount) {
-                records.push_back(node1->records[nextrecord]);
+        while (nextrecord < node1->recordCount && belowSplitKey(keys[nextrecord])) {
+            if (!isDeletedOrUpdated(keys[nextrecord])) {
+                records.push_back(node1->record(nextrecord));
             }
             ++nextrecord;
         }
         while (nextdelta < deltaInsertRecordsCount) {
-            if (deltaInsertRecords[nextdelta].key <= stopAtKey) {
+            if (belowSplitKey(deltaInsertRecords[nextdelta].key)) {
                 records.push_back(deltaInsertRecords[nextdelta]);
                 ++nextdelta;
             } else {
@@ -590,15 +876,15 @@ namespace BwTree {
     void Tree<Key, Data>::consolidateInnerPage(const PID pid, Node<Key, Data> *startNode,
                                                ThreadInfo<Key, Data> &threadInfo) {
         if (DEBUG) std::cout << "consolidate inner page" << std::endl;
+        const auto consolidationStart = std::chrono::steady_clock::now();
 
         static thread_local std::vector<KeyPid<Key, Data>> nodesStatic;
         auto &nodes = nodesStatic;
         nodes.clear();
 
-        PID prev, next;
-        bool hadInfinityElement;
-        std::tie(prev, next, hadInfinityElement) = getConsolidatedInnerData(startNode, pid, nodes);
-        InnerNode<Key, Data> *newNode = Helper<Key, Data>::CreateInnerNodeFromUnsorted(nodes.begin(), nodes.end(), prev, next, hadInfinityElement);
+        PID prev, next, infinityChild;
+        std::tie(prev, next, infinityChild) = getConsolidatedInnerData(startNode, pid, nodes);
+        InnerNode<Key, Data> *newNode = Helper<Key, Data>::CreateInnerNodeFromUnsorted(nodes.begin(), nodes.end(), prev, next, infinityChild);
 
         Node<Key, Data> *const previousNode = startNode;
 
@@ -610,30 +896,39 @@ namespace BwTree {
             ++successfulInnerConsolidate;
             epoque.markNodeForDeletion(previousNode, threadInfo);
         }
+        consolidationNs.record(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - consolidationStart).count());
     }
 
     thread_local std::vector<PID> consideredPIDsConsolidateInner;
 
     template<typename Key, typename Data>
-    std::tuple<PID, PID, bool> Tree<Key, Data>::getConsolidatedInnerData(Node<Key, Data> *node, PID pid, std::vector<KeyPid<Key, Data>> &nodes) {
+    std::tuple<PID, PID, PID> Tree<Key, Data>::getConsolidatedInnerData(Node<Key, Data> *node, PID pid, std::vector<KeyPid<Key, Data>> &nodes) {
         consideredPIDsConsolidateInner.clear();
-        Key stopAtKey = std::numeric_limits<Key>::max();
+        Key stopAtKey = Key();
         bool pageSplit = false;
+        // entries above the split key belong to the right page, including the infinity element
+        auto belowSplitKey = [&stopAtKey, &pageSplit](const Key &key) {
+            return !pageSplit || key <= stopAtKey;
+        };
+        auto considered = [](const PID child) {
+            return std::find(consideredPIDsConsolidateInner.begin(), consideredPIDsConsolidateInner.end(), child) != consideredPIDsConsolidateInner.end();
+        };
         PID prev, next;
-        bool hadInfinityElement = false;
+        PID infinityChild = NotExistantPID;
         while (node != nullptr) {
             switch (node->getType()) {
                 case PageType::inner: {
                     auto node1 = static_cast<InnerNode<Key, Data> *>(node);
-                    for (std::size_t i = 0; i < node1->nodeCount; ++i) {
-                        if (node1->nodes[i].key <= stopAtKey &&
-                                std::find(consideredPIDsConsolidateInner.begin(), consideredPIDsConsolidateInner.end(), node1->nodes[i].pid) == consideredPIDsConsolidateInner.end()) {
-                            assert(node1->nodes[i].pid != pid);
-                            nodes.push_back(node1->nodes[i]);
+                    const std::size_t separatorCount = node1->separatorCount();
+                    for (std::size_t i = 0; i < separatorCount; ++i) {
+                        if (belowSplitKey(node1->keys()[i]) && !considered(node1->children()[i])) {
+                            assert(node1->children()[i] != pid);
+                            nodes.push_back(node1->node(i));
                         }
                     }
-                    if (!pageSplit && node1->next == NotExistantPID) {
-                        hadInfinityElement = true;
+                    if (!pageSplit && separatorCount < node1->nodeCount && !considered(node1->children()[separatorCount])) {
+                        assert(infinityChild == NotExistantPID);
+                        infinityChild = node1->children()[separatorCount];
                     }
                     prev = node1->prev;
                     if (!pageSplit) {
@@ -644,18 +939,23 @@ namespace BwTree {
                 }
                 case PageType::deltaIndex: {
                     auto node1 = static_cast<DeltaIndex<Key, Data> *>(node);
-                    if (node1->keyLeft <= stopAtKey && std::find(consideredPIDsConsolidateInner.begin(), consideredPIDsConsolidateInner.end(), node1->oldChild) == consideredPIDsConsolidateInner.end()) {
+                    if (belowSplitKey(node1->keyLeft) && !considered(node1->oldChild)) {
                         if (node1->oldChild == pid) {
                             assert(false);
                         }
                         nodes.push_back(KeyPid<Key, Data>(node1->keyLeft, node1->oldChild));
                         consideredPIDsConsolidateInner.push_back(node1->oldChild);
                     }
-                    if (node1->keyRight <= stopAtKey && std::find(consideredPIDsConsolidateInner.begin(), consideredPIDsConsolidateInner.end(), node1->child) == consideredPIDsConsolidateInner.end()) {
+                    if ((node1->keyRightInfinity ? !pageSplit : belowSplitKey(node1->keyRight)) && !considered(node1->child)) {
                         if (node1->child == pid) {
                             assert(false);
                         }
-                        nodes.push_back(KeyPid<Key, Data>(node1->keyRight, node1->child));
+                        if (node1->keyRightInfinity) {
+                            assert(infinityChild == NotExistantPID);
+                            infinityChild = node1->child;
+                        } else {
+                            nodes.push_back(KeyPid<Key, Data>(node1->keyRight, node1->child));
+                        }
                         consideredPIDsConsolidateInner.push_back(node1->child);
                     }
                     node = node1->origin;
@@ -677,13 +977,136 @@ namespace BwTree {
             }
             node = nullptr;
         }
-        return std::make_tuple(prev, next, hadInfinityElement);
+        return std::make_tuple(prev, next, infinityChild);
+    }
+
+    template<typename Key, typename Data>
+    void Tree<Key, Data>::executeSMO(const FindDataPageResult<Key, Data> &res, ThreadInfo<Key, Data> &threadInfo) {
+        if (res.needSplitPage != NotExistantPID) {
+            if (!queueSMO(res.needSplitPage, res.needSplitPageParent, SMOReason::split)) {
+                splitPage(res.needSplitPage, res.needSplitPageParent, threadInfo);
+            }
+        } else if (res.needConsolidatePage != NotExistantPID) {
+            if (!queueSMO(res.needConsolidatePage, NotExistantPID, SMOReason::consolidate)) {
+                consolidatePage(res.needConsolidatePage, threadInfo);
+            }
+        }
+    }
+
+    template<typename Key, typename Data>
+    bool Tree<Key, Data>::queueSMO(PID pid, PID parent, SMOReason reason) {
+        if (!smoQueue) {
+            return false;
+        }
+        const SMOQueue::PushResult result = smoQueue->push(pid, parent, reason);
+        if (result == SMOQueue::PushResult::duplicate) {
+            return true;
+        }
+        const bool full = result == SMOQueue::PushResult::full;
+        smoPolicy->observeSMOBacklog(full ? smoQueue->capacity() : smoQueue->size(), smoQueue->capacity());
+        return !full;
+    }
+
+    template<typename Key, typename Data>
+    bool Tree<Key, Data>::executeSMOHint(const SMOHint &hint, ThreadInfo<Key, Data> &threadInfo) {
+        switch (hint.reason) {
+            case SMOReason::split: {
+                // the page was the root when the hint was created, its parent is unknown if the root has changed since
+                if (hint.parent == NotExistantPID && root.load() != hint.pid) {
+                    return false;
+                }
+                splitPage(hint.pid, hint.parent, threadInfo);
+                return true;
+            }
+            case SMOReason::consolidate: {
+                PageType type = PIDToNodePtr(hint.pid)->getType();
+                if (type == PageType::leaf || type == PageType::inner) {
+                    return false;
+                }
+                consolidatePage(hint.pid, threadInfo);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    template<typename Key, typename Data>
+    void Tree<Key, Data>::smoWorker() {
+        ThreadInfo<Key, Data> threadInfo = getThreadInfo();
+        std::size_t idleRounds = 0;
+        SMOHint hint;
+        while (!smoWorkersStop.load(std::memory_order_relaxed)) {
+            if (!smoQueue->pop(hint)) {
+                if (idleRounds == 0) {
+                    // an idle worker must not hold back reclamation or synchronize
+                    epoque.enterQuiescentState(threadInfo);
+                }
+                if (++idleRounds < 64) {
+                    std::this_thread::yield();
+                } else {
+                    std::this_thread::sleep_for(std::chrono::microseconds(100));
+                }
+                continue;
+            }
+            idleRounds = 0;
+            bool executed;
+            {
+                EpocheGuard<Key, Data> epocheGuard(threadInfo);
+                executed = executeSMOHint(hint, threadInfo);
+            }
+            smoQueue->markExecuted(hint, !executed);
+        }
+    }
+
+    template<typename Key, typename Data>
+    SMOStatistics Tree<Key, Data>::getSMOStatistics() const {
+        if (!smoQueue) {
+            return SMOStatistics{};
+        }
+        return smoQueue->getStatistics();
+    }
+
+    template<typename Key, typename Data>
+    Metrics Tree<Key, Data>::metrics() const {
+        Metrics metrics;
+        metrics.atomicCollisions = atomicCollisions.load();
+        metrics.successfulLeafConsolidate = successfulLeafConsolidate.load();
+        metrics.successfulInnerConsolidate = successfulInnerConsolidate.load();
+        metrics.failedLeafConsolidate = failedLeafConsolidate.load();
+        metrics.failedInnerConsolidate = failedInnerConsolidate.load();
+        metrics.successfulLeafSplit = successfulLeafSplit.load();
+        metrics.successfulInnerSplit = successfulInnerSplit.load();
+        metrics.failedLeafSplit = failedLeafSplit.load();
+        metrics.failedInnerSplit = failedInnerSplit.load();
+        metrics.deltaSummaryChecks = deltaSummaryChecks.load();
+        metrics.deltaSummarySkips = deltaSummarySkips.load();
+        metrics.deltaChainLength = deltaChainLength.snapshot();
+        metrics.treeHeight = treeHeight.snapshot();
+        metrics.consolidationNs = consolidationNs.snapshot();
+        metrics.mapping = mapping.occupancy();
+        metrics.pendingGarbageBytes = epoque.pendingGarbageBytes();
+        return metrics;
     }
 
     template<typename Key, typename Data>
     Tree<Key, Data>::~Tree() {
-        for (unsigned long i = 0; i < mappingNext; ++i) {
-            Node<Key, Data> *node = mapping[i];
+        if (evictor.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock(evictorMutex);
+                evictorStop.store(true);
+            }
+            evictorWakeup.notify_one();
+            evictor.join();
+        }
+        smoWorkersStop.store(true);
+        for (auto &worker : smoWorkers) {
+            worker.join();
+        }
+        for (PID i = 0; i < mapping.size(); ++i) {
+            Node<Key, Data> *node = mapping.get(i);
+            if (PageStore::isReference(node)) {
+                continue;
+            }
             freeNodeRecursively<Key, Data>(node);
         }
     }
@@ -694,23 +1117,43 @@ namespace BwTree {
     }
 }
 #include "epoche.cpp"
+#include "iterator.cpp"
+#include "checkpoint.cpp"
+#include "image.cpp"
+#include "eviction.cpp"
 
 template class BwTree::Tree<uint32_t, uint32_t>;
 template class BwTree::Tree<uint32_t, uint64_t>;
 template class BwTree::Tree<uint64_t, uint64_t>;
 template class BwTree::Tree<unsigned long long, unsigned long long>;
+template class BwTree::Tree<BwTree::VarKey, uint64_t>;
 
 template class BwTree::ThreadInfo<uint32_t, uint32_t>;
 template class BwTree::ThreadInfo<uint32_t, uint64_t>;
 template class BwTree::ThreadInfo<uint64_t, uint64_t>;
 template class BwTree::ThreadInfo<unsigned long long, unsigned long long>;
+template class BwTree::ThreadInfo<BwTree::VarKey, uint64_t>;
 
 template class BwTree::DeletionList<uint32_t, uint32_t>;
 template class BwTree::DeletionList<uint32_t, uint64_t>;
 template class BwTree::DeletionList<uint64_t, uint64_t>;
 template class BwTree::DeletionList<unsigned long long, unsigned long long>;
+template class BwTree::DeletionList<BwTree::VarKey, uint64_t>;
 
 template class BwTree::Epoche<uint32_t, uint32_t>;
 template class BwTree::Epoche<uint32_t, uint64_t>;
 template class BwTree::Epoche<uint64_t, uint64_t>;
 template class BwTree::Epoche<unsigned long long, unsigned long long>;
+template class BwTree::Epoche<BwTree::VarKey, uint64_t>;
+
+template class BwTree::ForwardIterator<uint32_t, uint32_t>;
+template class BwTree::ForwardIterator<uint32_t, uint64_t>;
+template class BwTree::ForwardIterator<uint64_t, uint64_t>;
+template class BwTree::ForwardIterator<unsigned long long, unsigned long long>;
+template class BwTree::ForwardIterator<BwTree::VarKey, uint64_t>;
+
+template class BwTree::ReverseIterator<uint32_t, uint32_t>;
+template class BwTree::ReverseIterator<uint32_t, uint64_t>;
+template class BwTree::ReverseIterator<uint64_t, uint64_t>;
+template class BwTree::ReverseIterator<unsigned long long, unsigned long long>;
+template class BwTree::ReverseIterator<BwTree::VarKey, uint64_t>;
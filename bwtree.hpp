@@ -4,17 +4,41 @@
 #include <tuple>
 #include <vector>
 #include <mutex>
+#include <condition_variable>
 #include <atomic>
 #include <random>
 #include <iostream>
 #include <stack>
+#include <thread>
+#include <memory>
+#include <string>
+#include <chrono>
+#include <stdexcept>
 #include <assert.h>
 #include <sys/wait.h>
 #include "nodes.hpp"
 #include "epoque.hpp"
+#include "mapping.hpp"
+#include "smo.hpp"
+#include "search.hpp"
+#include "smopolicy.hpp"
+#include "metrics.hpp"
+#include "checkpoint.hpp"
+#include "image.hpp"
+#include "wal.hpp"
+#include "pagestore.hpp"
 
 namespace BwTree {
 
+    template<typename Key, typename Data>
+    class ForwardIterator;
+
+    template<typename Key, typename Data>
+    class ReverseIterator;
+
+    template<typename Key, typename Data>
+    class TreeMicroBench;
+
     template<typename Key, typename Data>
     struct FindDataPageResult {
         const PID pid;
@@ -24,22 +48,36 @@ namespace BwTree {
         const PID needConsolidatePage;
         const PID needSplitPage;
         const PID needSplitPageParent;
+        // largest LSN of the leaves passed on the way to the page
+        const std::uint64_t lsn;
 
 
-        FindDataPageResult(PID const pid, Node<Key, Data> *startNode, Node<Key, Data> const *dataNode, PID const needConsolidatePage, PID const needSplitPage, PID const needSplitPageParent);
+        FindDataPageResult(PID const pid, Node<Key, Data> *startNode, Node<Key, Data> const *dataNode, PID const needConsolidatePage, PID const needSplitPage, PID const needSplitPageParent, std::uint64_t const lsn);
 
-        FindDataPageResult(PID const pid, Node<Key, Data> *startNode, Node<Key, Data> const *dataNode, Data const *data, PID const needConsolidatePage, PID const needSplitPage, PID const needSplitPageParent);
+        FindDataPageResult(PID const pid, Node<Key, Data> *startNode, Node<Key, Data> const *dataNode, Data const *data, PID const needConsolidatePage, PID const needSplitPage, PID const needSplitPageParent, std::uint64_t const lsn);
     };
 
 
     struct Settings {
         std::string name;
 
-        Settings(std::string name, size_t splitLeaf, std::vector<size_t> const &splitInner, size_t consolidateLeaf, std::vector<size_t> const &consolidateInner)
+        Settings(std::string name, size_t splitLeaf, std::vector<size_t> const &splitInner, size_t consolidateLeaf, std::vector<size_t> const &consolidateInner, size_t smoThreads = 0,
+                 SMOPolicyType smoPolicy = SMOPolicyType::fixed, bool reclaimerThread = false, std::size_t maxPendingGarbageBytes = 0,
+                 std::string walPath = "", WALSyncPolicy walSyncPolicy = WALSyncPolicy::commit, std::chrono::microseconds walSyncInterval = std::chrono::milliseconds(1),
+                 std::string pageStorePath = "", std::size_t memoryBudget = 0)
                 : name(name), splitLeaf(splitLeaf),
                   splitInner(splitInner),
                   consolidateLeaf(consolidateLeaf),
-                  consolidateInner(consolidateInner) {
+                  consolidateInner(consolidateInner),
+                  smoThreads(smoThreads),
+                  smoPolicy(smoPolicy),
+                  reclaimerThread(reclaimerThread),
+                  maxPendingGarbageBytes(maxPendingGarbageBytes),
+                  walPath(walPath),
+                  walSyncPolicy(walSyncPolicy),
+                  walSyncInterval(walSyncInterval),
+                  pageStorePath(pageStorePath),
+                  memoryBudget(memoryBudget) {
         }
 
         std::size_t splitLeaf;
@@ -66,6 +104,85 @@ namespace BwTree {
             return level < consolidateInner.size() ? consolidateInner[level] : consolidateInner[consolidateInner.size() - 1];
         }
 
+        /**
+        * number of background threads executing consolidations and splits, 0 executes them in the thread which detected them
+        */
+        std::size_t smoThreads;
+
+        const std::size_t &getSMOThreads() const {
+            return smoThreads;
+        }
+
+        /**
+        * policy of a tree which is not given its own, the limits above are the limits of the fixed policy and the starting point of the adaptive one
+        */
+        SMOPolicyType smoPolicy;
+
+        const SMOPolicyType &getSMOPolicy() const {
+            return smoPolicy;
+        }
+
+        /**
+        * frees retired nodes in a background thread instead of the threads which retired them
+        */
+        bool reclaimerThread;
+
+        const bool &getReclaimerThread() const {
+            return reclaimerThread;
+        }
+
+        /**
+        * bytes of retired nodes awaiting reclamation above which the threads free them synchronously, 0 is unlimited
+        */
+        std::size_t maxPendingGarbageBytes;
+
+        const std::size_t &getMaxPendingGarbageBytes() const {
+            return maxPendingGarbageBytes;
+        }
+
+        /**
+        * file of the write ahead log of inserts and deletes, empty for none. Requires fixed size keys and inline values.
+        */
+        std::string walPath;
+
+        const std::string &getWALPath() const {
+            return walPath;
+        }
+
+        WALSyncPolicy walSyncPolicy;
+
+        const WALSyncPolicy &getWALSyncPolicy() const {
+            return walSyncPolicy;
+        }
+
+        /**
+        * the log writer writes at least this often, with WALSyncPolicy::commit it also wakes up for every waiting operation
+        */
+        std::chrono::microseconds walSyncInterval;
+
+        const std::chrono::microseconds &getWALSyncInterval() const {
+            return walSyncInterval;
+        }
+
+        /**
+        * file which cold leaves are evicted to once the tree exceeds memoryBudget, empty keeps all pages in memory.
+        * Requires fixed size keys and inline values.
+        */
+        std::string pageStorePath;
+
+        const std::string &getPageStorePath() const {
+            return pageStorePath;
+        }
+
+        /**
+        * bytes of nodes the tree keeps in memory, measured by the sweeps of the evictor over the mapping table
+        */
+        std::size_t memoryBudget;
+
+        const std::size_t &getMemoryBudget() const {
+            return memoryBudget;
+        }
+
         const std::string &getName() const {
             return name;
         }
@@ -73,46 +190,138 @@ namespace BwTree {
 
     template<typename Key, typename Data>
     class Tree {
+        friend class ForwardIterator<Key, Data>;
+        friend class ReverseIterator<Key, Data>;
+        // drives the internal hot paths in isolation, see microbench.cpp
+        friend class TreeMicroBench<Key, Data>;
+
         static constexpr bool DEBUG = false;
         /**
         * Special Invariant:
         * - Leaf nodes always contain special infinity value at the right end for the last pointer
         */
         std::atomic<PID> root;
-        std::vector<std::atomic<Node<Key, Data> *>> mapping{4194304};
-        std::atomic<PID> mappingNext{0};
-        std::atomic<unsigned long> atomicCollisions{0};
-        std::atomic<unsigned long> successfulLeafConsolidate{0};
-        std::atomic<unsigned long> successfulInnerConsolidate{0};
-        std::atomic<unsigned long> failedLeafConsolidate{0};
-        std::atomic<unsigned long> failedInnerConsolidate{0};
-        std::atomic<unsigned long> successfulLeafSplit{0};
-        std::atomic<unsigned long> successfulInnerSplit{0};
-        std::atomic<unsigned long> failedLeafSplit{0};
-        std::atomic<unsigned long> failedInnerSplit{0};
-
-        Epoche<Key, Data> epoque{64};
+        // the pages of a mapped image are referenced by the mapping table and the epoche, so it is unmapped after them
+        MappedImage image;
+        MappingTable<Key, Data> mapping;
+        // sharded so threads counting at the same time do not share cache lines, the getters add up the shards
+        ShardedCounter atomicCollisions;
+        ShardedCounter successfulLeafConsolidate;
+        ShardedCounter successfulInnerConsolidate;
+        ShardedCounter failedLeafConsolidate;
+        ShardedCounter failedInnerConsolidate;
+        ShardedCounter successfulLeafSplit;
+        ShardedCounter successfulInnerSplit;
+        ShardedCounter failedLeafSplit;
+        ShardedCounter failedInnerSplit;
+        ShardedCounter deltaSummaryChecks;
+        ShardedCounter deltaSummarySkips;
+        ShardedCounter evictedPages;
+        ShardedCounter faultedPages;
+        ShardedCounter relocatedPages;
+        // one in histogramSampleRate walks is recorded in the histograms and the delta summary counters, recording every walk costs more than a short walk
+        static constexpr std::uint64_t histogramSampleRate = 64;
+        Histogram deltaChainLength;
+        Histogram treeHeight;
+        Histogram consolidationNs;
+
+        Epoche<Key, Data> epoque;
 
         const Settings &settings;
 
+        std::unique_ptr<SMOPolicy> smoPolicy;
+
+        std::unique_ptr<WriteAheadLog> wal;
+        // LSNs of new record deltas are above it, so they order after the records already in the log
+        std::uint64_t lsnFloor = 0;
+        // set while recover applies the log, the applied records are not logged again
+        bool replaying = false;
+
+        struct PendingEviction {
+            PID pid;
+            // the node which is evicted or the reference of the page which is relocated
+            Node<Key, Data> *expected;
+            std::uintptr_t reference;
+            std::size_t size;
+        };
+
+        std::unique_ptr<PageStore> pageStore;
+        // bytes of the pages in the page store which are referenced by the mapping table
+        std::atomic<std::size_t> storedBytes{0};
+        // only accessed by the evictor
+        std::vector<PendingEviction> pendingEvictions;
+        std::atomic<bool> evictorStop{false};
+        std::atomic<bool> evictorFailed{false};
+        std::mutex evictorMutex;
+        std::condition_variable evictorWakeup;
+        std::thread evictor;
+
         Node<Key, Data> *PIDToNodePtr(const PID node) {
-            return mapping[node];
+            Node<Key, Data> *entry = mapping.get(node);
+            if (PageStore::isReference(entry)) {
+                return faultIn(node, entry);
+            }
+            return entry;
         }
 
+        /**
+        * reads the evicted page back into memory, returns the node the entry holds afterwards. Has to be called inside an epoche.
+        */
+        Node<Key, Data> *faultIn(PID pid, Node<Key, Data> *entry);
+
+        /**
+        * copies the page into the page store, the mapping table entry is changed by flushEvictions.
+        * Returns the bytes evicted by a flush which was necessary to make room for the page.
+        */
+        std::size_t stageEviction(PID pid, Node<Key, Data> *expected, const void *page, std::size_t size, ThreadInfo<Key, Data> &threadInfo);
+
+        /**
+        * writes the staged pages and points the mapping table entries to them, returns the bytes of the evicted nodes.
+        * Has to be called inside an epoche.
+        */
+        std::size_t flushEvictions(ThreadInfo<Key, Data> &threadInfo);
+
+        /**
+        * relocates the live pages of the oldest segments while more than half of the page store is no longer referenced
+        */
+        void cleanPageStore(ThreadInfo<Key, Data> &threadInfo);
+
+        void runEvictor();
+
         PID newNode(Node<Key, Data> *node) {
-            PID nextPID = mappingNext++;
-            if (nextPID >= mapping.size()) {
-                std::cerr << "Mapping table is full, aborting!" << std::endl;
-                exit(1);
+            return mapping.add(node);
+        }
+
+        /**
+        * prefers PIDs which have been retired by this thread and can no longer be seen by any other thread
+        */
+        PID newNode(Node<Key, Data> *node, ThreadInfo<Key, Data> &threadInfo) {
+            PID pid;
+            if (epoque.getReusablePID(pid, threadInfo)) {
+                mapping[pid].store(node);
+                return pid;
             }
-            mapping[nextPID] = node;
-            return nextPID;
+            return mapping.add(node);
         }
 
         /**
-        * page id of the leaf node, first node in the chain (corresponds to PID), actual node where the data was found
+        * the PID must not be reachable from any node in the tree anymore
         */
-        FindDataPageResult<Key, Data> findDataPage(Key key);
+        void retirePID(const PID pid, ThreadInfo<Key, Data> &threadInfo) {
+            mapping[pid].store(nullptr);
+            epoque.markPIDForReuse(pid, threadInfo);
+        }
+
+        /**
+        * page id of the leaf node, first node in the chain (corresponds to PID), actual node where the data was found.
+        * If separator is given it is set to the separator of the parent entry which led to the leaf level, nullptr for the infinity element.
+        */
+        FindDataPageResult<Key, Data> findDataPage(Key key, const Key **separator = nullptr);
+
+        /**
+        * largest key which is routed to the leaf page starting with startNode, at most separator. nullptr if there is no bound.
+        */
+        const Key *getLeafUpperBound(Node<Key, Data> *startNode, const Key *separator);
 
         void consolidatePage(const PID pid, ThreadInfo<Key, Data> &threadInfo) {
             Node<Key, Data> *node = PIDToNodePtr(pid);
@@ -125,15 +334,109 @@ namespace BwTree {
 
         void consolidateInnerPage(PID pid, Node<Key, Data> *startNode, ThreadInfo<Key, Data> &threadInfo);
 
-        std::tuple<PID, PID, bool> getConsolidatedInnerData(Node<Key, Data> *node, PID pid, std::vector<KeyPid<Key, Data>> &returnNodes);
+        /**
+        * returns prev, next and the child of the infinity element which is not part of returnNodes, NotExistantPID if the node has none
+        */
+        std::tuple<PID, PID, PID> getConsolidatedInnerData(Node<Key, Data> *node, PID pid, std::vector<KeyPid<Key, Data>> &returnNodes);
 
         void consolidateLeafPage(PID pid, Node<Key, Data> *startNode, ThreadInfo<Key, Data> &threadInfo);
 
         std::tuple<PID, PID> getConsolidatedLeafData(Node<Key, Data> *node, std::vector<KeyValue<Key, Data>> &returnNodes);
 
-        void splitPage(const PID needSplitPage, const PID needSplitPageParent);
+        void splitPage(const PID needSplitPage, const PID needSplitPageParent, ThreadInfo<Key, Data> &threadInfo);
+
+        /**
+        * LSN of a record delta, above lsn, the largest LSN of the leaves findDataPage passed (FindDataPageResult::lsn)
+        */
+        std::uint64_t nextLSN(std::uint64_t lsn) const {
+            return std::max(lsn, lsnFloor) + 1;
+        }
+
+        /**
+        * refuses a write once the write ahead log failed, has to be called before the delta of the write is installed
+        */
+        void checkLog() {
+            if (wal && !replaying) {
+                wal->throwIfFailed();
+            }
+        }
+
+        /**
+        * appends the record to the write ahead log, value is nullptr for deletes. Returns what commitLog waits for,
+        * 0 without a log. Has to be called inside the epoche in which the delta of the record was installed.
+        */
+        std::uint64_t logRecord(WALRecordType type, const Key &key, const Data *value, std::uint64_t lsn, ThreadInfo<Key, Data> &threadInfo) {
+            if (!wal || replaying) {
+                return 0;
+            }
+            return wal->append(epoque.slotIndex(threadInfo), lsn, type, &key, sizeof(Key), value, value == nullptr ? 0 : sizeof(Data));
+        }
+
+        /**
+        * waits until the records logged by the thread up to logEnd are durable as the sync policy demands, outside of an epoche
+        */
+        void commitLog(std::uint64_t logEnd, ThreadInfo<Key, Data> &threadInfo) {
+            if (logEnd != 0) {
+                wal->commit(epoque.slotIndex(threadInfo), logEnd);
+            }
+        }
+
+        /**
+        * has to be called inside an epoche
+        */
+        PID getLeftmostLeaf();
+
+        /**
+        * passes the records of every leaf from left to right to consumer, every leaf is consolidated in its own epoche
+        */
+        template<typename Consumer>
+        void forEachLeaf(ThreadInfo<Key, Data> &threadInfo, Consumer consumer);
+
+        /**
+        * PIDs of the root and the leaf of a tree which was never written to, throws std::logic_error for other trees.
+        * Has to be called inside an epoche.
+        */
+        std::tuple<PID, PID> getEmptyTreePages(const std::string &operation);
+
+        /**
+        * Builds the inner levels of bulkLoad and writeImage above the children with consecutive PIDs from firstChildPID,
+        * maxKeys holds the largest key of every child. reservePIDs(count) returns the first of count consecutive PIDs for the
+        * nodes of a level, sink(pid, node) takes every finished node. Returns the PID of the root, maxKeys is consumed.
+        */
+        template<typename ReservePIDs, typename Sink, typename Allocation>
+        PID buildInnerLevels(std::vector<Key> &maxKeys, PID firstChildPID, double fillFactor, ReservePIDs reservePIDs, Sink sink, Allocation allocation);
+
+        /**
+        * restore which also returns the header of the checkpoint
+        */
+        std::size_t restoreCheckpoint(const std::string &path, ThreadInfo<Key, Data> &threadInfo, unsigned threads, double fillFactor, CheckpointHeader &header);
+
+        /**
+        * page on the level of pid which contains key, or the rightmost page of the level if keyIsInfinity is set
+        */
+        std::tuple<PID, Node<Key, Data> *> findInnerNodeOnLevel(PID pid, Key key, bool keyIsInfinity);
+
+        std::unique_ptr<SMOQueue> smoQueue;
+        std::vector<std::thread> smoWorkers;
+        std::atomic<bool> smoWorkersStop{false};
 
-        std::tuple<PID, Node<Key, Data> *> findInnerNodeOnLevel(PID pid, Key key);
+        /**
+        * executes the split or consolidation requested by findDataPage or hands it to the SMO workers
+        */
+        void executeSMO(const FindDataPageResult<Key, Data> &res, ThreadInfo<Key, Data> &threadInfo);
+
+        /**
+        * hands the SMO to the SMO workers and reports the queue backlog to the policy, returns false if the calling thread
+        * has to execute it because there are no workers or the queue is full
+        */
+        bool queueSMO(PID pid, PID parent, SMOReason reason);
+
+        /**
+        * returns false if the hint was outdated and nothing was done
+        */
+        bool executeSMOHint(const SMOHint &hint, ThreadInfo<Key, Data> &threadInfo);
+
+        void smoWorker();
 
         bool isLeaf(Node<Key, Data> *node) {
             switch (node->getType()) {
@@ -144,6 +447,7 @@ namespace BwTree {
                 case PageType::leaf:
                 case PageType::deltaDelete: /* fallthrough */
                 case PageType::deltaSplit: /* fallthrough */
+                case PageType::deltaInsertBatch: /* fallthrough */
                 case PageType::deltaInsert:
                     return true;
             }
@@ -151,74 +455,249 @@ namespace BwTree {
             return false;
         }
 
-        template<typename T>
-        static size_t binarySearch(T array, std::size_t length, Key key);
-
-        std::default_random_engine d;
-        std::uniform_int_distribution<int> rand{0, 100};
+        static size_t binarySearch(const Key *keys, std::size_t length, const Key &key, std::uint32_t prefixLength = 0);
 
     public:
 
-        Tree(Settings &settings) : settings(settings) {
+        /**
+        * smoPolicy replaces the policy chosen by the settings
+        */
+        Tree(Settings &settings, std::unique_ptr<SMOPolicy> smoPolicy = nullptr)
+                : epoque(64, settings.getReclaimerThread(), settings.getMaxPendingGarbageBytes()), settings(settings), smoPolicy(std::move(smoPolicy)) {
+            if (!settings.getWALPath().empty()) {
+                if (KeyTraits<Key>::variableLength || !ValueStorage<Data>::isInline) {
+                    throw std::logic_error("BwTree write ahead log requires fixed size keys and inline values");
+                }
+                wal.reset(new WriteAheadLog(settings.getWALPath(), settings.getWALSyncPolicy(), settings.getWALSyncInterval(), Epoche<Key, Data>::defaultMaxThreads));
+                lsnFloor = wal->getMaxLSN();
+            }
+            if (!settings.getPageStorePath().empty() && (KeyTraits<Key>::variableLength || !ValueStorage<Data>::isInline)) {
+                throw std::logic_error("BwTree page store requires fixed size keys and inline values");
+            }
+            if (!this->smoPolicy) {
+                if (settings.getSMOPolicy() == SMOPolicyType::adaptive) {
+                    this->smoPolicy.reset(new AdaptiveSMOPolicy(settings.getSplitLimitLeaf(), settings.splitInner, settings.getConsolidateLimitLeaf(), settings.consolidateInner));
+                } else {
+                    this->smoPolicy.reset(new FixedSMOPolicy(settings.getSplitLimitLeaf(), settings.splitInner, settings.getConsolidateLimitLeaf(), settings.consolidateInner));
+                }
+            }
             Node<Key, Data> *datanode = Leaf<Key, Data>::create(0, NotExistantPID, NotExistantPID);
             PID dataNodePID = newNode(datanode);
             InnerNode<Key, Data> *innerNode = InnerNode<Key, Data>::create(1, NotExistantPID, NotExistantPID);
-            innerNode->nodes[0] = KeyPid<Key, Data>(std::numeric_limits<Key>::max(), dataNodePID);
+            // the only entry of the root is the infinity element
+            innerNode->setNode(0, KeyPid<Key, Data>(Key(), dataNodePID));
             root.store(newNode(innerNode));
+            if (settings.getSMOThreads() > 0) {
+                smoQueue.reset(new SMOQueue(4096));
+                for (std::size_t i = 0; i < settings.getSMOThreads(); ++i) {
+                    smoWorkers.push_back(std::thread(&Tree<Key, Data>::smoWorker, this));
+                }
+            }
+            if (!settings.getPageStorePath().empty()) {
+                pageStore.reset(new PageStore(settings.getPageStorePath()));
+                evictor = std::thread(&Tree<Key, Data>::runEvictor, this);
+            }
         }
 
         ~Tree();
 
+        /**
+        * small trivially copyable values are copied into the tree, otherwise record has to stay valid as long as it is in the tree
+        */
         void insert(Key key, const Data *const record, ThreadInfo<Key, Data> &threadInfo);
 
+        /**
+        * inserts all records, a key which occurs multiple times gets the data of its last occurrence.
+        * The records are grouped by leaf, every leaf gets one delta with all of its records.
+        */
+        void insertBatch(const std::vector<KeyValue<Key, Data>> &records, ThreadInfo<Key, Data> &threadInfo);
+
         void deleteKey(Key key, ThreadInfo<Key, Data> &threadInfo);
 
-        Data *search(Key key, ThreadInfo<Key, Data> &threadInfo);
+        /**
+        * empty if the key does not exist, inline stored values are copied into the result. lookup is the primary way to read a value.
+        */
+        SearchResult<Data> search(Key key, ThreadInfo<Key, Data> &threadInfo);
+
+        /**
+        * copies the value of key to value, returns false if the key does not exist
+        */
+        bool lookup(Key key, Data &value, ThreadInfo<Key, Data> &threadInfo);
+
+        /**
+        * appends all records with lowKey <= key <= highKey in ascending order to result, returns the number of appended records.
+        * Use a ForwardIterator to consume the range without materializing it, the iterators also work for variable length keys.
+        */
+        std::size_t scan(Key lowKey, Key highKey, std::vector<KeyValue<Key, Data>> &result, ThreadInfo<Key, Data> &threadInfo);
+
+        /**
+        * appends at most maxRecords records with highKey >= key >= lowKey in descending order to result, returns the number of appended records.
+        */
+        std::size_t reverseScan(Key highKey, Key lowKey, std::size_t maxRecords, std::vector<KeyValue<Key, Data>> &result, ThreadInfo<Key, Data> &threadInfo);
+
+        typedef typename std::vector<KeyValue<Key, Data>>::const_iterator SortedIterator;
+
+        /**
+        * builds the tree bottom up from records sorted by unique keys, the tree has to be empty.
+        * Pages are filled to fillFactor of the split limits, the leaves are built by the given number of threads.
+        */
+        void bulkLoad(SortedIterator begin, SortedIterator end, double fillFactor, ThreadInfo<Key, Data> &threadInfo, unsigned threads = 1);
+
+        /**
+        * writes all records sorted by key to the file at path (checkpoint.hpp), it is only replaced once the checkpoint is complete.
+        * Other threads keep working meanwhile, every leaf is consolidated into the checkpoint in its own epoche:
+        * records which are inserted, updated or deleted during the checkpoint may be in their old or new state, all others are exact.
+        * Only fixed size keys and inline data can be written, std::logic_error otherwise, I/O errors throw std::system_error.
+        * With a write ahead log, the checkpoint records where recover continues in the log. It waits until every other thread
+        * finished its current operation, so idle threads have to be quiescent (threadQuiescent) or unregistered.
+        * Returns the number of written records.
+        */
+        std::size_t checkpoint(const std::string &path, ThreadInfo<Key, Data> &threadInfo);
+
+        /**
+        * loads a checkpoint into the tree, which has to be empty. The file is read in large sequential chunks by the given number
+        * of threads and the tree is rebuilt by bulkLoad with them. Throws std::runtime_error if the file is no valid checkpoint
+        * of this tree type. Returns the number of loaded records.
+        */
+        std::size_t restore(const std::string &path, ThreadInfo<Key, Data> &threadInfo, unsigned threads = 1, double fillFactor = 0.8);
+
+        /**
+        * Recovers the tree, which has to be empty, from the checkpoint at checkpointPath, if it exists, and the write ahead log
+        * of the settings. Of the records logged since the checkpoint, the last one of every key is applied. bulkLoad, restore
+        * and mapImage are not logged, a checkpoint has to be taken after them. Throws std::logic_error without a log.
+        * Returns the number of applied log records.
+        */
+        std::size_t recover(const std::string &checkpointPath, ThreadInfo<Key, Data> &threadInfo, unsigned threads = 1);
+
+        /**
+        * writes all records into a tree image at path (image.hpp), which can be served by mapImage. Leaves are filled to fillFactor
+        * of the split limits. Records are read like by checkpoint, it has the same consistency and the same restrictions.
+        * Returns the number of written records.
+        */
+        std::size_t writeImage(const std::string &path, ThreadInfo<Key, Data> &threadInfo, double fillFactor = 1.0);
+
+        /**
+        * Serves the tree from the image at path, the tree has to be empty and must not be used by other threads meanwhile.
+        * The mapping table points into the read only mapping of the file, nothing is read or copied up front and the page cache
+        * is shared by all processes mapping the image. Writes add deltas on the heap as usual, consolidation and splits copy
+        * a mapped page to the heap, the mapped pages are never modified or freed. The file must not change while it is mapped.
+        * Throws std::runtime_error if the file is no image of this tree type.
+        */
+        void mapImage(const std::string &path, ThreadInfo<Key, Data> &threadInfo);
 
         ThreadInfo<Key, Data> getThreadInfo();
 
+        /**
+        * registers a ThreadInfo which was passed to threadFinishedWithTree again, getThreadInfo returns registered ones
+        */
+        void registerThread(ThreadInfo<Key, Data> &threadInfo) {
+            epoque.registerThread(threadInfo);
+        }
+
         /**
         * has to be called when no further work is to be done the next time so that the epoques can be freed.
+        * The garbage of the thread is freed by other threads, the ThreadInfo can only be used again after registerThread.
         */
-        void threadFinishedWithTree() {
-            //TODO EnterEpoque<Key, Data>::threadFinishedWithTree(epoque);
+        void threadFinishedWithTree(ThreadInfo<Key, Data> &threadInfo) {
+            epoque.unregisterThread(threadInfo);
+        }
+
+        /**
+        * the thread holds no references into the tree until its next operation, it does not hold back reclamation while
+        * it is idle, e.g. parked in a thread pool. Must not be called inside an EpocheSession.
+        */
+        void threadQuiescent(ThreadInfo<Key, Data> &threadInfo) {
+            epoque.enterQuiescentState(threadInfo);
         }
 
 
         unsigned long getAtomicCollisions() const {
-            return atomicCollisions;
+            return atomicCollisions.load();
         }
 
         unsigned long getSuccessfulLeafConsolidate() const {
-            return successfulLeafConsolidate;
+            return successfulLeafConsolidate.load();
         }
 
         unsigned long getSuccessfulInnerConsolidate() const {
-            return successfulInnerConsolidate;
+            return successfulInnerConsolidate.load();
         }
 
         unsigned long getFailedLeafConsolidate() const {
-            return failedLeafConsolidate;
+            return failedLeafConsolidate.load();
         }
 
         unsigned long getFailedInnerConsolidate() const {
-            return failedInnerConsolidate;
+            return failedInnerConsolidate.load();
         }
 
         unsigned long getSuccessfulLeafSplit() const {
-            return successfulLeafSplit;
+            return successfulLeafSplit.load();
         }
 
         unsigned long getSuccessfulInnerSplit() const {
-            return successfulInnerSplit;
+            return successfulInnerSplit.load();
         }
 
         unsigned long getFailedLeafSplit() const {
-            return failedLeafSplit;
+            return failedLeafSplit.load();
         }
 
         unsigned long getFailedInnerSplit() const {
-            return failedInnerSplit;
+            return failedInnerSplit.load();
+        }
+
+        /**
+        * number of delta summaries looked at by the sampled walks, one in histogramSampleRate
+        */
+        unsigned long getDeltaSummaryChecks() const {
+            return deltaSummaryChecks.load();
+        }
+
+        /**
+        * number of delta summaries which let a sampled walk skip their run of record deltas
+        */
+        unsigned long getDeltaSummarySkips() const {
+            return deltaSummarySkips.load();
+        }
+
+        /**
+        * number of leaves written to the page store, relocations by its cleaning excluded
+        */
+        unsigned long getEvictedPages() const {
+            return evictedPages.load();
+        }
+
+        /**
+        * number of evicted leaves which were read back into memory
+        */
+        unsigned long getFaultedPages() const {
+            return faultedPages.load();
+        }
+
+        /**
+        * number of live pages moved by the cleaning of the page store
+        */
+        unsigned long getRelocatedPages() const {
+            return relocatedPages.load();
+        }
+
+        /**
+        * the evictor stopped after an I/O error of the page store, pages are no longer evicted
+        */
+        bool hasEvictionFailed() const {
+            return evictorFailed.load();
+        }
+
+        SMOStatistics getSMOStatistics() const;
+
+        /**
+        * Snapshot of the counters and histograms of the tree, the mapping table occupancy is computed by scanning the table.
+        */
+        Metrics metrics() const;
+
+        const SMOPolicy &getSMOPolicy() const {
+            return *smoPolicy;
         }
 
     };
@@ -0,0 +1,294 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+#include <unordered_map>
+#include "checkpoint.hpp"
+#include "fileio.hpp"
+
+namespace BwTree {
+
+    namespace {
+        // size of the writes of a checkpoint and of the reads of a restore
+        constexpr std::size_t checkpointIOSize = 8 * 1024 * 1024;
+    }
+
+    template<typename Key, typename Data>
+    PID Tree<Key, Data>::getLeftmostLeaf() {
+        // pages are never merged, so the leftmost leaf keeps its PID
+        PID pid = root.load();
+        while (true) {
+            Node<Key, Data> *node = PIDToNodePtr(pid);
+            while (node->getType() != PageType::inner && node->getType() != PageType::leaf) {
+                node = static_cast<DeltaNode<Key, Data> *>(node)->origin;
+            }
+            if (node->getType() == PageType::leaf) {
+                return pid;
+            }
+            pid = static_cast<InnerNode<Key, Data> *>(node)->children()[0];
+        }
+    }
+
+    template<typename Key, typename Data>
+    template<typename Consumer>
+    void Tree<Key, Data>::forEachLeaf(ThreadInfo<Key, Data> &threadInfo, Consumer consumer) {
+        // every leaf is read in its own epoche, so the walk does not hold back reclamation. Records only move to new pages
+        // right of their page, the walk sees every record which is not modified concurrently exactly once.
+        std::vector<KeyValue<Key, Data>> records;
+        PID pid;
+        {
+            EpocheGuard<Key, Data> epocheGuard(threadInfo);
+            pid = getLeftmostLeaf();
+        }
+        while (pid != NotExistantPID) {
+            records.clear();
+            PID prev;
+            {
+                EpocheGuard<Key, Data> epocheGuard(threadInfo);
+                std::tie(prev, pid) = getConsolidatedLeafData(PIDToNodePtr(pid), records);
+            }
+            consumer(records);
+        }
+    }
+
+    template<typename Key, typename Data>
+    std::size_t Tree<Key, Data>::checkpoint(const std::string &path, ThreadInfo<Key, Data> &threadInfo) {
+        if (KeyTraits<Key>::variableLength || !ValueStorage<Data>::isInline) {
+            throw std::logic_error("BwTree::checkpoint requires fixed size keys and inline values");
+        }
+        const std::string temporaryPath = path + ".tmp";
+        FileDescriptor file(::open(temporaryPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644));
+        if (file.fd < 0) {
+            throw std::system_error(errno, std::generic_category(), "BwTree::checkpoint " + temporaryPath);
+        }
+        CheckpointHeader header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, checkpointMagic, sizeof(header.magic));
+        header.version = CheckpointHeader::currentVersion;
+        header.keySize = sizeof(Key);
+        header.dataSize = sizeof(Data);
+        header.recordSize = sizeof(Key) + sizeof(Data);
+
+        try {
+            if (wal) {
+                // Operations which took their position in the log before logStart are finished after synchronize, so their
+                // effects are in the checkpoint. The records up to logReplay are durable before the walk starts, records
+                // behind it may or may not be in the checkpoint.
+                header.logStart = wal->position();
+                epoque.synchronize(threadInfo);
+                header.logReplay = wal->flush();
+            }
+            // the records are packed, so the file contains no padding bytes of KeyValue
+            std::vector<char> buffer;
+            buffer.reserve(checkpointIOSize + header.recordSize);
+            off_t offset = sizeof(CheckpointHeader);
+            auto flush = [&]() {
+                writeAll(file.fd, buffer.data(), buffer.size(), offset, "BwTree::checkpoint " + temporaryPath);
+                offset += buffer.size();
+                header.recordCount += buffer.size() / header.recordSize;
+                buffer.clear();
+            };
+
+            forEachLeaf(threadInfo, [&](const std::vector<KeyValue<Key, Data>> &records) {
+                for (const KeyValue<Key, Data> &record : records) {
+                    const char *key = reinterpret_cast<const char *>(&record.key);
+                    const char *data = reinterpret_cast<const char *>(record.data());
+                    buffer.insert(buffer.end(), key, key + sizeof(Key));
+                    buffer.insert(buffer.end(), data, data + sizeof(Data));
+                }
+                if (buffer.size() >= checkpointIOSize) {
+                    flush();
+                }
+            });
+            flush();
+
+            writeAll(file.fd, &header, sizeof(header), 0, "BwTree::checkpoint " + temporaryPath);
+            if (::fsync(file.fd) != 0) {
+                throw std::system_error(errno, std::generic_category(), "BwTree::checkpoint " + temporaryPath);
+            }
+            if (::rename(temporaryPath.c_str(), path.c_str()) != 0) {
+                throw std::system_error(errno, std::generic_category(), "BwTree::checkpoint " + path);
+            }
+            syncParentDirectory(path, "BwTree::checkpoint " + path);
+        } catch (...) {
+            ::unlink(temporaryPath.c_str());
+            throw;
+        }
+        return header.recordCount;
+    }
+
+    template<typename Key, typename Data>
+    std::size_t Tree<Key, Data>::restore(const std::string &path, ThreadInfo<Key, Data> &threadInfo, unsigned threads, double fillFactor) {
+        CheckpointHeader header;
+        return restoreCheckpoint(path, threadInfo, threads, fillFactor, header);
+    }
+
+    template<typename Key, typename Data>
+    std::size_t Tree<Key, Data>::restoreCheckpoint(const std::string &path, ThreadInfo<Key, Data> &threadInfo, unsigned threads, double fillFactor,
+                                                   CheckpointHeader &header) {
+        if (KeyTraits<Key>::variableLength || !ValueStorage<Data>::isInline) {
+            throw std::logic_error("BwTree::restore requires fixed size keys and inline values");
+        }
+        FileDescriptor file(::open(path.c_str(), O_RDONLY));
+        if (file.fd < 0) {
+            throw std::system_error(errno, std::generic_category(), "BwTree::restore " + path);
+        }
+        int error;
+        if (!readAll(file.fd, &header, sizeof(header), 0, error)) {
+            if (error != 0) {
+                throw std::system_error(error, std::generic_category(), "BwTree::restore " + path);
+            }
+            throw std::runtime_error("BwTree::restore " + path + " is no checkpoint");
+        }
+        if (std::memcmp(header.magic, checkpointMagic, sizeof(header.magic)) != 0 || header.version != CheckpointHeader::currentVersion) {
+            throw std::runtime_error("BwTree::restore " + path + " is no checkpoint");
+        }
+        if (header.keySize != sizeof(Key) || header.dataSize != sizeof(Data) || header.recordSize != sizeof(Key) + sizeof(Data)) {
+            throw std::runtime_error("BwTree::restore " + path + " is a checkpoint of a tree of other types");
+        }
+        struct stat fileStat;
+        if (::fstat(file.fd, &fileStat) != 0) {
+            throw std::system_error(errno, std::generic_category(), "BwTree::restore " + path);
+        }
+        if (static_cast<std::uint64_t>(fileStat.st_size) != sizeof(header) + header.recordCount * header.recordSize) {
+            throw std::runtime_error("BwTree::restore " + path + " is truncated");
+        }
+
+        // the threads read adjacent parts of the file in large chunks
+        std::vector<KeyValue<Key, Data>> records(header.recordCount);
+        const std::size_t recordsPerRead = std::max<std::size_t>(1, checkpointIOSize / header.recordSize);
+        const std::size_t threadCount = std::max<std::size_t>(1, std::min<std::size_t>(threads, (records.size() + recordsPerRead - 1) / recordsPerRead));
+        std::vector<int> errors(threadCount, 0);
+        std::vector<char> unsorted(threadCount, false);
+        auto readRecords = [&](std::size_t thread_i) {
+            const std::size_t from = records.size() * thread_i / threadCount;
+            const std::size_t to = records.size() * (thread_i + 1) / threadCount;
+            std::vector<char> buffer(std::min(recordsPerRead, to - from) * header.recordSize);
+            for (std::size_t i = from; i < to; i += recordsPerRead) {
+                const std::size_t count = std::min(recordsPerRead, to - i);
+                if (!readAll(file.fd, buffer.data(), count * header.recordSize, sizeof(header) + i * header.recordSize, errors[thread_i])) {
+                    errors[thread_i] = errors[thread_i] != 0 ? errors[thread_i] : EIO;
+                    return;
+                }
+                for (std::size_t j = 0; j < count; ++j) {
+                    Key key;
+                    Data data;
+                    std::memcpy(&key, &buffer[j * header.recordSize], sizeof(Key));
+                    std::memcpy(&data, &buffer[j * header.recordSize + sizeof(Key)], sizeof(Data));
+                    records[i + j] = KeyValue<Key, Data>(key, &data);
+                }
+                // bulkLoad relies on sorted unique keys, including the boundary to the previous chunk
+                for (std::size_t j = std::max<std::size_t>(i, 1); j < i + count; ++j) {
+                    if (!(records[j - 1].key < records[j].key)) {
+                        unsorted[thread_i] = true;
+                        return;
+                    }
+                }
+            }
+        };
+        std::vector<std::thread> readers;
+        for (std::size_t thread_i = 1; thread_i < threadCount; ++thread_i) {
+            readers.push_back(std::thread(readRecords, thread_i));
+        }
+        readRecords(0);
+        for (auto &reader : readers) {
+            reader.join();
+        }
+        for (std::size_t thread_i = 0; thread_i < threadCount; ++thread_i) {
+            if (errors[thread_i] != 0) {
+                throw std::system_error(errors[thread_i], std::generic_category(), "BwTree::restore " + path);
+            }
+            if (unsorted[thread_i]) {
+                throw std::runtime_error("BwTree::restore " + path + " contains unsorted records");
+            }
+        }
+        // the boundaries between the parts of the threads
+        for (std::size_t thread_i = 1; thread_i < threadCount; ++thread_i) {
+            const std::size_t from = records.size() * thread_i / threadCount;
+            if (from > 0 && from < records.size() && !(records[from - 1].key < records[from].key)) {
+                throw std::runtime_error("BwTree::restore " + path + " contains unsorted records");
+            }
+        }
+
+        bulkLoad(records.begin(), records.end(), fillFactor, threadInfo, threads);
+        return records.size();
+    }
+
+    template<typename Key, typename Data>
+    std::size_t Tree<Key, Data>::recover(const std::string &checkpointPath, ThreadInfo<Key, Data> &threadInfo, unsigned threads) {
+        if (!wal) {
+            throw std::logic_error("BwTree::recover requires a write ahead log");
+        }
+        CheckpointHeader header;
+        header.logStart = 0;
+        header.logReplay = 0;
+        if (::access(checkpointPath.c_str(), F_OK) == 0) {
+            restoreCheckpoint(checkpointPath, threadInfo, threads, 0.8, header);
+        } else {
+            EpocheGuard<Key, Data> epoqueGuard(threadInfo);
+            getEmptyTreePages("BwTree::recover");
+        }
+
+        struct LatestRecord {
+            std::uint64_t lsn;
+            std::uint64_t position;
+            WALRecordType type;
+            ValueStorage<Data> value;
+        };
+        struct KeyHash {
+            std::size_t operator()(const Key &key) const {
+                return static_cast<std::size_t>(KeyTraits<Key>::hash(key));
+            }
+        };
+        // the modifications of a key can be in the log in another order than they were applied, the LSN decides
+        std::unordered_map<Key, LatestRecord, KeyHash> latest;
+        wal->read(header.logStart, [&](std::uint64_t position, std::uint64_t lsn, WALRecordType type, const char *keyBytes, std::uint32_t keySize,
+                                       const char *value, std::uint32_t valueSize) {
+            if (keySize != sizeof(Key) || (type == WALRecordType::insert && valueSize != sizeof(Data))) {
+                throw std::runtime_error("BwTree::recover " + settings.getWALPath() + " is a log of a tree of other types");
+            }
+            Key key;
+            std::memcpy(&key, keyBytes, sizeof(Key));
+            auto it = latest.find(key);
+            if (it != latest.end() && it->second.lsn > lsn) {
+                return;
+            }
+            LatestRecord &record = latest[key];
+            record.lsn = lsn;
+            record.position = position;
+            record.type = type;
+            if (type == WALRecordType::insert) {
+                std::memcpy(&record.value, value, sizeof(Data));
+            }
+        });
+
+        // records before logReplay which are the last of their key are already in the checkpoint
+        std::vector<KeyValue<Key, Data>> inserts;
+        std::vector<Key> deletes;
+        for (const auto &entry : latest) {
+            if (entry.second.position < header.logReplay) {
+                continue;
+            }
+            if (entry.second.type == WALRecordType::insert) {
+                inserts.push_back(KeyValue<Key, Data>(entry.first, entry.second.value));
+            } else {
+                deletes.push_back(entry.first);
+            }
+        }
+        replaying = true;
+        try {
+            insertBatch(inserts, threadInfo);
+            for (const Key &key : deletes) {
+                deleteKey(key, threadInfo);
+            }
+        } catch (...) {
+            replaying = false;
+            throw;
+        }
+        replaying = false;
+        return inserts.size() + deletes.size();
+    }
+}
@@ -0,0 +1,32 @@
+#ifndef CHECKPOINT_HPP
+#define CHECKPOINT_HPP
+
+#include <cstdint>
+
+namespace BwTree {
+
+    /**
+    * A checkpoint file starts with this header, it is followed by recordCount records sorted by key, every record as the bytes
+    * of its key directly followed by the bytes of its value (in the byte order of the machine, without padding). So only fixed
+    * size keys and inline values can be written, the sizes in the header guard against restoring into a tree of other types.
+    * A checkpoint of a tree with a write ahead log records where recovery reads the log: records from logStart on may
+    * be newer than the checkpoint, those from logReplay on are newer than it unless a newer record of their key precedes them.
+    */
+    struct CheckpointHeader {
+        static constexpr std::uint32_t currentVersion = 3;
+
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t keySize;
+        std::uint32_t dataSize;
+        std::uint32_t recordSize;
+        std::uint64_t recordCount;
+        // positions in the write ahead log, 0 without one
+        std::uint64_t logStart;
+        std::uint64_t logReplay;
+    };
+
+    constexpr char checkpointMagic[8] = {'B', 'w', 'T', 'r', 'e', 'e', 'C', 'P'};
+}
+
+#endif
@@ -1,5 +1,7 @@
 #include <assert.h>
 #include <iostream>
+#include <stdexcept>
+#include <algorithm>
 #include "epoque.hpp"
 
 namespace BwTree {
@@ -29,6 +31,7 @@ namespace BwTree {
             prev->next = label->next;
         }
         deletitionListCount -= label->nodesCount;
+        pendingBytes.store(pendingBytes.load(std::memory_order_relaxed) - label->bytes, std::memory_order_relaxed);
 
         label->next = freeLabelDeletes;
         freeLabelDeletes = label;
@@ -37,7 +40,7 @@ namespace BwTree {
     }
 
     template<typename Key, typename Data>
-    void DeletionList<Key, Data>::add(Node<Key, Data> *n) {
+    void DeletionList<Key, Data>::add(Node<Key, Data> *n, std::size_t bytes, uint64_t epoche) {
         deletitionListCount++;
         LabelDelete<Key, Data> *label;
         if (headDeletionList != nullptr && headDeletionList->nodesCount < headDeletionList->nodes.size()) {
@@ -50,112 +53,428 @@ namespace BwTree {
                 label = new LabelDelete<Key, Data>();
             }
             label->nodesCount = 0;
+            label->bytes = 0;
             label->next = headDeletionList;
             headDeletionList = label;
         }
         label->nodes[label->nodesCount] = n;
         label->nodesCount++;
-        label->epoche = localEpoche;
+        label->bytes += bytes;
+        label->epoche = epoche;
+        pendingBytes.store(pendingBytes.load(std::memory_order_relaxed) + bytes, std::memory_order_relaxed);
 
         added++;
     }
 
+    template<typename Key, typename Data>
+    LabelDelete<Key, Data> *DeletionList<Key, Data>::takeAll(std::size_t &bytes) {
+        LabelDelete<Key, Data> *labels = headDeletionList;
+        bytes = pendingBytes.load(std::memory_order_relaxed);
+        headDeletionList = nullptr;
+        deletitionListCount = 0;
+        pendingBytes.store(0, std::memory_order_relaxed);
+        return labels;
+    }
+
+    template<typename Key, typename Data>
+    std::size_t DeletionList<Key, Data>::append(LabelDelete<Key, Data> *labels) {
+        std::size_t bytes = 0;
+        LabelDelete<Key, Data> *last = labels;
+        while (true) {
+            deletitionListCount += last->nodesCount;
+            bytes += last->bytes;
+            if (last->next == nullptr) {
+                break;
+            }
+            last = last->next;
+        }
+        last->next = headDeletionList;
+        headDeletionList = labels;
+        pendingBytes.store(pendingBytes.load(std::memory_order_relaxed) + bytes, std::memory_order_relaxed);
+        return bytes;
+    }
+
     template<typename Key, typename Data>
     LabelDelete<Key, Data> *DeletionList<Key, Data>::head() {
         return headDeletionList;
     }
 
+    template<typename Key, typename Data>
+    constexpr std::chrono::milliseconds Epoche<Key, Data>::reclaimerInterval;
+
+    template<typename Key, typename Data>
+    Epoche<Key, Data>::Epoche(size_t startGCThreshhold, bool reclaimerThread, std::size_t maxPendingBytes, std::size_t maxThreads)
+            : maxSlots(maxThreads), slots(new EpocheSlot<Key, Data>[maxThreads]), startGCThreshhold(startGCThreshhold), maxPendingBytes(maxPendingBytes) {
+        if (reclaimerThread) {
+            reclaimer = std::thread(&Epoche<Key, Data>::runReclaimer, this);
+        }
+    }
+
+    template<typename Key, typename Data>
+    EpocheSlot<Key, Data> *Epoche<Key, Data>::acquireSlot() {
+        while (true) {
+            const std::size_t count = slotCount.load();
+            for (std::size_t i = 0; i < count; ++i) {
+                bool expected = false;
+                if (!slots[i].inUse.load(std::memory_order_relaxed) && slots[i].inUse.compare_exchange_strong(expected, true)) {
+                    return &slots[i];
+                }
+            }
+            std::size_t next = count;
+            if (next >= maxSlots) {
+                throw std::length_error("BwTree epoche has no free thread slot");
+            }
+            if (slotCount.compare_exchange_strong(next, next + 1)) {
+                bool expected = false;
+                // another thread may have taken the new slot in its scan already
+                if (slots[next].inUse.compare_exchange_strong(expected, true)) {
+                    return &slots[next];
+                }
+            }
+        }
+    }
+
+    template<typename Key, typename Data>
+    void Epoche<Key, Data>::releaseSlot(EpocheSlot<Key, Data> *slot) {
+        assert(slot->depth == 0);
+        slot->localEpoche.store(std::numeric_limits<uint64_t>::max());
+        handOver(slot->deletionList);
+        slot->deletionList.thresholdCounter = 1;
+        slot->sessionOperations = 0;
+        slot->inUse.store(false, std::memory_order_release);
+    }
+
+    template<typename Key, typename Data>
+    void Epoche<Key, Data>::handOver(DeletionList<Key, Data> &deletionList) {
+        std::size_t bytes;
+        LabelDelete<Key, Data> *labels = deletionList.takeAll(bytes);
+        if (labels == nullptr) {
+            return;
+        }
+        LabelDelete<Key, Data> *last = labels;
+        while (last->next != nullptr) {
+            last = last->next;
+        }
+        handedOverBytes.fetch_add(bytes);
+        LabelDelete<Key, Data> *head = handedOver.load();
+        do {
+            last->next = head;
+        } while (!handedOver.compare_exchange_weak(head, labels));
+    }
+
+    template<typename Key, typename Data>
+    void Epoche<Key, Data>::registerThread(ThreadInfo<Key, Data> &info) {
+        assert(&info.epoche == this);
+        if (info.slot == nullptr) {
+            info.slot = acquireSlot();
+        }
+    }
+
+    template<typename Key, typename Data>
+    void Epoche<Key, Data>::unregisterThread(ThreadInfo<Key, Data> &info) {
+        if (info.slot != nullptr) {
+            releaseSlot(info.slot);
+            info.slot = nullptr;
+        }
+    }
+
+    template<typename Key, typename Data>
+    void Epoche<Key, Data>::enterQuiescentState(ThreadInfo<Key, Data> &info) {
+        EpocheSlot<Key, Data> &slot = *info.slot;
+        assert(slot.depth == 0);
+        // the next enterEpoche publishes the then current epoche again
+        const uint64_t entered = slot.localEpoche.load(std::memory_order_relaxed);
+        slot.localEpoche.store(std::numeric_limits<uint64_t>::max());
+        // a thread which goes idle after every few operations would otherwise only hand over and never advance the epoche
+        collect(slot, entered);
+        handOver(slot.deletionList);
+        slot.deletionList.thresholdCounter = 1;
+    }
+
+    template<typename Key, typename Data>
+    void Epoche<Key, Data>::synchronize(ThreadInfo<Key, Data> &info) {
+        assert(info.slot->depth == 0);
+        // threads which enter from now on see everything before the call, threads in older epoches have to leave them
+        const uint64_t epoche = currentEpoche.fetch_add(1) + 1;
+        const std::size_t count = slotCount.load();
+        for (std::size_t i = 0; i < count; ++i) {
+            if (&slots[i] == info.slot) {
+                continue;
+            }
+            // a thread which sets active after the load reads the advanced epoche or starts its operation after the call
+            while (slots[i].active.load() && slots[i].localEpoche.load() < epoche) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
     template<typename Key, typename Data>
     void Epoche<Key, Data>::enterEpoche(ThreadInfo<Key, Data> &epocheInfo) {
+        // an unregistered ThreadInfo has no slot
+        assert(epocheInfo.slot != nullptr);
+        EpocheSlot<Key, Data> &slot = *epocheInfo.slot;
+        if (slot.depth++ > 0) {
+            if (slot.depth == 2 && slot.inSession) {
+                slot.active.store(true);
+            }
+            return;
+        }
+        // before the epoche is read, see synchronize
+        slot.active.store(true);
         unsigned long curEpoche = currentEpoche.load();
-        if (curEpoche != epocheInfo.getDeletionList().localEpoche) {
-            epocheInfo.getDeletionList().localEpoche.store(curEpoche);
+        if (curEpoche != slot.localEpoche.load(std::memory_order_relaxed)) {
+            slot.localEpoche.store(curEpoche);
         }
     }
 
     template<typename Key, typename Data>
     void Epoche<Key, Data>::markNodeForDeletion(Node<Key, Data> *n, ThreadInfo<Key, Data> &epocheInfo) {
-        epocheInfo.getDeletionList().add(n);
+        epocheInfo.getDeletionList().add(n, chainSize(n), currentEpoche.load());
         epocheInfo.getDeletionList().thresholdCounter++;
     }
 
     template<typename Key, typename Data>
-    void Epoche<Key, Data>::exitEpocheAndCleanup(ThreadInfo<Key, Data> &epocheInfo) {
+    void Epoche<Key, Data>::markPIDForReuse(PID pid, ThreadInfo<Key, Data> &epocheInfo) {
+        auto &deletionList = epocheInfo.getDeletionList();
+        deletionList.retiredPIDs.push_back(std::make_tuple(currentEpoche.load(), pid));
+        deletionList.thresholdCounter++;
+    }
+
+    template<typename Key, typename Data>
+    bool Epoche<Key, Data>::getReusablePID(PID &pid, ThreadInfo<Key, Data> &epocheInfo) {
         auto &deletionList = epocheInfo.getDeletionList();
-        if ((deletionList.thresholdCounter & (64 - 1)) == 0) {
-            currentEpoche.fetch_add(1);
+        if (deletionList.freePIDs.empty()) {
+            return false;
         }
-        if (deletionList.thresholdCounter > startGCThreshhold) {
-            if (deletionList.size() == 0) {
-                deletionList.thresholdCounter = 1;
-                return;
+        pid = deletionList.freePIDs.back();
+        deletionList.freePIDs.pop_back();
+        deletionList.reusedPIDs++;
+        return true;
+    }
+
+    template<typename Key, typename Data>
+    void Epoche<Key, Data>::exitEpocheAndCleanup(ThreadInfo<Key, Data> &epocheInfo) {
+        EpocheSlot<Key, Data> &slot = *epocheInfo.slot;
+        assert(slot.depth > 0);
+        if (--slot.depth > 0) {
+            if (slot.depth == 1 && slot.inSession) {
+                slot.active.store(false, std::memory_order_release);
+                sessionOperationFinished(slot);
             }
-            deletionList.localEpoche.store(std::numeric_limits<uint64_t>::max());
+            return;
+        }
+        slot.active.store(false, std::memory_order_release);
+        if (needsCollect(slot)) {
+            const uint64_t entered = slot.localEpoche.load(std::memory_order_relaxed);
+            slot.localEpoche.store(std::numeric_limits<uint64_t>::max());
+            collect(slot, entered);
+        }
+    }
 
-            uint64_t oldestEpoche = std::numeric_limits<uint64_t>::max();
-            for (auto &epoche : deletionLists) {
-                auto e = epoche.localEpoche.load();
-                if (e < oldestEpoche) {
-                    oldestEpoche = e;
-                }
+    template<typename Key, typename Data>
+    void Epoche<Key, Data>::enterSession(ThreadInfo<Key, Data> &info) {
+        assert(!info.slot->inSession);
+        enterEpoche(info);
+        if (info.slot->depth == 1) {
+            info.slot->inSession = true;
+            info.slot->active.store(false, std::memory_order_release);
+        }
+    }
+
+    template<typename Key, typename Data>
+    void Epoche<Key, Data>::exitSession(ThreadInfo<Key, Data> &info) {
+        info.slot->inSession = false;
+        exitEpocheAndCleanup(info);
+    }
+
+    template<typename Key, typename Data>
+    void Epoche<Key, Data>::sessionOperationFinished(EpocheSlot<Key, Data> &slot) {
+        const bool collectNow = needsCollect(slot);
+        if (++slot.sessionOperations % sessionRefreshInterval != 0 && !collectNow) {
+            return;
+        }
+        if (collectNow) {
+            const uint64_t entered = slot.localEpoche.load(std::memory_order_relaxed);
+            slot.localEpoche.store(std::numeric_limits<uint64_t>::max());
+            collect(slot, entered);
+        }
+        unsigned long curEpoche = currentEpoche.load();
+        if (curEpoche != slot.localEpoche.load(std::memory_order_relaxed)) {
+            slot.localEpoche.store(curEpoche);
+        }
+    }
+
+    template<typename Key, typename Data>
+    uint64_t Epoche<Key, Data>::refreshOldestEpoche() {
+        // threads which enter after the scan get at least the current epoche
+        uint64_t oldest = currentEpoche.load();
+        const std::size_t count = slotCount.load();
+        for (std::size_t i = 0; i < count; ++i) {
+            const uint64_t e = slots[i].localEpoche.load();
+            if (e < oldest) {
+                oldest = e;
             }
+        }
+        uint64_t cached = oldestEpoche.load();
+        while (cached < oldest && !oldestEpoche.compare_exchange_weak(cached, oldest)) { }
+        return std::max(cached, oldest);
+    }
 
-            LabelDelete<Key, Data> *cur = deletionList.head(), *next, *prev = nullptr;
-            while (cur != nullptr) {
-                next = cur->next;
+    template<typename Key, typename Data>
+    std::size_t Epoche<Key, Data>::freeNodesOlderThan(DeletionList<Key, Data> &deletionList, uint64_t oldest) {
+        std::size_t freed = 0;
+        LabelDelete<Key, Data> *cur = deletionList.head(), *next, *prev = nullptr;
+        while (cur != nullptr) {
+            next = cur->next;
 
-                if (cur->epoche < oldestEpoche) {
-                    for (std::size_t i = 0; i < cur->nodesCount; ++i) {
-                        freeNodeRecursively(cur->nodes[i]);
-                    }
-                    deletionList.remove(cur, prev);
-                } else {
-                    prev = cur;
+            if (cur->epoche < oldest) {
+                for (std::size_t i = 0; i < cur->nodesCount; ++i) {
+                    freeNodeRecursively(cur->nodes[i]);
                 }
-                cur = next;
+                freed += cur->bytes;
+                deletionList.remove(cur, prev);
+            } else {
+                prev = cur;
             }
-            deletionList.thresholdCounter = 1;
+            cur = next;
         }
+        return freed;
     }
 
     template<typename Key, typename Data>
-    Epoche<Key, Data>::~Epoche() {
-        uint64_t oldestEpoche = std::numeric_limits<uint64_t>::max();
-        for (auto &epoche : deletionLists) {
-            auto e = epoche.localEpoche.load();
-            if (e < oldestEpoche) {
-                oldestEpoche = e;
+    std::size_t Epoche<Key, Data>::reusePIDsOlderThan(DeletionList<Key, Data> &deletionList, uint64_t oldest) {
+        // retiredPIDs is ordered by epoche
+        auto &retired = deletionList.retiredPIDs;
+        std::size_t reusable = 0;
+        while (reusable < retired.size() && std::get<0>(retired[reusable]) < oldest) {
+            deletionList.freePIDs.push_back(std::get<1>(retired[reusable]));
+            ++reusable;
+        }
+        retired.erase(retired.begin(), retired.begin() + reusable);
+        return reusable;
+    }
+
+    template<typename Key, typename Data>
+    void Epoche<Key, Data>::freeAll(DeletionList<Key, Data> &deletionList) {
+        freeNodesOlderThan(deletionList, std::numeric_limits<uint64_t>::max());
+    }
+
+    template<typename Key, typename Data>
+    void Epoche<Key, Data>::collect(EpocheSlot<Key, Data> &slot, uint64_t entered) {
+        auto &deletionList = slot.deletionList;
+        if (deletionList.size() == 0 && deletionList.retiredPIDs.empty()) {
+            deletionList.thresholdCounter = 1;
+            return;
+        }
+        // the garbage of this round can be freed once all threads moved past the epoche the thread was in
+        currentEpoche.compare_exchange_strong(entered, entered + 1);
+
+        const bool overBudget = maxPendingBytes > 0 && pendingGarbageBytes() > maxPendingBytes;
+        if (reclaimer.joinable() && !overBudget) {
+            handOver(deletionList);
+            reusePIDsOlderThan(deletionList, oldestEpoche.load());
+        } else {
+            // without a reclaimer the garbage left behind by other threads is freed here, with one if it falls behind
+            if (handedOver.load(std::memory_order_relaxed) != nullptr) {
+                LabelDelete<Key, Data> *labels = handedOver.exchange(nullptr);
+                if (labels != nullptr) {
+                    handedOverBytes.fetch_sub(deletionList.append(labels));
+                }
+            }
+            if (reclaimer.joinable()) {
+                reclaimerWakeup.notify_one();
+            }
+            uint64_t oldest = oldestEpoche.load();
+            if (overBudget || freeNodesOlderThan(deletionList, oldest) + reusePIDsOlderThan(deletionList, oldest) == 0) {
+                oldest = refreshOldestEpoche();
+                freeNodesOlderThan(deletionList, oldest);
+                reusePIDsOlderThan(deletionList, oldest);
             }
         }
-        for (auto &d : deletionLists) {
-            LabelDelete<Key, Data> *cur = d.head(), *next, *prev = nullptr;
-            while (cur != nullptr) {
-                next = cur->next;
+        // nodes of other threads go back to their owners in batches, hand back the partial batches as well
+        NodeAllocator::flushRemoteFrees();
+        deletionList.thresholdCounter = 1;
+    }
 
-                assert(cur->epoche < oldestEpoche);
-                for (std::size_t i = 0; i < cur->nodesCount; ++i) {
-                    freeNodeRecursively(cur->nodes[i]);
+    template<typename Key, typename Data>
+    void Epoche<Key, Data>::runReclaimer() {
+        while (!reclaimerStop.load()) {
+            LabelDelete<Key, Data> *labels = handedOver.exchange(nullptr);
+            if (labels != nullptr) {
+                reclaimerList.append(labels);
+            }
+            std::size_t freed = 0;
+            if (reclaimerList.size() > 0) {
+                freed = freeNodesOlderThan(reclaimerList, refreshOldestEpoche());
+                handedOverBytes.fetch_sub(freed);
+                NodeAllocator::flushRemoteFrees();
+                if (reclaimerList.size() > 0) {
+                    // the reclaimer is in no epoche, the threads which still see the rest leave theirs eventually
+                    uint64_t current = currentEpoche.load();
+                    currentEpoche.compare_exchange_strong(current, current + 1);
                 }
-                d.remove(cur, prev);
-                cur = next;
+            }
+            if (labels == nullptr && freed == 0) {
+                std::unique_lock<std::mutex> lock(reclaimerMutex);
+                reclaimerWakeup.wait_for(lock, reclaimerInterval);
             }
         }
     }
 
+    template<typename Key, typename Data>
+    std::size_t Epoche<Key, Data>::pendingGarbageBytes() const {
+        std::size_t bytes = handedOverBytes.load();
+        const std::size_t count = slotCount.load();
+        for (std::size_t i = 0; i < count; ++i) {
+            bytes += slots[i].deletionList.pendingBytes.load(std::memory_order_relaxed);
+        }
+        return bytes;
+    }
+
+    template<typename Key, typename Data>
+    Epoche<Key, Data>::~Epoche() {
+        if (reclaimer.joinable()) {
+            reclaimerStop.store(true);
+            reclaimerWakeup.notify_one();
+            reclaimer.join();
+        }
+        // no thread can be in an epoche anymore, all garbage can be freed
+        LabelDelete<Key, Data> *labels = handedOver.exchange(nullptr);
+        if (labels != nullptr) {
+            reclaimerList.append(labels);
+        }
+        freeAll(reclaimerList);
+        const std::size_t count = slotCount.load();
+        for (std::size_t i = 0; i < count; ++i) {
+            freeAll(slots[i].deletionList);
+        }
+        delete[] slots;
+        NodeAllocator::flushRemoteFrees();
+    }
+
     template<typename Key, typename Data>
     void Epoche<Key, Data>::showDeleteRatio() {
-        for (auto &d : deletionLists) {
-            std::cout << "deleted " << d.deleted << " of " << d.added << std::endl;
+        const std::size_t count = slotCount.load();
+        for (std::size_t i = 0; i < count; ++i) {
+            auto &d = slots[i].deletionList;
+            std::cout << "deleted " << d.deleted << " of " << d.added << ", reused PIDs " << d.reusedPIDs << ", pending bytes " << d.pendingBytes.load() << std::endl;
         }
+        std::cout << "handed over to the reclaimer, pending bytes " << handedOverBytes.load() << std::endl;
     }
 
     template<typename Key, typename Data>
     ThreadInfo<Key, Data>::ThreadInfo(Epoche<Key, Data> &epoche)
-            : epoche(epoche), deletionList(epoche.deletionLists.local()) { }
+            : epoche(epoche), slot(epoche.acquireSlot()) { }
+
+    template<typename Key, typename Data>
+    ThreadInfo<Key, Data>::ThreadInfo(ThreadInfo &&other)
+            : epoche(other.epoche), slot(other.slot) {
+        other.slot = nullptr;
+    }
 
     template<typename Key, typename Data>
     DeletionList<Key, Data> &ThreadInfo<Key, Data>::getDeletionList() const {
-        return deletionList;
+        return slot->deletionList;
     }
 
     template<typename Key, typename Data>
@@ -165,6 +484,8 @@ namespace BwTree {
 
     template<typename Key, typename Data>
     ThreadInfo<Key, Data>::~ThreadInfo() {
-        deletionList.localEpoche.store(std::numeric_limits<uint64_t>::max());
+        if (slot != nullptr) {
+            epoche.releaseSlot(slot);
+        }
     }
-}
\ No newline at end of file
+}
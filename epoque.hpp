@@ -3,9 +3,14 @@
 
 #include <sys/wait.h>
 #include <atomic>
+#include <vector>
+#include <tuple>
+#include <limits>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
 #include "nodes.hpp"
-#include "tbb/enumerable_thread_specific.h"
-#include "tbb/combinable.h"
 
 namespace BwTree {
 
@@ -14,6 +19,8 @@ namespace BwTree {
         std::array<Node<Key, Data>*, 16> nodes;
         uint64_t epoche;
         std::size_t nodesCount;
+        // of the delta chains starting at nodes
+        std::size_t bytes;
         LabelDelete *next;
     };
 
@@ -24,33 +31,83 @@ namespace BwTree {
         std::size_t deletitionListCount = 0;
 
     public:
-        std::atomic<uint64_t> localEpoche;
         size_t thresholdCounter{1};
+        // bytes of the delta chains in the list, written by the owner only
+        std::atomic<std::size_t> pendingBytes{0};
 
         ~DeletionList();
         LabelDelete<Key, Data> *head();
 
-        void add(Node<Key, Data> *n);
+        /**
+        * epoche has to be the global epoche at the time the node was unlinked, a thread which entered later cannot see it anymore
+        */
+        void add(Node<Key, Data> *n, std::size_t bytes, uint64_t epoche);
 
         void remove(LabelDelete<Key, Data> *label, LabelDelete<Key, Data> *prev);
 
+        /**
+        * removes all labels from the list and returns them as a chain, bytes gets their size
+        */
+        LabelDelete<Key, Data> *takeAll(std::size_t &bytes);
+
+        /**
+        * adds the labels of a chain returned by takeAll, returns their size
+        */
+        std::size_t append(LabelDelete<Key, Data> *labels);
+
         std::size_t size();
 
+        /**
+        * PIDs whose mapping table entry was cleared, tagged with the epoche in which they were retired.
+        * They are moved to freePIDs once no thread can still see them.
+        */
+        std::vector<std::tuple<uint64_t, PID>> retiredPIDs;
+        std::vector<PID> freePIDs;
+
         std::uint64_t deleted = 0;
         std::uint64_t added = 0;
+        std::uint64_t reusedPIDs = 0;
+    };
+
+    /**
+    * Epoche record of one ThreadInfo. localEpoche and active are read by other threads, they have their own cache line,
+    * everything else is only accessed by the owner.
+    */
+    template <typename Key, typename Data>
+    struct EpocheSlot {
+        char padding0[64];
+        // epoche the owner entered, max if it is in none. It stays set after an operation until the owner collects.
+        std::atomic<uint64_t> localEpoche{std::numeric_limits<uint64_t>::max()};
+        // the owner is inside an operation, between the operations of a session it is not
+        std::atomic<bool> active{false};
+        std::atomic<bool> inUse{false};
+        char padding1[64];
+
+        DeletionList<Key, Data> deletionList;
+        // nesting depth of the EpocheGuards and EpocheSessions of the owner
+        unsigned depth = 0;
+        bool inSession = false;
+        std::size_t sessionOperations = 0;
     };
 
     template <typename Key, typename Data>
     class Epoche;
     template <typename Key, typename Data>
     class EpocheGuard;
+    template <typename Key, typename Data>
+    class EpocheSession;
 
+    /**
+    * Registration of a thread at the epoche of a tree, owns one of its slots until it is unregistered.
+    * A ThreadInfo must only be used by one thread at a time.
+    */
     template <typename Key, typename Data>
     class ThreadInfo {
         friend class Epoche<Key, Data>;
         friend class EpocheGuard<Key, Data>;
+        friend class EpocheSession<Key, Data>;
         Epoche<Key, Data> &epoche;
-        DeletionList<Key, Data> &deletionList;
+        EpocheSlot<Key, Data> *slot;
 
         Epoche<Key, Data> &getEpoche() const;
 
@@ -58,20 +115,125 @@ namespace BwTree {
     public:
         ThreadInfo(Epoche<Key, Data> &epoche);
 
+        ThreadInfo(ThreadInfo &&other);
+
+        ThreadInfo(const ThreadInfo &) = delete;
+
+        ThreadInfo &operator=(const ThreadInfo &) = delete;
+
         ~ThreadInfo();
     };
 
+    /**
+    * Epoche based reclamation without a central list of threads.
+    *
+    * Every ThreadInfo owns one slot of a fixed array, computing the oldest epoche scans the slots up to the highest one
+    * ever used. The result is cached in oldestEpoche and only recomputed when the cached value does not allow a thread
+    * to free any of its garbage. currentEpoche is advanced when a thread collects its garbage, and only if no other thread
+    * advanced it since this thread entered its epoche, so concurrent collections do not all write it.
+    *
+    * With a reclaimer thread, a collecting thread only hands its retired nodes over to the reclaimer, which frees them
+    * once no thread can see them anymore. Retired PIDs always stay with the slot, they are reused by its owner.
+    * Threads which unregister or enter a quiescent state hand their retired nodes over as well, without a reclaimer
+    * the next thread which collects its garbage takes them.
+    * If maxPendingBytes is set and more bytes await reclamation, collecting threads take the garbage the reclaimer has not
+    * picked up yet and free what they can themselves. Garbage which a thread in an old epoche can still see cannot be freed,
+    * the limit can be exceeded by it.
+    */
     template <typename Key, typename Data>
     class Epoche {
         friend class ThreadInfo<Key, Data>;
+        char padding0[64];
         std::atomic<uint64_t> currentEpoche{0};
+        char padding1[64];
+        // no thread is in an epoche older than this
+        std::atomic<uint64_t> oldestEpoche{0};
+        char padding2[64];
+
+        const std::size_t maxSlots;
+        EpocheSlot<Key, Data> *const slots;
+        // slots above have never been used
+        std::atomic<std::size_t> slotCount{0};
+
+        const size_t startGCThreshhold;
+        // 0 is unlimited
+        const std::size_t maxPendingBytes;
+
+        char padding3[64];
+        // stack of LabelDelete chains handed over to the reclaimer or left behind by threads which unregistered
+        std::atomic<LabelDelete<Key, Data> *> handedOver{nullptr};
+        // of the garbage handed over which is not freed yet, including the one taken from the stack
+        std::atomic<std::size_t> handedOverBytes{0};
+        char padding4[64];
+
+        // only accessed by the reclaimer
+        DeletionList<Key, Data> reclaimerList;
+        std::atomic<bool> reclaimerStop{false};
+        std::mutex reclaimerMutex;
+        std::condition_variable reclaimerWakeup;
+        std::thread reclaimer;
+
+        EpocheSlot<Key, Data> *acquireSlot();
+
+        /**
+        * hands the retired nodes of the slot over, its owner must not be in an epoche
+        */
+        void releaseSlot(EpocheSlot<Key, Data> *slot);
+
+        /**
+        * pushes all retired nodes of the list onto the handedOver stack
+        */
+        void handOver(DeletionList<Key, Data> &deletionList);
+
+        /**
+        * scans all slots, updates the cached oldest epoche and returns it
+        */
+        uint64_t refreshOldestEpoche();
+
+        /**
+        * frees the nodes of the list which are older than oldest, returns the freed bytes
+        */
+        std::size_t freeNodesOlderThan(DeletionList<Key, Data> &deletionList, uint64_t oldest);
+
+        /**
+        * moves the retired PIDs of the list which are older than oldest to its free PIDs, returns their number
+        */
+        std::size_t reusePIDsOlderThan(DeletionList<Key, Data> &deletionList, uint64_t oldest);
+
+        void freeAll(DeletionList<Key, Data> &deletionList);
+
+        bool needsCollect(EpocheSlot<Key, Data> &slot) const {
+            return slot.deletionList.thresholdCounter > startGCThreshhold ||
+                   (maxPendingBytes > 0 && slot.deletionList.pendingBytes.load(std::memory_order_relaxed) > maxPendingBytes);
+        }
 
-        tbb::enumerable_thread_specific<DeletionList<Key, Data>> deletionLists;
+        /**
+        * the owner of the slot must not be in an epoche, entered is the epoche it was in before
+        */
+        void collect(EpocheSlot<Key, Data> &slot, uint64_t entered);
 
-        size_t startGCThreshhold;
+        /**
+        * an operation inside an EpocheSession finished, the thread holds no references into the tree
+        */
+        void sessionOperationFinished(EpocheSlot<Key, Data> &slot);
+
+        void runReclaimer();
 
     public:
-        Epoche(size_t startGCThreshhold) : startGCThreshhold(startGCThreshhold) { }
+        static constexpr std::size_t defaultMaxThreads = 256;
+        // operations after which a thread in a session moves on to the current epoche
+        static constexpr std::size_t sessionRefreshInterval = 64;
+        // the reclaimer checks at least this often whether it can free more of its garbage
+        static constexpr std::chrono::milliseconds reclaimerInterval{1};
+
+        /**
+        * at most maxThreads ThreadInfos can exist at the same time
+        */
+        Epoche(size_t startGCThreshhold, bool reclaimerThread = false, std::size_t maxPendingBytes = 0, std::size_t maxThreads = defaultMaxThreads);
+
+        Epoche(const Epoche &) = delete;
+
+        Epoche &operator=(const Epoche &) = delete;
 
         ~Epoche();
 
@@ -79,8 +241,60 @@ namespace BwTree {
 
         void markNodeForDeletion(Node<Key, Data> *n, ThreadInfo<Key, Data> &epocheInfo);
 
+        /**
+        * the PID may be handed out again as soon as no thread can hold it anymore
+        */
+        void markPIDForReuse(PID pid, ThreadInfo<Key, Data> &epocheInfo);
+
+        /**
+        * returns false if the thread has no PID which can be reused
+        */
+        bool getReusablePID(PID &pid, ThreadInfo<Key, Data> &epocheInfo);
+
         void exitEpocheAndCleanup(ThreadInfo<Key, Data> &info);
 
+        void enterSession(ThreadInfo<Key, Data> &info);
+
+        void exitSession(ThreadInfo<Key, Data> &info);
+
+        /**
+        * gives a ThreadInfo which was unregistered a slot again
+        */
+        void registerThread(ThreadInfo<Key, Data> &info);
+
+        /**
+        * Releases the slot of the ThreadInfo, it must not be in an epoche or session. Its retired nodes are handed over
+        * to be freed by other threads, its retired PIDs stay with the slot for its next owner.
+        */
+        void unregisterThread(ThreadInfo<Key, Data> &info);
+
+        /**
+        * The thread holds no references into the tree until its next operation, it must not be in an epoche or session.
+        * It no longer holds back reclamation, computing the oldest epoche skips it. It frees the retired nodes no other
+        * thread can see anymore and hands the rest over to be freed by other threads. A thread which goes idle, e.g. a worker
+        * of a pool which parks, calls this before.
+        */
+        void enterQuiescentState(ThreadInfo<Key, Data> &info);
+
+        /**
+        * Advances the epoche and waits until every other thread finished the operation it is in, the thread itself must
+        * not be in an epoche or session. Unlike reclamation, it does not wait for idle threads which still hold an old
+        * epoche, nor for threads of a session between two of its operations.
+        */
+        void synchronize(ThreadInfo<Key, Data> &info);
+
+        /**
+        * index of the slot of a registered ThreadInfo, below maxThreads and unique among the registered ThreadInfos
+        */
+        std::size_t slotIndex(const ThreadInfo<Key, Data> &info) const {
+            return info.slot - slots;
+        }
+
+        /**
+        * bytes of the nodes which have been retired but not freed yet
+        */
+        std::size_t pendingGarbageBytes() const;
+
         void showDeleteRatio();
 
     };
@@ -98,6 +312,29 @@ namespace BwTree {
             threadEpocheInfo.getEpoche().exitEpocheAndCleanup(threadEpocheInfo);
         }
     };
+
+    /**
+    * Keeps the thread in an epoche for a whole run of operations, the EpocheGuards of the operations inside only count
+    * their nesting and touch no shared state. Every sessionRefreshInterval operations, and whenever the thread has enough
+    * garbage to collect, the thread moves on to the current epoche between two operations, so a long session does not hold
+    * back reclamation. References into the tree must not be kept from one operation of a session to the next.
+    */
+    template <typename Key, typename Data>
+    class EpocheSession {
+        ThreadInfo<Key, Data> &threadInfo;
+    public:
+        EpocheSession(ThreadInfo<Key, Data> &threadInfo) : threadInfo(threadInfo) {
+            threadInfo.getEpoche().enterSession(threadInfo);
+        }
+
+        EpocheSession(const EpocheSession &) = delete;
+
+        EpocheSession &operator=(const EpocheSession &) = delete;
+
+        ~EpocheSession() {
+            threadInfo.getEpoche().exitSession(threadInfo);
+        }
+    };
 }
 
 #endif
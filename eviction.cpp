@@ -0,0 +1,163 @@
+#include <stdexcept>
+#include <system_error>
+#include "pagestore.hpp"
+
+namespace BwTree {
+
+    namespace {
+        // PIDs the evictor looks at in one epoche
+        constexpr std::size_t evictionChunk = 1024;
+    }
+
+    template<typename Key, typename Data>
+    Node<Key, Data> *Tree<Key, Data>::faultIn(PID pid, Node<Key, Data> *entry) {
+        while (PageStore::isReference(entry)) {
+            std::size_t size;
+            Node<Key, Data> *node = static_cast<Node<Key, Data> *>(pageStore->read(reinterpret_cast<std::uintptr_t>(entry), pid, size));
+            if (node == nullptr) {
+                // the page was relocated by the cleaning meanwhile
+                Node<Key, Data> *current = mapping.get(pid);
+                if (current == entry) {
+                    throw std::runtime_error("BwTree::PageStore " + settings.getPageStorePath() + " lost the page of PID " + std::to_string(pid));
+                }
+                entry = current;
+                continue;
+            }
+            if (mapping[pid].compare_exchange_strong(entry, node)) {
+                storedBytes.fetch_sub(size);
+                ++faultedPages;
+                mapping.setReferenced(pid);
+                return node;
+            }
+            // another thread faulted the page in first
+            NodeAllocator::deallocate(node, size);
+        }
+        return entry;
+    }
+
+    template<typename Key, typename Data>
+    std::size_t Tree<Key, Data>::stageEviction(PID pid, Node<Key, Data> *expected, const void *page, std::size_t size, ThreadInfo<Key, Data> &threadInfo) {
+        std::uintptr_t reference = pageStore->stage(pid, page, size);
+        std::size_t evicted = 0;
+        if (reference == 0) {
+            evicted = flushEvictions(threadInfo);
+            reference = pageStore->stage(pid, page, size);
+            assert(reference != 0);
+        }
+        pendingEvictions.push_back(PendingEviction{pid, expected, reference, size});
+        return evicted;
+    }
+
+    template<typename Key, typename Data>
+    std::size_t Tree<Key, Data>::flushEvictions(ThreadInfo<Key, Data> &threadInfo) {
+        // the mapping table entries only point to the pages once they are written
+        pageStore->writeStaged();
+        std::size_t evicted = 0;
+        for (const PendingEviction &eviction : pendingEvictions) {
+            Node<Key, Data> *expected = eviction.expected;
+            Node<Key, Data> *const stored = reinterpret_cast<Node<Key, Data> *>(eviction.reference);
+            if (!mapping[eviction.pid].compare_exchange_strong(expected, stored)) {
+                // the page was modified or faulted in meanwhile, the written copy is garbage
+                continue;
+            }
+            if (PageStore::isReference(eviction.expected)) {
+                ++relocatedPages;
+            } else {
+                storedBytes.fetch_add(eviction.size);
+                ++evictedPages;
+                epoque.markNodeForDeletion(eviction.expected, threadInfo);
+                evicted += eviction.size;
+            }
+        }
+        pendingEvictions.clear();
+        return evicted;
+    }
+
+    template<typename Key, typename Data>
+    void Tree<Key, Data>::cleanPageStore(ThreadInfo<Key, Data> &threadInfo) {
+        while (pageStore->usedBytes() > 2 * storedBytes.load() + 2 * PageStore::segmentSize) {
+            EpocheGuard<Key, Data> epocheGuard(threadInfo);
+            const bool cleaned = pageStore->forEachPageOfOldestSegment([&](std::uint64_t pid, std::uintptr_t reference, const char *page, std::size_t size) {
+                Node<Key, Data> *const stored = reinterpret_cast<Node<Key, Data> *>(reference);
+                if (mapping.get(pid) == stored) {
+                    stageEviction(pid, stored, page, size, threadInfo);
+                }
+            });
+            if (!cleaned) {
+                return;
+            }
+            flushEvictions(threadInfo);
+            pageStore->releaseOldestSegment();
+        }
+    }
+
+    template<typename Key, typename Data>
+    void Tree<Key, Data>::runEvictor() {
+        ThreadInfo<Key, Data> threadInfo(epoque);
+        // bytes of the nodes in memory as measured by the last sweep, the first sweep only measures
+        std::size_t measured = 0;
+        bool measuredOnce = false;
+        try {
+            while (!evictorStop.load()) {
+                const std::size_t budget = settings.getMemoryBudget();
+                // the measurement of the last sweep, reduced by the evictions of this one
+                std::size_t estimate = measured;
+                std::size_t resident = 0;
+                std::size_t evicted = 0;
+                const PID pids = mapping.size();
+                for (PID first = 0; first < pids && !evictorStop.load(); first += evictionChunk) {
+                    EpocheGuard<Key, Data> epocheGuard(threadInfo);
+                    std::size_t staged = 0;
+                    std::size_t chunkEvicted = 0;
+                    for (PID pid = first; pid < std::min<PID>(pids, first + evictionChunk); ++pid) {
+                        Node<Key, Data> *node = mapping.tryGet(pid);
+                        if (node == nullptr || PageStore::isReference(node)) {
+                            continue;
+                        }
+                        const std::size_t size = chainSize(node);
+                        resident += size;
+                        // a leaf which was accessed since the last sweep gets a second chance
+                        if (!measuredOnce || estimate <= budget + staged || !isLeaf(node) || isMapped(node) || mapping.testAndClearReferenced(pid)) {
+                            continue;
+                        }
+                        if (node->getType() != PageType::leaf) {
+                            // only consolidated leaves are evicted, cold delta chains are consolidated first
+                            consolidateLeafPage(pid, node, threadInfo);
+                            node = mapping.tryGet(pid);
+                            if (node == nullptr || node->getType() != PageType::leaf) {
+                                continue;
+                            }
+                        }
+                        const std::size_t pageSize = nodeSize(node);
+                        if (pageSize <= PageStore::maxPageSize()) {
+                            // the bytes of the delta chain are freed by the consolidation
+                            chunkEvicted += size - std::min(size, pageSize) + stageEviction(pid, node, node, pageSize, threadInfo);
+                            staged += size;
+                        }
+                    }
+                    if (staged > 0) {
+                        chunkEvicted += flushEvictions(threadInfo);
+                        evicted += chunkEvicted;
+                        estimate -= std::min(estimate, chunkEvicted);
+                        resident -= std::min(resident, chunkEvicted);
+                    }
+                }
+                measured = resident;
+                measuredOnce = true;
+                cleanPageStore(threadInfo);
+                if (evicted > 0 && measured > budget) {
+                    continue;
+                }
+                epoque.enterQuiescentState(threadInfo);
+                std::unique_lock<std::mutex> lock(evictorMutex);
+                evictorWakeup.wait_for(lock, PageStore::sweepInterval, [this]() {
+                    return evictorStop.load();
+                });
+            }
+        } catch (const std::system_error &) {
+            // the tree keeps working with the pages it has in memory
+            pendingEvictions.clear();
+            evictorFailed.store(true);
+        }
+    }
+}
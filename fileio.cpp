@@ -0,0 +1,89 @@
+#include <cerrno>
+#include <system_error>
+#include <fcntl.h>
+#include <unistd.h>
+#include "fileio.hpp"
+
+namespace BwTree {
+
+    namespace {
+        // reflected polynomial of CRC-32C
+        struct ChecksumTable {
+            std::uint32_t table[256];
+
+            constexpr ChecksumTable() : table() {
+                for (std::uint32_t i = 0; i < 256; ++i) {
+                    std::uint32_t crc = i;
+                    for (int bit = 0; bit < 8; ++bit) {
+                        crc = (crc >> 1) ^ (0x82F63B78u & (0u - (crc & 1u)));
+                    }
+                    table[i] = crc;
+                }
+            }
+        };
+
+        constexpr ChecksumTable checksumTable;
+    }
+
+    FileDescriptor::~FileDescriptor() {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+
+    void writeAll(int fd, const void *buffer, std::size_t size, off_t offset, const std::string &what) {
+        const char *bytes = static_cast<const char *>(buffer);
+        while (size > 0) {
+            const ssize_t written = ::pwrite(fd, bytes, size, offset);
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw std::system_error(errno, std::generic_category(), what);
+            }
+            bytes += written;
+            size -= written;
+            offset += written;
+        }
+    }
+
+    bool readAll(int fd, void *buffer, std::size_t size, off_t offset, int &error) {
+        char *bytes = static_cast<char *>(buffer);
+        while (size > 0) {
+            const ssize_t read = ::pread(fd, bytes, size, offset);
+            if (read < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                error = errno;
+                return false;
+            }
+            if (read == 0) {
+                error = 0;
+                return false;
+            }
+            bytes += read;
+            size -= read;
+            offset += read;
+        }
+        return true;
+    }
+
+    void syncParentDirectory(const std::string &path, const std::string &what) {
+        const std::size_t slash = path.rfind('/');
+        const std::string directory = slash == std::string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+        FileDescriptor file(::open(directory.c_str(), O_RDONLY | O_DIRECTORY));
+        if (file.fd < 0 || ::fsync(file.fd) != 0) {
+            throw std::system_error(errno, std::generic_category(), what);
+        }
+    }
+
+    std::uint32_t crc32c(const void *data, std::size_t size, std::uint32_t previous) {
+        const unsigned char *bytes = static_cast<const unsigned char *>(data);
+        std::uint32_t crc = ~previous;
+        for (std::size_t i = 0; i < size; ++i) {
+            crc = (crc >> 8) ^ checksumTable.table[(crc ^ bytes[i]) & 0xff];
+        }
+        return ~crc;
+    }
+}
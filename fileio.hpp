@@ -0,0 +1,49 @@
+#ifndef FILEIO_HPP
+#define FILEIO_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <sys/types.h>
+
+namespace BwTree {
+
+    /**
+    * owns a file descriptor, closes it on destruction
+    */
+    class FileDescriptor {
+    public:
+        int fd;
+
+        FileDescriptor(int fd) : fd(fd) { }
+
+        FileDescriptor(const FileDescriptor &) = delete;
+
+        FileDescriptor &operator=(const FileDescriptor &) = delete;
+
+        ~FileDescriptor();
+    };
+
+    /**
+    * writes all size bytes at offset, retrying partial writes. Throws std::system_error with what as message on errors.
+    */
+    void writeAll(int fd, const void *buffer, std::size_t size, off_t offset, const std::string &what);
+
+    /**
+    * reads size bytes at offset, retrying partial reads. Returns false if the file ends before, error is the errno then or 0.
+    */
+    bool readAll(int fd, void *buffer, std::size_t size, off_t offset, int &error);
+
+    /**
+    * fsyncs the directory containing path, so a file renamed to path survives a crash. Throws std::system_error with what
+    * as message on errors.
+    */
+    void syncParentDirectory(const std::string &path, const std::string &what);
+
+    /**
+    * CRC-32C of the bytes, previous is the checksum of the bytes before them to checksum data in parts
+    */
+    std::uint32_t crc32c(const void *data, std::size_t size, std::uint32_t previous = 0);
+}
+
+#endif
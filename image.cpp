@@ -0,0 +1,205 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+#include "image.hpp"
+#include "fileio.hpp"
+
+namespace BwTree {
+
+    namespace {
+        /**
+        * cache line aligned memory which is reused for every page of an image, a page is built in it and written from it
+        */
+        class PageBuffer {
+            void *memory = nullptr;
+            std::size_t capacity = 0;
+
+        public:
+            PageBuffer() = default;
+
+            PageBuffer(const PageBuffer &) = delete;
+
+            PageBuffer &operator=(const PageBuffer &) = delete;
+
+            ~PageBuffer() {
+                std::free(memory);
+            }
+
+            void *allocate(std::size_t size) {
+                if (size > capacity) {
+                    std::free(memory);
+                    memory = nullptr;
+                    capacity = 0;
+                    const std::size_t newCapacity = cacheLineAligned(size);
+                    if (::posix_memalign(&memory, NodeAllocator::alignment, newCapacity) != 0) {
+                        memory = nullptr;
+                        throw std::bad_alloc();
+                    }
+                    capacity = newCapacity;
+                }
+                // the padding of the page is written to the file as well
+                std::memset(memory, 0, size);
+                return memory;
+            }
+        };
+    }
+
+    template<typename Key, typename Data>
+    std::size_t Tree<Key, Data>::writeImage(const std::string &path, ThreadInfo<Key, Data> &threadInfo, double fillFactor) {
+        if (KeyTraits<Key>::variableLength || !ValueStorage<Data>::isInline) {
+            throw std::logic_error("BwTree::writeImage requires fixed size keys and inline values");
+        }
+        const std::string temporaryPath = path + ".tmp";
+        const std::string what = "BwTree::writeImage " + temporaryPath;
+        FileDescriptor file(::open(temporaryPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644));
+        if (file.fd < 0) {
+            throw std::system_error(errno, std::generic_category(), what);
+        }
+        ImageHeader header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, imageMagic, sizeof(header.magic));
+        header.version = ImageHeader::currentVersion;
+        header.keySize = sizeof(Key);
+        header.dataSize = sizeof(Data);
+        header.leafHeaderSize = sizeof(Leaf<Key, Data>);
+        header.innerHeaderSize = sizeof(InnerNode<Key, Data>);
+        header.alignment = NodeAllocator::alignment;
+        header.firstPID = ImageHeader::defaultFirstPID;
+
+        try {
+            // file offsets of the pages in PID order
+            std::vector<std::uint64_t> offsets;
+            off_t offset = cacheLineAligned(sizeof(ImageHeader));
+            // the pages are built in the buffer instead of the slabs, one at a time
+            PageBuffer pageBuffer;
+            auto pageAllocation = [&pageBuffer](std::size_t size) {
+                return pageBuffer.allocate(size);
+            };
+            auto writePage = [&](LinkedNode<Key, Data> *node) {
+                const std::size_t size = nodeSize<Key, Data>(node);
+                node->mapped = true;
+                writeAll(file.fd, node, size, offset, what);
+                offsets.push_back(offset);
+                offset += cacheLineAligned(size);
+            };
+
+            // the geometry is the one of bulkLoad, except that the leaves are cut while the records stream in
+            const std::size_t recordsPerLeaf = std::max<std::size_t>(1, static_cast<std::size_t>(settings.getSplitLimitLeaf() * fillFactor));
+            std::vector<KeyValue<Key, Data>> pending;
+            std::vector<Key> maxKeys;
+            auto writeLeaf = [&](bool last) {
+                const std::size_t count = last ? pending.size() : recordsPerLeaf;
+                const PID pid = header.firstPID + offsets.size();
+                const PID prev = offsets.empty() ? NotExistantPID : pid - 1;
+                const PID next = last ? NotExistantPID : pid + 1;
+                Leaf<Key, Data> *leaf = Helper<Key, Data>::CreateLeafNodeFromSorted(pending.begin(), pending.begin() + count, prev, next, pageAllocation);
+                maxKeys.push_back(count > 0 ? pending[count - 1].key : Key());
+                writePage(leaf);
+                header.recordCount += count;
+                pending.erase(pending.begin(), pending.begin() + count);
+            };
+            forEachLeaf(threadInfo, [&](const std::vector<KeyValue<Key, Data>> &records) {
+                pending.insert(pending.end(), records.begin(), records.end());
+                // a leaf is only written once further records exist, so the last leaf is known when it is written
+                while (pending.size() > recordsPerLeaf) {
+                    writeLeaf(false);
+                }
+            });
+            writeLeaf(true);
+
+            // the pages are written in PID order, so the next PIDs are the ones of the next pages
+            header.root = buildInnerLevels(maxKeys, header.firstPID, fillFactor, [&](std::size_t) {
+                return header.firstPID + offsets.size();
+            }, [&](PID, InnerNode<Key, Data> *innerNode) {
+                writePage(innerNode);
+            }, pageAllocation);
+
+            header.pageCount = offsets.size();
+            header.tableOffset = offset;
+            header.fileSize = offset + offsets.size() * sizeof(std::uint64_t);
+            writeAll(file.fd, offsets.data(), offsets.size() * sizeof(std::uint64_t), offset, what);
+            writeAll(file.fd, &header, sizeof(header), 0, what);
+            if (::fsync(file.fd) != 0) {
+                throw std::system_error(errno, std::generic_category(), what);
+            }
+            if (::rename(temporaryPath.c_str(), path.c_str()) != 0) {
+                throw std::system_error(errno, std::generic_category(), "BwTree::writeImage " + path);
+            }
+            syncParentDirectory(path, "BwTree::writeImage " + path);
+        } catch (...) {
+            ::unlink(temporaryPath.c_str());
+            throw;
+        }
+        return header.recordCount;
+    }
+
+    template<typename Key, typename Data>
+    void Tree<Key, Data>::mapImage(const std::string &path, ThreadInfo<Key, Data> &threadInfo) {
+        if (KeyTraits<Key>::variableLength || !ValueStorage<Data>::isInline) {
+            throw std::logic_error("BwTree::mapImage requires fixed size keys and inline values");
+        }
+        EpocheGuard<Key, Data> epoqueGuard(threadInfo);
+        PID oldRootPID, oldLeafPID;
+        std::tie(oldRootPID, oldLeafPID) = getEmptyTreePages("BwTree::mapImage");
+        if (image.isMapped()) {
+            throw std::logic_error("BwTree::mapImage the tree already serves an image");
+        }
+        MappedImage mapped;
+        mapped.map(path);
+
+        if (mapped.getSize() < sizeof(ImageHeader)) {
+            throw std::runtime_error("BwTree::mapImage " + path + " is no tree image");
+        }
+        const ImageHeader &header = *reinterpret_cast<const ImageHeader *>(mapped.data());
+        if (std::memcmp(header.magic, imageMagic, sizeof(header.magic)) != 0 || header.version != ImageHeader::currentVersion) {
+            throw std::runtime_error("BwTree::mapImage " + path + " is no tree image");
+        }
+        if (header.keySize != sizeof(Key) || header.dataSize != sizeof(Data) || header.leafHeaderSize != sizeof(Leaf<Key, Data>)
+            || header.innerHeaderSize != sizeof(InnerNode<Key, Data>) || header.alignment != NodeAllocator::alignment) {
+            throw std::runtime_error("BwTree::mapImage " + path + " is an image of a tree of other types");
+        }
+        // only the header and the offset table are checked, the pages themselves are not touched before they are used
+        const std::uint64_t firstPageOffset = cacheLineAligned(sizeof(ImageHeader));
+        if (header.fileSize != mapped.getSize() || header.pageCount == 0 || header.tableOffset < firstPageOffset
+            || header.tableOffset % sizeof(std::uint64_t) != 0
+            || header.tableOffset + header.pageCount * sizeof(std::uint64_t) != header.fileSize
+            || header.root < header.firstPID || header.root >= header.firstPID + header.pageCount) {
+            throw std::runtime_error("BwTree::mapImage " + path + " is truncated or corrupt");
+        }
+        const std::uint64_t *offsets = reinterpret_cast<const std::uint64_t *>(mapped.data() + header.tableOffset);
+        for (std::size_t i = 0; i < header.pageCount; ++i) {
+            if (offsets[i] < firstPageOffset || offsets[i] % NodeAllocator::alignment != 0
+                || offsets[i] + std::min(sizeof(Leaf<Key, Data>), sizeof(InnerNode<Key, Data>)) > header.tableOffset) {
+                throw std::runtime_error("BwTree::mapImage " + path + " is truncated or corrupt");
+            }
+        }
+        if (mapping.size() > header.firstPID) {
+            throw std::logic_error("BwTree::mapImage the PIDs of the image are already in use");
+        }
+        if (mapping.size() < header.firstPID) {
+            mapping.reserve(header.firstPID - mapping.size());
+        }
+        if (mapping.reserve(header.pageCount) != header.firstPID) {
+            throw std::logic_error("BwTree::mapImage the tree is used by other threads");
+        }
+        for (std::size_t i = 0; i < header.pageCount; ++i) {
+            // the pages are read only, nodes are never modified once they are published
+            Node<Key, Data> *page = reinterpret_cast<Node<Key, Data> *>(const_cast<char *>(mapped.data() + offsets[i]));
+            mapping[header.firstPID + i].store(page, std::memory_order_relaxed);
+        }
+        const PID newRoot = header.root;
+        image.swap(mapped);
+
+        root.store(newRoot);
+        Node<Key, Data> *const oldRoot = PIDToNodePtr(oldRootPID);
+        Node<Key, Data> *const oldLeaf = PIDToNodePtr(oldLeafPID);
+        epoque.markNodeForDeletion(oldRoot, threadInfo);
+        retirePID(oldRootPID, threadInfo);
+        epoque.markNodeForDeletion(oldLeaf, threadInfo);
+        retirePID(oldLeafPID, threadInfo);
+    }
+}
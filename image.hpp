@@ -0,0 +1,111 @@
+#ifndef IMAGE_HPP
+#define IMAGE_HPP
+
+#include <cerrno>
+#include <cstdint>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "fileio.hpp"
+
+namespace BwTree {
+
+    /**
+    * A tree image holds consolidated leaves and inner nodes exactly as they are laid out in memory, so it can be mapped and
+    * served without deserialization. The header is followed by the pages, each starting on a cache line, and the table of
+    * the file offsets of the pages in PID order. The pages use the PIDs they get in the tree, starting at firstPID,
+    * the PIDs below are left to the empty tree the image is mapped into.
+    */
+    struct ImageHeader {
+        static constexpr std::uint32_t currentVersion = 2;
+        static constexpr std::uint64_t defaultFirstPID = 64;
+
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t keySize;
+        std::uint32_t dataSize;
+        // layout of the nodes, an image is only valid for the node layout it was written with
+        std::uint32_t leafHeaderSize;
+        std::uint32_t innerHeaderSize;
+        std::uint32_t alignment;
+        std::uint64_t firstPID;
+        std::uint64_t pageCount;
+        std::uint64_t root;
+        std::uint64_t recordCount;
+        std::uint64_t tableOffset;
+        std::uint64_t fileSize;
+    };
+
+    constexpr char imageMagic[8] = {'B', 'w', 'T', 'r', 'e', 'e', 'I', 'M'};
+
+    /**
+    * Read only, shared mapping of a whole file, the page cache backs it for all processes mapping the same file.
+    * Unmapped on destruction.
+    */
+    class MappedImage {
+        const char *address = nullptr;
+        std::size_t size = 0;
+
+    public:
+        MappedImage() = default;
+
+        MappedImage(const MappedImage &) = delete;
+
+        MappedImage &operator=(const MappedImage &) = delete;
+
+        ~MappedImage() {
+            if (address != nullptr) {
+                ::munmap(const_cast<char *>(address), size);
+            }
+        }
+
+        /**
+        * throws std::system_error if the file can not be mapped
+        */
+        void map(const std::string &path) {
+            FileDescriptor file(::open(path.c_str(), O_RDONLY));
+            if (file.fd < 0) {
+                throw std::system_error(errno, std::generic_category(), "BwTree::mapImage " + path);
+            }
+            struct stat fileStat;
+            if (::fstat(file.fd, &fileStat) != 0) {
+                throw std::system_error(errno, std::generic_category(), "BwTree::mapImage " + path);
+            }
+            const std::size_t fileSize = static_cast<std::size_t>(fileStat.st_size);
+            if (fileSize == 0) {
+                throw std::system_error(EINVAL, std::generic_category(), "BwTree::mapImage " + path);
+            }
+            void *mapped = ::mmap(nullptr, fileSize, PROT_READ, MAP_SHARED, file.fd, 0);
+            if (mapped == MAP_FAILED) {
+                throw std::system_error(errno, std::generic_category(), "BwTree::mapImage " + path);
+            }
+            // lookups touch few pages of the file at scattered offsets, read ahead would only evict other pages
+            ::madvise(mapped, fileSize, MADV_RANDOM);
+            address = static_cast<const char *>(mapped);
+            size = fileSize;
+        }
+
+        void swap(MappedImage &other) {
+            std::swap(address, other.address);
+            std::swap(size, other.size);
+        }
+
+        bool isMapped() const {
+            return address != nullptr;
+        }
+
+        const char *data() const {
+            return address;
+        }
+
+        std::size_t getSize() const {
+            return size;
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,129 @@
+#include "iterator.hpp"
+
+namespace BwTree {
+
+    template<typename Key, typename Data>
+    ForwardIterator<Key, Data>::ForwardIterator(Tree<Key, Data> &tree, Key lowKey, Key highKey, ThreadInfo<Key, Data> &threadInfo)
+            : tree(tree), epocheGuard(threadInfo), highKey(highKey), lowerBound(lowKey) {
+        FindDataPageResult<Key, Data> res = tree.findDataPage(lowKey);
+        loadPage(res.startNode);
+        skipToValid();
+    }
+
+    template<typename Key, typename Data>
+    void ForwardIterator<Key, Data>::loadPage(Node<Key, Data> *startNode) {
+        records.clear();
+        PID prev;
+        std::tie(prev, nextPID) = tree.getConsolidatedLeafData(startNode, records);
+        auto compare = [](const KeyValue<Key, Data> &record, const Key &key) {
+            return record.key < key;
+        };
+        auto compareExclusive = [](const KeyValue<Key, Data> &record, const Key &key) {
+            return record.key <= key;
+        };
+        auto it = lowerBoundInclusive ? std::lower_bound(records.begin(), records.end(), lowerBound, compare)
+                                      : std::lower_bound(records.begin(), records.end(), lowerBound, compareExclusive);
+        position = std::distance(records.begin(), it);
+    }
+
+    template<typename Key, typename Data>
+    void ForwardIterator<Key, Data>::skipToValid() {
+        while (position == records.size()) {
+            if (nextPID == NotExistantPID) {
+                ended = true;
+                return;
+            }
+            loadPage(tree.PIDToNodePtr(nextPID));
+        }
+        if (records[position].key > highKey) {
+            ended = true;
+        }
+    }
+
+    template<typename Key, typename Data>
+    void ForwardIterator<Key, Data>::next() {
+        assert(!ended);
+        lowerBound = records[position].key;
+        lowerBoundInclusive = false;
+        ++position;
+        skipToValid();
+    }
+
+    template<typename Key, typename Data>
+    ReverseIterator<Key, Data>::ReverseIterator(Tree<Key, Data> &tree, Key highKey, Key lowKey, ThreadInfo<Key, Data> &threadInfo)
+            : tree(tree), epocheGuard(threadInfo), lowKey(lowKey), upperBound(highKey) {
+        FindDataPageResult<Key, Data> res = tree.findDataPage(highKey);
+        loadPage(res.pid);
+        skipToValid();
+    }
+
+    template<typename Key, typename Data>
+    void ReverseIterator<Key, Data>::loadPage(PID pid) {
+        currentPID = pid;
+        records.clear();
+        std::tie(prevPID, nextPID) = tree.getConsolidatedLeafData(tree.PIDToNodePtr(pid), records);
+        auto compare = [](const Key &key, const KeyValue<Key, Data> &record) {
+            return key < record.key;
+        };
+        auto compareExclusive = [](const Key &key, const KeyValue<Key, Data> &record) {
+            return key <= record.key;
+        };
+        auto it = upperBoundInclusive ? std::upper_bound(records.begin(), records.end(), upperBound, compare)
+                                      : std::upper_bound(records.begin(), records.end(), upperBound, compareExclusive);
+        position = std::distance(records.begin(), it);
+    }
+
+    template<typename Key, typename Data>
+    void ReverseIterator<Key, Data>::skipToValid() {
+        while (position == 0) {
+            if (prevPID == NotExistantPID) {
+                ended = true;
+                return;
+            }
+            const PID rightPID = currentPID;
+            loadPage(prevPID);
+            // pages are never merged, so the right page is reachable from every page left of it
+            while (nextPID != rightPID && nextPID != NotExistantPID) {
+                loadPage(nextPID);
+            }
+        }
+        if (records[position - 1].key < lowKey) {
+            ended = true;
+        }
+    }
+
+    template<typename Key, typename Data>
+    void ReverseIterator<Key, Data>::next() {
+        assert(!ended);
+        upperBound = records[position - 1].key;
+        upperBoundInclusive = false;
+        --position;
+        skipToValid();
+    }
+
+    template<typename Key, typename Data>
+    std::size_t Tree<Key, Data>::reverseScan(Key highKey, Key lowKey, std::size_t maxRecords, std::vector<KeyValue<Key, Data>> &result, ThreadInfo<Key, Data> &threadInfo) {
+        if (KeyTraits<Key>::variableLength) {
+            throw std::logic_error("BwTree::reverseScan the keys of the records would not outlive the epoche, use an iterator");
+        }
+        std::size_t count = 0;
+        for (ReverseIterator<Key, Data> it(*this, highKey, lowKey, threadInfo); it.valid() && count < maxRecords; it.next()) {
+            result.push_back(KeyValue<Key, Data>(it.key(), it.data()));
+            ++count;
+        }
+        return count;
+    }
+
+    template<typename Key, typename Data>
+    std::size_t Tree<Key, Data>::scan(Key lowKey, Key highKey, std::vector<KeyValue<Key, Data>> &result, ThreadInfo<Key, Data> &threadInfo) {
+        if (KeyTraits<Key>::variableLength) {
+            throw std::logic_error("BwTree::scan the keys of the records would not outlive the epoche, use an iterator");
+        }
+        std::size_t count = 0;
+        for (ForwardIterator<Key, Data> it(*this, lowKey, highKey, threadInfo); it.valid(); it.next()) {
+            result.push_back(KeyValue<Key, Data>(it.key(), it.data()));
+            ++count;
+        }
+        return count;
+    }
+}
@@ -0,0 +1,114 @@
+#ifndef ITERATOR_HPP
+#define ITERATOR_HPP
+
+#include <vector>
+#include "bwtree.hpp"
+
+namespace BwTree {
+
+    /**
+    * Ascending iterator over all records with lowKey <= key <= highKey.
+    *
+    * Each leaf page is consolidated into a sorted private copy (delta records merged, deleted records removed)
+    * and the leaf level is followed through the next pointers and split sidelinks.
+    * The iterator keeps the thread in its epoche for its whole lifetime, so it should be short lived
+    * and the thread must not use the tree in any other way while the iterator exists.
+    * The bytes of variable length bounds have to outlive the iterator, the keys it returns are valid as long as it exists.
+    */
+    template<typename Key, typename Data>
+    class ForwardIterator {
+        Tree<Key, Data> &tree;
+        EpocheGuard<Key, Data> epocheGuard;
+        const Key highKey;
+
+        std::vector<KeyValue<Key, Data>> records;
+        std::size_t position = 0;
+        PID nextPID = NotExistantPID;
+        bool ended = false;
+
+        /**
+        * records of the next page are only considered if they are larger than the last returned key,
+        * pages which have been split or consolidated in the meantime would otherwise return keys twice
+        */
+        Key lowerBound;
+        bool lowerBoundInclusive = true;
+
+        void loadPage(Node<Key, Data> *startNode);
+
+        void skipToValid();
+
+    public:
+        ForwardIterator(Tree<Key, Data> &tree, Key lowKey, Key highKey, ThreadInfo<Key, Data> &threadInfo);
+
+        ForwardIterator(const ForwardIterator &) = delete;
+
+        ForwardIterator &operator=(const ForwardIterator &) = delete;
+
+        bool valid() const {
+            return !ended;
+        }
+
+        void next();
+
+        const Key &key() const {
+            return records[position].key;
+        }
+
+        const Data *data() const {
+            return records[position].data();
+        }
+    };
+
+    /**
+    * Descending iterator over all records with highKey >= key >= lowKey.
+    *
+    * The leaf level is walked right to left through the prev links. A split does not update the prev link of the right neighbour,
+    * so a prev link can point further left than the direct neighbour. In that case the next pointers are followed
+    * from there until the page left of the current one is found.
+    * The same restrictions as for the ForwardIterator apply.
+    */
+    template<typename Key, typename Data>
+    class ReverseIterator {
+        Tree<Key, Data> &tree;
+        EpocheGuard<Key, Data> epocheGuard;
+        const Key lowKey;
+
+        std::vector<KeyValue<Key, Data>> records;
+        // records[position - 1] is the current record
+        std::size_t position = 0;
+        PID currentPID;
+        PID prevPID = NotExistantPID;
+        PID nextPID = NotExistantPID;
+        bool ended = false;
+
+        Key upperBound;
+        bool upperBoundInclusive = true;
+
+        void loadPage(PID pid);
+
+        void skipToValid();
+
+    public:
+        ReverseIterator(Tree<Key, Data> &tree, Key highKey, Key lowKey, ThreadInfo<Key, Data> &threadInfo);
+
+        ReverseIterator(const ReverseIterator &) = delete;
+
+        ReverseIterator &operator=(const ReverseIterator &) = delete;
+
+        bool valid() const {
+            return !ended;
+        }
+
+        void next();
+
+        const Key &key() const {
+            return records[position - 1].key;
+        }
+
+        const Data *data() const {
+            return records[position - 1].data();
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,250 @@
+#ifndef KEY_HPP
+#define KEY_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <algorithm>
+#include <functional>
+
+namespace BwTree {
+
+    /**
+    * Variable length key, ordered bytewise like std::string.
+    *
+    * A key passed to the tree only references the bytes of the caller, the tree copies them into its nodes. Keys read from
+    * a node reference the node: a consolidated page stores the prefix shared by all of its keys once, its keys consist of
+    * that prefix and the rest of their bytes. Such keys are only valid as long as the node, i.e. inside the epoche in which
+    * they were read.
+    */
+    struct VarKey {
+        // the first prefixLength bytes of the key, shared with the other keys of a page
+        const unsigned char *prefix;
+        // the bytes behind the prefix
+        const unsigned char *data;
+        std::uint32_t length;
+        std::uint32_t prefixLength;
+
+        VarKey() : prefix(nullptr), data(nullptr), length(0), prefixLength(0) { }
+
+        VarKey(const void *data, std::size_t length) : prefix(nullptr), data(static_cast<const unsigned char *>(data)), length(static_cast<std::uint32_t>(length)), prefixLength(0) { }
+
+        VarKey(const std::string &string) : VarKey(string.data(), string.size()) { }
+
+        VarKey(const unsigned char *prefix, std::uint32_t prefixLength, const unsigned char *data, std::uint32_t length)
+                : prefix(prefix), data(data), length(length), prefixLength(prefixLength) { }
+
+        /**
+        * the bytes from offset on which are stored in one piece, run gets their number
+        */
+        const unsigned char *bytesAt(std::uint32_t offset, std::uint32_t &run) const {
+            if (offset < prefixLength) {
+                run = prefixLength - offset;
+                return prefix + offset;
+            }
+            run = length - offset;
+            return data + (offset - prefixLength);
+        }
+
+        /**
+        * copies the bytes from offset to end to destination
+        */
+        void copyBytes(unsigned char *destination, std::uint32_t offset, std::uint32_t end) const {
+            while (offset < end) {
+                std::uint32_t run;
+                const unsigned char *bytes = bytesAt(offset, run);
+                run = std::min(run, end - offset);
+                std::memcpy(destination, bytes, run);
+                destination += run;
+                offset += run;
+            }
+        }
+
+        std::string toString() const {
+            std::string string(length, '\0');
+            copyBytes(reinterpret_cast<unsigned char *>(&string[0]), 0, length);
+            return string;
+        }
+
+        /**
+        * compares the bytes from offset to end, both keys have to be at least end bytes long
+        */
+        int compareBytes(const VarKey &other, std::uint32_t offset, std::uint32_t end) const {
+            while (offset < end) {
+                std::uint32_t run, otherRun;
+                const unsigned char *bytes = bytesAt(offset, run);
+                const unsigned char *otherBytes = other.bytesAt(offset, otherRun);
+                const std::uint32_t count = std::min(std::min(run, otherRun), end - offset);
+                int cmp = std::memcmp(bytes, otherBytes, count);
+                if (cmp != 0) {
+                    return cmp;
+                }
+                offset += count;
+            }
+            return 0;
+        }
+
+        /**
+        * compares the bytes from offset on, the first offset bytes of both keys have to be equal
+        */
+        int compare(const VarKey &other, std::uint32_t offset = 0) const {
+            const std::uint32_t minLength = std::min(length, other.length);
+            if (minLength > offset) {
+                int cmp = compareBytes(other, offset, minLength);
+                if (cmp != 0) {
+                    return cmp;
+                }
+            }
+            return length < other.length ? -1 : (length > other.length ? 1 : 0);
+        }
+    };
+
+    inline bool operator==(const VarKey &a, const VarKey &b) {
+        return a.length == b.length && a.compareBytes(b, 0, a.length) == 0;
+    }
+
+    inline bool operator!=(const VarKey &a, const VarKey &b) {
+        return !(a == b);
+    }
+
+    inline bool operator<(const VarKey &a, const VarKey &b) {
+        return a.compare(b) < 0;
+    }
+
+    inline bool operator>(const VarKey &a, const VarKey &b) {
+        return b < a;
+    }
+
+    inline bool operator<=(const VarKey &a, const VarKey &b) {
+        return !(b < a);
+    }
+
+    inline bool operator>=(const VarKey &a, const VarKey &b) {
+        return !(a < b);
+    }
+
+    /**
+    * Key dependent parts of the page search and of the key storage of the nodes.
+    *
+    * Pages with variable length keys store the prefix shared by all of their keys once in their key area, followed by the
+    * remaining bytes of every key. The prefix of the search key is compared once per page, the binary search only compares
+    * the remaining bytes. Deltas store the bytes of their keys behind themselves. Fixed size keys need no key area.
+    */
+    template<typename Key>
+    struct KeyTraits {
+        static constexpr bool variableLength = false;
+
+        static std::uint32_t commonPrefixLength(const Key &, const Key &) {
+            return 0;
+        }
+
+        /**
+        * compares key with the first prefixLength bytes of reference
+        */
+        static int comparePrefix(const Key &, const Key &, std::uint32_t) {
+            return 0;
+        }
+
+        /**
+        * a < b, the first offset bytes of a and b are equal
+        */
+        static bool less(const Key &a, const Key &b, std::uint32_t) {
+            return a < b;
+        }
+
+        /**
+        * bytes of key behind the first prefixLength ones which a node stores in its key area
+        */
+        static std::size_t storedSize(const Key &, std::uint32_t) {
+            return 0;
+        }
+
+        /**
+        * copies the first prefixLength bytes of key to area
+        */
+        static void storePrefix(const Key &, std::uint32_t, unsigned char *) {
+        }
+
+        /**
+        * copies the bytes of key behind the first prefixLength ones to area and advances it,
+        * returns the key made of prefix and the copy
+        */
+        static Key store(const Key &key, const unsigned char *, std::uint32_t, unsigned char *&) {
+            return key;
+        }
+
+        /**
+        * well mixed in the high bits, used for the membership filter of the delta chains
+        */
+        static std::uint64_t hash(const Key &key) {
+            return static_cast<std::uint64_t>(std::hash<Key>()(key)) * 0x9E3779B97F4A7C15ull;
+        }
+    };
+
+    template<>
+    struct KeyTraits<VarKey> {
+        static constexpr bool variableLength = true;
+
+        static std::uint32_t commonPrefixLength(const VarKey &a, const VarKey &b) {
+            const std::uint32_t minLength = std::min(a.length, b.length);
+            std::uint32_t i = 0;
+            while (i < minLength) {
+                std::uint32_t run, otherRun;
+                const unsigned char *bytes = a.bytesAt(i, run);
+                const unsigned char *otherBytes = b.bytesAt(i, otherRun);
+                const std::uint32_t count = std::min(std::min(run, otherRun), minLength - i);
+                for (std::uint32_t j = 0; j < count; ++j, ++i) {
+                    if (bytes[j] != otherBytes[j]) {
+                        return i;
+                    }
+                }
+            }
+            return i;
+        }
+
+        static int comparePrefix(const VarKey &key, const VarKey &reference, std::uint32_t prefixLength) {
+            if (key.length < prefixLength) {
+                int cmp = key.compareBytes(reference, 0, key.length);
+                // a proper prefix of the prefix is smaller
+                return cmp != 0 ? cmp : -1;
+            }
+            return key.compareBytes(reference, 0, prefixLength);
+        }
+
+        static bool less(const VarKey &a, const VarKey &b, std::uint32_t offset) {
+            return a.compare(b, offset) < 0;
+        }
+
+        static std::size_t storedSize(const VarKey &key, std::uint32_t prefixLength) {
+            return key.length - prefixLength;
+        }
+
+        static void storePrefix(const VarKey &key, std::uint32_t prefixLength, unsigned char *area) {
+            key.copyBytes(area, 0, prefixLength);
+        }
+
+        static VarKey store(const VarKey &key, const unsigned char *prefix, std::uint32_t prefixLength, unsigned char *&area) {
+            key.copyBytes(area, prefixLength, key.length);
+            VarKey stored(prefix, prefixLength, area, key.length);
+            area += key.length - prefixLength;
+            return stored;
+        }
+
+        static std::uint64_t hash(const VarKey &key) {
+            // FNV-1a
+            std::uint64_t hash = 0xcbf29ce484222325ull;
+            std::uint32_t offset = 0;
+            while (offset < key.length) {
+                std::uint32_t run;
+                const unsigned char *bytes = key.bytesAt(offset, run);
+                for (std::uint32_t i = 0; i < run; ++i) {
+                    hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+                }
+                offset += run;
+            }
+            return hash * 0x9E3779B97F4A7C15ull;
+        }
+    };
+}
+
+#endif
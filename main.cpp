@@ -4,8 +4,16 @@
 #include <unordered_map>
 #include <unordered_set>
 #include <thread>
+#include <limits>
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cerrno>
 #include "bwtree.hpp"
+#include "iterator.hpp"
 #include "main.hpp"
+#include "workload.hpp"
 
 using namespace BwTree;
 
@@ -25,9 +33,9 @@ void testBwTreeNew(const std::size_t count) {
     tree.deleteKey(values.at(4));
     tree.deleteKey(values.at(70));
     for (std::size_t i = 0; i < count; ++i) {
-        auto *val = tree.search(values.at(i));
-        if (val == nullptr || *val != values.at(i)) {
-            std::cout << "error val " << (val == nullptr ? -1 : *val) << " expected " << values.at(i) << std::endl;
+        auto val = tree.search(values.at(i));
+        if (!val || *val != values.at(i)) {
+            std::cout << "error val " << (!val ? -1 : *val) << " expected " << values.at(i) << std::endl;
         }
     }
 }
@@ -35,7 +43,15 @@ void testBwTreeNew(const std::size_t count) {
 template<typename Key>
 void testBwTree() {
     std::cout << "threads, operations,percent read operations, settings split leaf, settings split inner, settings delta, settings delta inner, time in ms, operations per s, exchange collisions, successful leaf consolidation, failed leaf consolidation, successful leaf split, failed leaf split,"
-            "successful inner consolidation, failed inner consolidation, successful inner split, failed innersplit" << std::endl;
+            "successful inner consolidation, failed inner consolidation, successful inner split, failed innersplit,"
+            "smo max queue depth, smo executed, smo avg latency in us, smo max latency in us,"
+            "final leaf consolidate limit, final leaf split limit, " <<
+            "delta chain p50, delta chain p99, tree height, consolidation p50 (us), consolidation p99 (us), mapping pages, mapping pids, pending garbage KB";
+    for (std::size_t type = 0; type < bwTreeCommandTypes; ++type) {
+        const char *name = bwTreeCommandTypeName(static_cast<BwTreeCommandType>(type));
+        std::cout << ", " << name << " p50 (ns), " << name << " p99 (ns), " << name << " p99.9 (ns), " << name << " max (ns)";
+    }
+    std::cout << std::endl;
     std::default_random_engine d;
     std::size_t initial_values_count = 1000000;
     std::uniform_int_distribution<Key> rand(1, initial_values_count * 2);
@@ -51,6 +67,13 @@ void testBwTree() {
             initial_values[i] = val;
         }
     }
+    std::vector<KeyValue<Key, Key>> initialRecords;
+    for (auto &value : initial_values) {
+        initialRecords.push_back(KeyValue<Key, Key>(value, &value));
+    }
+    std::sort(initialRecords.begin(), initialRecords.end(), [](const KeyValue<Key, Key> &t1, const KeyValue<Key, Key> &t2) {
+        return t1.key < t2.key;
+    });
     std::vector<std::size_t> numberValuesChoice{{1000000,10000000, 42000000}};
     for (auto &numberValues : numberValuesChoice) {
         for (int numberOfThreads = 1; numberOfThreads <= 8; ++numberOfThreads) {
@@ -114,6 +137,11 @@ void testBwTree() {
                     BwTree::Settings("400, 200, 7, 7", 400, {200}, 7, {7}),
                     BwTree::Settings("400, 200, 14, 7", 400, {200}, 7, {7}),
 
+                    BwTree::Settings("400, 200, 7, 7, 1 smo thread", 400, {200}, 7, {7}, 1),
+                    BwTree::Settings("400, 200, 7, 7, 2 smo threads", 400, {200}, 7, {7}, 2),
+
+                    BwTree::Settings("400, 200, 7, 7, adaptive", 400, {200}, 7, {7}, 0, BwTree::SMOPolicyType::adaptive),
+
                     //BwTree::Settings("single", 200, {100}, 8, {8}),
 
 
@@ -126,11 +154,15 @@ void testBwTree() {
                 std::vector<std::tuple<std::size_t, int>> operationsList{{std::make_tuple(values.size(), 83), std::make_tuple(values.size(), 0), std::make_tuple(values.size(), 100)}};
                 for (const auto &operationsTuple : operationsList) {
                     Tree<Key, Key> tree(settings);
+                    {
+                        BwTree::ThreadInfo<Key, Key> threadInfo = tree.getThreadInfo();
+                        tree.bulkLoad(initialRecords.begin(), initialRecords.end(), 0.8, threadInfo, std::thread::hardware_concurrency());
+                    }
 
-                    createBwTreeCommands(1, initial_values, initial_values, initial_values_count, 0, tree, false);
                     const std::size_t operations = std::get<0>(operationsTuple);
                     const std::size_t percentRead = std::get<1>(operationsTuple);
-                    auto duration = createBwTreeCommands(numberOfThreads, values, initial_values, operations, percentRead, tree, false);
+                    const BwTreeCommandsResult result = createBwTreeCommands(numberOfThreads, values, initial_values, operations, percentRead, tree, false);
+                    const auto duration = result.duration;
 
                     std::cout << numberOfThreads << "," << operations << "," << percentRead << "," << settings.getName() << ",";
 
@@ -146,6 +178,25 @@ void testBwTree() {
                     std::cout << tree.getFailedInnerConsolidate() << ",";
                     std::cout << tree.getSuccessfulInnerSplit() << ",";
                     std::cout << tree.getFailedInnerSplit() << ",";
+                    const BwTree::SMOStatistics smo = tree.getSMOStatistics();
+                    std::cout << smo.maxQueueDepth << ",";
+                    std::cout << smo.executed << ",";
+                    std::cout << (smo.executed > 0 ? smo.totalLatencyNs / smo.executed / 1000 : 0) << ",";
+                    std::cout << smo.maxLatencyNs / 1000 << ",";
+                    std::cout << tree.getSMOPolicy().getConsolidateLimitLeaf() << ",";
+                    std::cout << tree.getSMOPolicy().getSplitLimitLeaf() << ",";
+                    const BwTree::Metrics metrics = tree.metrics();
+                    std::cout << metrics.deltaChainLength.percentile(50) << ",";
+                    std::cout << metrics.deltaChainLength.percentile(99) << ",";
+                    std::cout << metrics.treeHeight.max << ",";
+                    std::cout << metrics.consolidationNs.percentile(50) / 1000 << ",";
+                    std::cout << metrics.consolidationNs.percentile(99) / 1000 << ",";
+                    std::cout << metrics.mapping.pages << ",";
+                    std::cout << metrics.mapping.pids << ",";
+                    std::cout << metrics.pendingGarbageBytes / 1024 << ",";
+                    for (const BwTree::LatencyHistogram &latencies : result.latencies) {
+                        std::cout << latencies.percentile(50) << "," << latencies.percentile(99) << "," << latencies.percentile(99.9) << "," << latencies.getMax() << ",";
+                    }
                     std::cout << std::endl;
                 }
             }
@@ -155,7 +206,754 @@ void testBwTree() {
 };
 
 template<typename Key>
-std::chrono::milliseconds createBwTreeCommands(const std::size_t numberOfThreads, const std::vector<Key> &values, const std::vector<Key> &initial_values, const std::size_t operations, const unsigned percentRead, BwTree::Tree<Key, Key> &tree, bool block) {
+void testBwTreeScan() {
+    std::cout << "threads, scans, range length, settings, time in ms, scans per s, records per s" << std::endl;
+    std::default_random_engine d;
+    const std::size_t valuesCount = 10000000;
+    const std::size_t scansPerThread = 100000;
+    std::vector<Key> values(valuesCount);
+    for (std::size_t i = 0; i < valuesCount; ++i) {
+        values[i] = 2 * i + 1;
+    }
+    std::shuffle(values.begin(), values.end(), d);
+    auto settings = BwTree::Settings("400, 200, 7, 7", 400, {200}, 7, {7});
+    Tree<Key, Key> tree(settings);
+    {
+        std::vector<KeyValue<Key, Key>> records;
+        for (auto &value : values) {
+            records.push_back(KeyValue<Key, Key>(value, &value));
+        }
+        std::sort(records.begin(), records.end(), [](const KeyValue<Key, Key> &t1, const KeyValue<Key, Key> &t2) {
+            return t1.key < t2.key;
+        });
+        BwTree::ThreadInfo<Key, Key> threadInfo = tree.getThreadInfo();
+        tree.bulkLoad(records.begin(), records.end(), 0.8, threadInfo, std::thread::hardware_concurrency());
+    }
+
+    for (std::size_t rangeLength : {10, 100, 1000}) {
+        for (int numberOfThreads = 1; numberOfThreads <= 8; ++numberOfThreads) {
+            std::vector<std::thread> threads;
+            std::atomic<std::size_t> recordsFound{0};
+            auto starttime = std::chrono::system_clock::now();
+            for (int thread_i = 0; thread_i < numberOfThreads; ++thread_i) {
+                threads.push_back(std::thread([&tree, &recordsFound, rangeLength, thread_i, valuesCount, scansPerThread]() {
+                    BwTree::ThreadInfo<Key, Key> threadInfo = tree.getThreadInfo();
+                    std::default_random_engine d(thread_i);
+                    std::uniform_int_distribution<Key> rand(0, 2 * valuesCount);
+                    std::size_t found = 0;
+                    for (std::size_t scan_i = 0; scan_i < scansPerThread; ++scan_i) {
+                        Key lowKey = rand(d);
+                        // keys are odd, so the range contains rangeLength keys
+                        for (ForwardIterator<Key, Key> it(tree, lowKey, lowKey + 2 * rangeLength - 1, threadInfo); it.valid(); it.next()) {
+                            ++found;
+                        }
+                    }
+                    recordsFound += found;
+                    tree.threadFinishedWithTree(threadInfo);
+                }));
+            }
+            for (auto &thread : threads) {
+                thread.join();
+            }
+            auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now() - starttime);
+            const std::size_t scans = scansPerThread * numberOfThreads;
+
+            std::cout << numberOfThreads << "," << scans << "," << rangeLength << "," << settings.getName() << ",";
+            std::cout << duration.count() << ", ";
+            std::cout << (duration.count() > 0 ? (scans * 1000 / duration.count()) : 0) << ", ";
+            std::cout << (duration.count() > 0 ? (recordsFound * 1000 / duration.count()) : 0) << std::endl;
+        }
+    }
+}
+
+template<typename Key>
+void testBwTreeBatchInsert() {
+    std::cout << "threads, records, batch size, settings, time in ms, records per s, exchange collisions" << std::endl;
+    std::default_random_engine d;
+    const std::size_t valuesCount = 10000000;
+    std::vector<Key> values(valuesCount);
+    for (std::size_t i = 0; i < valuesCount; ++i) {
+        values[i] = 2 * i + 1;
+    }
+    std::shuffle(values.begin(), values.end(), d);
+    auto settings = BwTree::Settings("400, 200, 7, 7", 400, {200}, 7, {7});
+
+    // batch size 1 inserts every record on its own
+    for (std::size_t batchSize : {1, 100, 1000, 4096}) {
+        for (int numberOfThreads = 1; numberOfThreads <= 8; ++numberOfThreads) {
+            Tree<Key, Key> tree(settings);
+            std::vector<std::thread> threads;
+            auto starttime = std::chrono::system_clock::now();
+            for (int thread_i = 0; thread_i < numberOfThreads; ++thread_i) {
+                threads.push_back(std::thread([&tree, &values, batchSize, thread_i, numberOfThreads]() {
+                    BwTree::ThreadInfo<Key, Key> threadInfo = tree.getThreadInfo();
+                    const std::size_t start = values.size() / numberOfThreads * thread_i;
+                    const std::size_t end = thread_i + 1 == numberOfThreads ? values.size() : values.size() / numberOfThreads * (thread_i + 1);
+                    std::vector<KeyValue<Key, Key>> batch;
+                    for (std::size_t i = start; i < end; ++i) {
+                        if (batchSize == 1) {
+                            tree.insert(values[i], &values[i], threadInfo);
+                            continue;
+                        }
+                        batch.push_back(KeyValue<Key, Key>(values[i], &values[i]));
+                        if (batch.size() == batchSize || i + 1 == end) {
+                            tree.insertBatch(batch, threadInfo);
+                            batch.clear();
+                        }
+                    }
+                    tree.threadFinishedWithTree(threadInfo);
+                }));
+            }
+            for (auto &thread : threads) {
+                thread.join();
+            }
+            auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now() - starttime);
+
+            std::cout << numberOfThreads << "," << valuesCount << "," << batchSize << "," << settings.getName() << ",";
+            std::cout << duration.count() << ", ";
+            std::cout << (duration.count() > 0 ? (valuesCount * 1000 / duration.count()) : 0) << ", ";
+            std::cout << tree.getAtomicCollisions() << std::endl;
+        }
+    }
+}
+
+void testBwTreeVarKey() {
+    std::cout << "threads, records, settings, insert time in ms, inserts per s, search time in ms, searches per s" << std::endl;
+    std::default_random_engine d;
+    const std::size_t valuesCount = 4000000;
+    std::uniform_int_distribution<unsigned long long> rand(0, valuesCount * 100);
+    // keys with a long shared prefix, the tree copies the bytes of the keys
+    std::vector<std::string> keys(valuesCount);
+    std::vector<uint64_t> values(valuesCount);
+    {
+        std::unordered_set<unsigned long long> used;
+        for (std::size_t i = 0; i < valuesCount; ++i) {
+            unsigned long long val;
+            do {
+                val = rand(d);
+            } while (used.find(val) != used.end());
+            used.emplace(val);
+            keys[i] = "tenant/0042/user/" + std::to_string(val);
+            values[i] = val;
+        }
+    }
+    auto settings = BwTree::Settings("400, 200, 7, 7", 400, {200}, 7, {7});
+
+    for (int numberOfThreads = 1; numberOfThreads <= 8; ++numberOfThreads) {
+        Tree<VarKey, uint64_t> tree(settings);
+        auto runThreads = [&](bool insert) {
+            std::vector<std::thread> threads;
+            auto starttime = std::chrono::system_clock::now();
+            for (int thread_i = 0; thread_i < numberOfThreads; ++thread_i) {
+                threads.push_back(std::thread([&tree, &keys, &values, insert, thread_i, numberOfThreads]() {
+                    BwTree::ThreadInfo<VarKey, uint64_t> threadInfo = tree.getThreadInfo();
+                    for (std::size_t i = thread_i; i < keys.size(); i += numberOfThreads) {
+                        if (insert) {
+                            // the copy is gone before the key is searched
+                            const std::string key = keys[i];
+                            tree.insert(VarKey(key), &values[i], threadInfo);
+                        } else {
+                            uint64_t value;
+                            if (!tree.lookup(VarKey(keys[i]), value, threadInfo) || value != values[i]) {
+                                std::cout << "error key " << keys[i] << " not found" << std::endl;
+                            }
+                        }
+                    }
+                    tree.threadFinishedWithTree(threadInfo);
+                }));
+            }
+            for (auto &thread : threads) {
+                thread.join();
+            }
+            return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now() - starttime);
+        };
+        auto insertDuration = runThreads(true);
+        auto searchDuration = runThreads(false);
+
+        std::cout << numberOfThreads << "," << valuesCount << "," << settings.getName() << ",";
+        std::cout << insertDuration.count() << ", ";
+        std::cout << (insertDuration.count() > 0 ? (valuesCount * 1000 / insertDuration.count()) : 0) << ", ";
+        std::cout << searchDuration.count() << ", ";
+        std::cout << (searchDuration.count() > 0 ? (valuesCount * 1000 / searchDuration.count()) : 0) << std::endl;
+    }
+}
+
+/**
+* searches mostly missing keys while inserts add delta chains, reports how often the delta summaries skip a chain
+*/
+template<typename Key>
+void testBwTreeMissingKeys() {
+    std::cout << "threads, operations, percent missing lookups, settings, time in ms, operations per s, delta summary checks, delta summary skips, delta summary hit rate" << std::endl;
+    const std::size_t valuesCount = 4000000;
+    const std::size_t operationsPerThread = 2000000;
+    const unsigned percentMissing = 90;
+    // existing keys are 4i+1, inserted keys 4i and missing keys 4i+2
+    std::vector<Key> values(valuesCount);
+    std::vector<KeyValue<Key, Key>> records;
+    for (std::size_t i = 0; i < valuesCount; ++i) {
+        values[i] = 4 * i + 1;
+        records.push_back(KeyValue<Key, Key>(values[i], &values[i]));
+    }
+    auto settings = BwTree::Settings("400, 200, 7, 7", 400, {200}, 7, {7});
+
+    for (int numberOfThreads = 1; numberOfThreads <= 8; ++numberOfThreads) {
+        Tree<Key, Key> tree(settings);
+        {
+            BwTree::ThreadInfo<Key, Key> threadInfo = tree.getThreadInfo();
+            tree.bulkLoad(records.begin(), records.end(), 0.8, threadInfo, std::thread::hardware_concurrency());
+        }
+        std::vector<std::thread> threads;
+        auto starttime = std::chrono::system_clock::now();
+        for (int thread_i = 0; thread_i < numberOfThreads; ++thread_i) {
+            threads.push_back(std::thread([&tree, &values, thread_i, valuesCount, operationsPerThread, percentMissing]() {
+                BwTree::ThreadInfo<Key, Key> threadInfo = tree.getThreadInfo();
+                std::default_random_engine d(thread_i);
+                std::uniform_int_distribution<std::size_t> randIndex(0, valuesCount - 1);
+                std::uniform_int_distribution<unsigned> rand(1, 100);
+                for (std::size_t op_i = 0; op_i < operationsPerThread; ++op_i) {
+                    const std::size_t index = randIndex(d);
+                    if (rand(d) <= 10) {
+                        tree.insert(4 * index, &values[index], threadInfo);
+                    } else if (rand(d) <= percentMissing) {
+                        tree.search(4 * index + 2, threadInfo);
+                    } else {
+                        tree.search(values[index], threadInfo);
+                    }
+                }
+                tree.threadFinishedWithTree(threadInfo);
+            }));
+        }
+        for (auto &thread : threads) {
+            thread.join();
+        }
+        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now() - starttime);
+        const std::size_t operations = operationsPerThread * numberOfThreads;
+
+        std::cout << numberOfThreads << "," << operations << "," << percentMissing << "," << settings.getName() << ",";
+        std::cout << duration.count() << ", ";
+        std::cout << (duration.count() > 0 ? (operations * 1000 / duration.count()) : 0) << ", ";
+        std::cout << tree.getDeltaSummaryChecks() << ", " << tree.getDeltaSummarySkips() << ", ";
+        std::cout << (tree.getDeltaSummaryChecks() > 0 ? 100.0 * tree.getDeltaSummarySkips() / tree.getDeltaSummaryChecks() : 0.0) << "%" << std::endl;
+    }
+}
+
+/**
+* updates inside one EpocheSession per thread, the sessions move on to the current epoche and collect their garbage
+* between two operations, so the pending garbage stays bounded although no thread ever leaves its session
+*/
+template<typename Key>
+void testBwTreeEpocheSession() {
+    std::cout << "threads, operations, settings, time in ms, operations per s, max pending garbage bytes" << std::endl;
+    const std::size_t valuesCount = 1000000;
+    const std::size_t operationsPerThread = 2000000;
+    // without refreshing the sessions all garbage of the run would stay, more than a GB
+    const std::size_t maxExpectedPendingBytes = 64 << 20;
+    std::vector<Key> values(valuesCount);
+    std::vector<KeyValue<Key, Key>> records;
+    for (std::size_t i = 0; i < valuesCount; ++i) {
+        values[i] = i;
+        records.push_back(KeyValue<Key, Key>(values[i], &values[i]));
+    }
+    auto settings = BwTree::Settings("400, 200, 7, 7", 400, {200}, 7, {7});
+
+    for (int numberOfThreads = 1; numberOfThreads <= 4; ++numberOfThreads) {
+        Tree<Key, Key> tree(settings);
+        {
+            BwTree::ThreadInfo<Key, Key> threadInfo = tree.getThreadInfo();
+            tree.bulkLoad(records.begin(), records.end(), 0.8, threadInfo);
+        }
+        std::atomic<int> running(numberOfThreads);
+        std::vector<std::thread> threads;
+        auto starttime = std::chrono::system_clock::now();
+        for (int thread_i = 0; thread_i < numberOfThreads; ++thread_i) {
+            threads.push_back(std::thread([&tree, &values, &running, thread_i, valuesCount, operationsPerThread]() {
+                BwTree::ThreadInfo<Key, Key> threadInfo = tree.getThreadInfo();
+                {
+                    BwTree::EpocheSession<Key, Key> session(threadInfo);
+                    std::default_random_engine d(thread_i);
+                    std::uniform_int_distribution<std::size_t> randIndex(0, valuesCount - 1);
+                    for (std::size_t op_i = 0; op_i < operationsPerThread; ++op_i) {
+                        const std::size_t index = randIndex(d);
+                        if (op_i % 4 == 0) {
+                            Key value;
+                            if (!tree.lookup(values[index], value, threadInfo) || value != values[index]) {
+                                std::cout << "error key " << values[index] << " not found" << std::endl;
+                            }
+                        } else {
+                            tree.insert(values[index], &values[index], threadInfo);
+                        }
+                    }
+                }
+                // an idle thread in a session would hold back the garbage of the others
+                tree.threadFinishedWithTree(threadInfo);
+                --running;
+            }));
+        }
+        std::size_t maxPendingBytes = 0;
+        while (running.load() > 0) {
+            maxPendingBytes = std::max(maxPendingBytes, tree.metrics().pendingGarbageBytes);
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        maxPendingBytes = std::max(maxPendingBytes, tree.metrics().pendingGarbageBytes);
+        for (auto &thread : threads) {
+            thread.join();
+        }
+        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now() - starttime);
+        const std::size_t operations = operationsPerThread * numberOfThreads;
+
+        std::cout << numberOfThreads << "," << operations << "," << settings.getName() << ",";
+        std::cout << duration.count() << ", ";
+        std::cout << (duration.count() > 0 ? (operations * 1000 / duration.count()) : 0) << ", ";
+        std::cout << maxPendingBytes << std::endl;
+        if (maxPendingBytes > maxExpectedPendingBytes) {
+            std::cout << "error the sessions held back " << maxPendingBytes << " bytes of garbage" << std::endl;
+        }
+    }
+}
+
+/**
+* checkpoints the tree while writers update, delete and insert records, restores the checkpoint into an empty tree and
+* compares every key: records no writer touched have to be exact, the others in their old or new state
+*/
+template<typename Key>
+void testBwTreeCheckpoint() {
+    std::cout << "writer threads, records, settings, checkpoint time in ms, written records, restore time in ms, restored records" << std::endl;
+    const std::size_t valuesCount = 1000000;
+    const std::string path = "bwtree.checkpoint";
+    // even keys below valuesCount are never touched, odd ones are updated to key + valuesCount or, every fourth key, deleted,
+    // keys from valuesCount on are inserted
+    std::vector<Key> values(2 * valuesCount);
+    std::vector<KeyValue<Key, Key>> records;
+    for (std::size_t i = 0; i < 2 * valuesCount; ++i) {
+        values[i] = i;
+    }
+    for (std::size_t i = 0; i < valuesCount; ++i) {
+        records.push_back(KeyValue<Key, Key>(values[i], &values[i]));
+    }
+    auto settings = BwTree::Settings("400, 200, 7, 7", 400, {200}, 7, {7});
+
+    for (int numberOfThreads = 1; numberOfThreads <= 4; ++numberOfThreads) {
+        Tree<Key, Key> tree(settings);
+        BwTree::ThreadInfo<Key, Key> threadInfo = tree.getThreadInfo();
+        tree.bulkLoad(records.begin(), records.end(), 0.8, threadInfo);
+        std::atomic<bool> checkpointDone(false);
+        std::vector<std::thread> threads;
+        for (int thread_i = 0; thread_i < numberOfThreads; ++thread_i) {
+            threads.push_back(std::thread([&tree, &values, &checkpointDone, thread_i, numberOfThreads, valuesCount]() {
+                BwTree::ThreadInfo<Key, Key> threadInfo = tree.getThreadInfo();
+                for (std::size_t i = 2 * thread_i + 1; !checkpointDone.load(); i += 2 * numberOfThreads) {
+                    const std::size_t index = i % valuesCount;
+                    if (index % 4 == 3) {
+                        tree.deleteKey(values[index], threadInfo);
+                    } else {
+                        tree.insert(values[index], &values[index + valuesCount], threadInfo);
+                    }
+                    tree.insert(values[index + valuesCount], &values[index + valuesCount], threadInfo);
+                }
+                tree.threadFinishedWithTree(threadInfo);
+            }));
+        }
+        // let the writers build up delta chains first
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        auto starttime = std::chrono::system_clock::now();
+        const std::size_t written = tree.checkpoint(path, threadInfo);
+        auto checkpointDuration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now() - starttime);
+        checkpointDone.store(true);
+        for (auto &thread : threads) {
+            thread.join();
+        }
+        tree.threadFinishedWithTree(threadInfo);
+
+        Tree<Key, Key> restored(settings);
+        BwTree::ThreadInfo<Key, Key> restoredThreadInfo = restored.getThreadInfo();
+        starttime = std::chrono::system_clock::now();
+        const std::size_t loaded = restored.restore(path, restoredThreadInfo, std::thread::hardware_concurrency());
+        auto restoreDuration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now() - starttime);
+        std::remove(path.c_str());
+
+        std::cout << numberOfThreads << "," << valuesCount << "," << settings.getName() << ",";
+        std::cout << checkpointDuration.count() << ", " << written << ", ";
+        std::cout << restoreDuration.count() << ", " << loaded << std::endl;
+        if (loaded != written) {
+            std::cout << "error restored " << loaded << " of " << written << " records" << std::endl;
+        }
+        std::size_t found = 0;
+        for (std::size_t i = 0; i < 2 * valuesCount; ++i) {
+            Key value;
+            const bool exists = restored.lookup(values[i], value, restoredThreadInfo);
+            found += exists;
+            bool valid;
+            if (i >= valuesCount) {
+                valid = !exists || value == values[i];
+            } else if (i % 2 == 0) {
+                valid = exists && value == values[i];
+            } else {
+                valid = exists ? value == values[i] || (i % 4 != 3 && value == values[i + valuesCount]) : i % 4 == 3;
+            }
+            if (!valid) {
+                std::cout << "error key " << values[i] << (exists ? " has a value it never had" : " is missing") << std::endl;
+            }
+        }
+        if (found != loaded) {
+            std::cout << "error found " << found << " of " << loaded << " restored records" << std::endl;
+        }
+        restored.threadFinishedWithTree(restoredThreadInfo);
+    }
+}
+
+/**
+* logs inserts, repeated updates, deletes and reinserts of the same keys while SMO workers split and consolidate the pages,
+* checkpoints after the inserts and recovers a new tree from the checkpoint and the write ahead log. Every key has to have its last value.
+*/
+template<typename Key>
+void testBwTreeRecovery() {
+    std::cout << "threads, records, settings, checkpoint time in ms, written records, recover time in ms, applied log records" << std::endl;
+    const std::size_t valuesCount = 20000;
+    const std::size_t updatedCount = 10000;
+    const std::size_t updateRounds = 20;
+    const std::string checkpointPath = "bwtree.checkpoint";
+    const std::string walPath = "bwtree.wal";
+    // every key is inserted with the value key, keys below updatedCount are updated to key + valuesCount and key + 2 * valuesCount
+    // in turns, deleted and reinserted with key + 3 * valuesCount
+    std::vector<Key> values(4 * valuesCount);
+    for (std::size_t i = 0; i < values.size(); ++i) {
+        values[i] = i;
+    }
+    auto settings = BwTree::Settings("400, 200, 7, 7, 2 SMO threads", 400, {200}, 7, {7}, 2, BwTree::SMOPolicyType::fixed, false, 0, walPath);
+
+    for (int numberOfThreads = 1; numberOfThreads <= 4; ++numberOfThreads) {
+        std::remove(checkpointPath.c_str());
+        std::remove(walPath.c_str());
+        std::chrono::milliseconds checkpointDuration;
+        std::size_t written;
+        {
+            Tree<Key, Key> tree(settings);
+            BwTree::ThreadInfo<Key, Key> threadInfo = tree.getThreadInfo();
+            std::atomic<int> insertersDone(0);
+            std::vector<std::thread> threads;
+            for (int thread_i = 0; thread_i < numberOfThreads; ++thread_i) {
+                threads.push_back(std::thread([&tree, &values, &insertersDone, thread_i, numberOfThreads, valuesCount, updatedCount, updateRounds]() {
+                    BwTree::ThreadInfo<Key, Key> threadInfo = tree.getThreadInfo();
+                    for (std::size_t i = thread_i; i < valuesCount; i += numberOfThreads) {
+                        tree.insert(values[i], &values[i], threadInfo);
+                    }
+                    ++insertersDone;
+                    for (std::size_t round = 0; round < updateRounds; ++round) {
+                        for (std::size_t i = thread_i; i < updatedCount; i += numberOfThreads) {
+                            tree.insert(values[i], &values[i + (1 + round % 2) * valuesCount], threadInfo);
+                        }
+                    }
+                    for (std::size_t i = thread_i; i < updatedCount; i += numberOfThreads) {
+                        tree.deleteKey(values[i], threadInfo);
+                    }
+                    for (std::size_t i = thread_i; i < updatedCount; i += numberOfThreads) {
+                        tree.insert(values[i], &values[i + 3 * valuesCount], threadInfo);
+                    }
+                    tree.threadFinishedWithTree(threadInfo);
+                }));
+            }
+            while (insertersDone.load() < numberOfThreads) {
+                std::this_thread::yield();
+            }
+            // the writers and the SMO workers keep running, the checkpoint must not wait for idle workers
+            auto starttime = std::chrono::system_clock::now();
+            written = tree.checkpoint(checkpointPath, threadInfo);
+            checkpointDuration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now() - starttime);
+            for (auto &thread : threads) {
+                thread.join();
+            }
+            tree.threadFinishedWithTree(threadInfo);
+        }
+
+        Tree<Key, Key> recovered(settings);
+        BwTree::ThreadInfo<Key, Key> threadInfo = recovered.getThreadInfo();
+        auto starttime = std::chrono::system_clock::now();
+        const std::size_t applied = recovered.recover(checkpointPath, threadInfo, std::thread::hardware_concurrency());
+        auto recoverDuration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now() - starttime);
+
+        std::cout << numberOfThreads << "," << valuesCount << "," << settings.getName() << ",";
+        std::cout << checkpointDuration.count() << ", " << written << ", ";
+        std::cout << recoverDuration.count() << ", " << applied << std::endl;
+        for (std::size_t i = 0; i < valuesCount; ++i) {
+            Key value;
+            if (!recovered.lookup(values[i], value, threadInfo)) {
+                std::cout << "error key " << values[i] << " is missing" << std::endl;
+            } else if (value != values[i < updatedCount ? i + 3 * valuesCount : i]) {
+                std::cout << "error key " << values[i] << " has the value " << value << " instead of its last one" << std::endl;
+            }
+        }
+        recovered.threadFinishedWithTree(threadInfo);
+    }
+    std::remove(checkpointPath.c_str());
+    std::remove(walPath.c_str());
+}
+
+/**
+* writes a tree image, maps it into empty trees and reads it, then updates and inserts on top of the mapped pages.
+* A second tree serving the same image meanwhile has to keep reading the image as it was written.
+*/
+template<typename Key>
+void testBwTreeImage() {
+    std::cout << "threads, records, settings, map time in us, lookup time in ms, update time in ms, leaf consolidations, leaf splits" << std::endl;
+    const std::size_t valuesCount = 1000000;
+    const std::string path = "bwtree.image";
+    // the image holds the odd keys below 2 * valuesCount with the value key * 3, the updates set key * 5 and insert the even keys
+    std::vector<Key> keys(2 * valuesCount);
+    std::vector<Key> imageValues(2 * valuesCount);
+    std::vector<Key> updatedValues(2 * valuesCount);
+    for (std::size_t i = 0; i < 2 * valuesCount; ++i) {
+        keys[i] = i;
+        imageValues[i] = i * 3;
+        updatedValues[i] = i * 5;
+    }
+    auto settings = BwTree::Settings("400, 200, 7, 7", 400, {200}, 7, {7});
+    {
+        std::vector<KeyValue<Key, Key>> records;
+        for (std::size_t i = 1; i < 2 * valuesCount; i += 2) {
+            records.push_back(KeyValue<Key, Key>(keys[i], &imageValues[i]));
+        }
+        Tree<Key, Key> tree(settings);
+        BwTree::ThreadInfo<Key, Key> threadInfo = tree.getThreadInfo();
+        tree.bulkLoad(records.begin(), records.end(), 0.8, threadInfo);
+        const std::size_t written = tree.writeImage(path, threadInfo);
+        if (written != valuesCount) {
+            std::cout << "error the image has " << written << " of " << valuesCount << " records" << std::endl;
+        }
+        tree.threadFinishedWithTree(threadInfo);
+    }
+    auto checkImage = [&](Tree<Key, Key> &tree, BwTree::ThreadInfo<Key, Key> &threadInfo) {
+        for (std::size_t i = 0; i < 2 * valuesCount; ++i) {
+            Key value;
+            const bool exists = tree.lookup(keys[i], value, threadInfo);
+            if (exists != (i % 2 == 1) || (exists && value != imageValues[i])) {
+                std::cout << "error key " << keys[i] << " differs from the image" << std::endl;
+            }
+        }
+        std::size_t count = 0;
+        for (BwTree::ForwardIterator<Key, Key> it(tree, keys[0], keys[2 * valuesCount - 1], threadInfo); it.valid(); it.next()) {
+            ++count;
+        }
+        if (count != valuesCount) {
+            std::cout << "error the iterator returned " << count << " of " << valuesCount << " records of the image" << std::endl;
+        }
+    };
+
+    Tree<Key, Key> pristine(settings);
+    BwTree::ThreadInfo<Key, Key> pristineThreadInfo = pristine.getThreadInfo();
+    pristine.mapImage(path, pristineThreadInfo);
+    for (int numberOfThreads = 1; numberOfThreads <= 4; ++numberOfThreads) {
+        Tree<Key, Key> tree(settings);
+        BwTree::ThreadInfo<Key, Key> threadInfo = tree.getThreadInfo();
+        auto starttime = std::chrono::system_clock::now();
+        tree.mapImage(path, threadInfo);
+        auto mapDuration = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - starttime);
+        starttime = std::chrono::system_clock::now();
+        checkImage(tree, threadInfo);
+        auto lookupDuration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now() - starttime);
+
+        std::vector<std::thread> threads;
+        starttime = std::chrono::system_clock::now();
+        for (int thread_i = 0; thread_i < numberOfThreads; ++thread_i) {
+            threads.push_back(std::thread([&tree, &keys, &updatedValues, thread_i, numberOfThreads]() {
+                BwTree::ThreadInfo<Key, Key> threadInfo = tree.getThreadInfo();
+                for (std::size_t i = thread_i; i < keys.size(); i += numberOfThreads) {
+                    tree.insert(keys[i], &updatedValues[i], threadInfo);
+                }
+                tree.threadFinishedWithTree(threadInfo);
+            }));
+        }
+        for (auto &thread : threads) {
+            thread.join();
+        }
+        auto updateDuration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now() - starttime);
+        for (std::size_t i = 0; i < 2 * valuesCount; ++i) {
+            Key value;
+            if (!tree.lookup(keys[i], value, threadInfo) || value != updatedValues[i]) {
+                std::cout << "error key " << keys[i] << " lost its update" << std::endl;
+            }
+        }
+        tree.threadFinishedWithTree(threadInfo);
+        checkImage(pristine, pristineThreadInfo);
+
+        std::cout << numberOfThreads << "," << valuesCount << "," << settings.getName() << ",";
+        std::cout << mapDuration.count() << ", " << lookupDuration.count() << ", " << updateDuration.count() << ", ";
+        std::cout << tree.getSuccessfulLeafConsolidate() << ", " << tree.getSuccessfulLeafSplit() << std::endl;
+    }
+    pristine.threadFinishedWithTree(pristineThreadInfo);
+    std::remove(path.c_str());
+}
+
+/**
+* runs a tree with a page store over a memory budget far below its size. Every round updates a third of the hot keys, which
+* faults in and dirties their evicted leaves, and reads another third of them. The cold leaves stay evicted and are relocated
+* by the cleaning of the page store. The hot keys are looked up and scanned after every round, all keys at the end.
+*/
+template<typename Key>
+void testBwTreePageStore() {
+    std::cout << "threads, records, settings, memory budget in MB, time in ms, evicted pages, faulted pages, relocated pages" << std::endl;
+    const std::size_t valuesCount = 1000000;
+    const std::size_t hotCount = valuesCount / 2;
+    const std::size_t memoryBudget = 4 << 20;
+    const int rounds = 12;
+    const std::string path = "bwtree.pages";
+    std::vector<KeyValue<Key, Key>> records;
+    for (std::size_t i = 0; i < valuesCount; ++i) {
+        const Key value = i * 3;
+        records.push_back(KeyValue<Key, Key>(i, &value));
+    }
+    // round r updates the hot keys with key % 3 == r % 3 to key * 5 + r, value of key once the first completedRounds rounds are done
+    auto expected = [hotCount](std::size_t key, int completedRounds) -> Key {
+        const int third = key % 3;
+        if (key >= hotCount || third >= completedRounds) {
+            return key * 3;
+        }
+        return key * 5 + (completedRounds - 1 - (completedRounds - 1 - third) % 3);
+    };
+    auto check = [&expected](Tree<Key, Key> &tree, std::size_t count, int completedRounds, BwTree::ThreadInfo<Key, Key> &threadInfo) {
+        for (std::size_t i = 0; i < count; ++i) {
+            Key value;
+            if (!tree.lookup(i, value, threadInfo)) {
+                std::cout << "error key " << i << " is missing after round " << completedRounds << std::endl;
+            } else if (value != expected(i, completedRounds)) {
+                std::cout << "error key " << i << " has a wrong value after round " << completedRounds << std::endl;
+            }
+        }
+        std::vector<KeyValue<Key, Key>> scanned;
+        tree.scan(0, count - 1, scanned, threadInfo);
+        if (scanned.size() != count) {
+            std::cout << "error scan found " << scanned.size() << " of " << count << " records after round " << completedRounds << std::endl;
+        }
+        for (std::size_t i = 0; i < scanned.size(); ++i) {
+            if (scanned[i].key != i || *scanned[i].data() != expected(i, completedRounds)) {
+                std::cout << "error scan returned a wrong record at " << i << " after round " << completedRounds << std::endl;
+                break;
+            }
+        }
+        scanned.clear();
+        tree.reverseScan(count - 1, 0, 1000, scanned, threadInfo);
+        for (std::size_t i = 0; i < scanned.size(); ++i) {
+            if (scanned[i].key != count - 1 - i || *scanned[i].data() != expected(count - 1 - i, completedRounds)) {
+                std::cout << "error reverse scan returned a wrong record at " << count - 1 - i << " after round " << completedRounds << std::endl;
+                break;
+            }
+        }
+        if (scanned.size() != 1000) {
+            std::cout << "error reverse scan found " << scanned.size() << " of 1000 records after round " << completedRounds << std::endl;
+        }
+    };
+    auto settings = BwTree::Settings("400, 200, 7, 7", 400, {200}, 7, {7}, 0, BwTree::SMOPolicyType::fixed, false, 0, "",
+                                     BwTree::WALSyncPolicy::commit, std::chrono::milliseconds(1), path, memoryBudget);
+
+    for (int numberOfThreads = 1; numberOfThreads <= 4; ++numberOfThreads) {
+        Tree<Key, Key> tree(settings);
+        BwTree::ThreadInfo<Key, Key> threadInfo = tree.getThreadInfo();
+        tree.bulkLoad(records.begin(), records.end(), 0.8, threadInfo);
+        tree.threadQuiescent(threadInfo);
+        for (int wait = 0; wait < 100 && tree.getEvictedPages() == 0; ++wait) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+
+        auto starttime = std::chrono::system_clock::now();
+        for (int round = 0; round < rounds; ++round) {
+            std::atomic<std::size_t> errors(0);
+            std::vector<std::thread> threads;
+            for (int thread_i = 0; thread_i < numberOfThreads; ++thread_i) {
+                threads.push_back(std::thread([&tree, &errors, &expected, thread_i, numberOfThreads, round, hotCount]() {
+                    BwTree::ThreadInfo<Key, Key> threadInfo = tree.getThreadInfo();
+                    for (std::size_t i = round % 3 + 3 * thread_i; i < hotCount; i += 3 * numberOfThreads) {
+                        const Key value = i * 5 + round;
+                        tree.insert(i, &value, threadInfo);
+                        // the next key is in the following third, which this round does not change
+                        const std::size_t other = i + 1;
+                        Key otherValue;
+                        if (other < hotCount && (!tree.lookup(other, otherValue, threadInfo) || otherValue != expected(other, round))) {
+                            ++errors;
+                        }
+                    }
+                    tree.threadFinishedWithTree(threadInfo);
+                }));
+            }
+            for (auto &thread : threads) {
+                thread.join();
+            }
+            if (errors.load() > 0) {
+                std::cout << "error " << errors.load() << " lookups during round " << round << " failed" << std::endl;
+            }
+            check(tree, hotCount, round + 1, threadInfo);
+            // give the evictor time to bring the tree back under its budget and to clean the page store
+            tree.threadQuiescent(threadInfo);
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        }
+        check(tree, valuesCount, rounds, threadInfo);
+        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now() - starttime);
+
+        std::cout << numberOfThreads << "," << valuesCount << "," << settings.getName() << "," << (memoryBudget >> 20) << ",";
+        std::cout << duration.count() << ", " << tree.getEvictedPages() << ", " << tree.getFaultedPages() << ", " << tree.getRelocatedPages() << std::endl;
+        if (tree.getEvictedPages() == 0 || tree.getFaultedPages() == 0 || tree.getRelocatedPages() == 0) {
+            std::cout << "error pages were not evicted, faulted in and relocated" << std::endl;
+        }
+        if (tree.hasEvictionFailed()) {
+            std::cout << "error the evictor failed" << std::endl;
+        }
+        tree.threadFinishedWithTree(threadInfo);
+    }
+}
+
+/**
+* compares the lower_bound on an array of records or KeyPids, the layout before the key arrays, with the search kernel on the keys
+*/
+template<typename Entry, typename Key>
+void benchmarkSearchKernel(const char *page, const std::vector<Entry> &entries, const std::vector<Key> &keys, const std::vector<Key> &lookups) {
+    std::size_t scalarSum = 0;
+    auto starttime = std::chrono::system_clock::now();
+    for (const Key &key : lookups) {
+        scalarSum += std::distance(entries.begin(), std::lower_bound(entries.begin(), entries.end(), key, [](const Entry &entry, const Key &key) {
+            return entry.key < key;
+        }));
+    }
+    auto scalarDuration = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now() - starttime);
+    std::size_t kernelSum = 0;
+    starttime = std::chrono::system_clock::now();
+    for (const Key &key : lookups) {
+        kernelSum += SearchKernel<Key>::lowerBound(keys.data(), keys.size(), key);
+    }
+    auto kernelDuration = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now() - starttime);
+
+    std::cout << page << "," << entries.size() << "," << SearchKernel<Key>::name() << ",";
+    std::cout << static_cast<double>(scalarDuration.count()) / lookups.size() << ", ";
+    std::cout << static_cast<double>(kernelDuration.count()) / lookups.size() << ", ";
+    std::cout << (scalarSum == kernelSum ? "ok" : "MISMATCH") << std::endl;
+}
+
+template<typename Key>
+void testSearchKernels() {
+    std::cout << "page, entries, kernel, record array ns per search, key array kernel ns per search, result" << std::endl;
+    std::default_random_engine d;
+    std::uniform_int_distribution<Key> rand(0, std::numeric_limits<Key>::max());
+    const std::size_t lookupsCount = 10000000;
+    for (std::size_t size : {8, 32, 64, 128, 200, 400}) {
+        std::vector<Key> keys(size);
+        for (auto &key : keys) {
+            key = rand(d);
+        }
+        std::sort(keys.begin(), keys.end());
+        std::vector<Key> lookups(lookupsCount);
+        for (std::size_t i = 0; i < lookupsCount; ++i) {
+            lookups[i] = i % 2 == 0 ? keys[rand(d) % size] : rand(d);
+        }
+        std::vector<KeyValue<Key, Key>> records;
+        std::vector<KeyPid<Key, Key>> nodes;
+        for (std::size_t i = 0; i < size; ++i) {
+            records.push_back(KeyValue<Key, Key>(keys[i], &keys[i]));
+            nodes.push_back(KeyPid<Key, Key>(keys[i], i));
+        }
+        benchmarkSearchKernel("leaf", records, keys, lookups);
+        benchmarkSearchKernel("inner", nodes, keys, lookups);
+    }
+}
+
+template<typename Key>
+BwTreeCommandsResult createBwTreeCommands(const std::size_t numberOfThreads, const std::vector<Key> &values, const std::vector<Key> &initial_values, const std::size_t operations, const unsigned percentRead, BwTree::Tree<Key, Key> &tree, bool block) {
     std::default_random_engine d;
     std::uniform_int_distribution<unsigned> rand(1, 100);
 
@@ -186,41 +984,182 @@ std::chrono::milliseconds createBwTreeCommands(const std::size_t numberOfThreads
         startOps += deltaOps;
     }
 
+    BwTreeCommandsResult result;
     if (block) BLOCK();
-    auto starttime = std::chrono::system_clock::now();
-    executeBwTreeCommands(commands, tree);
-    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now() - starttime);
+    auto starttime = std::chrono::steady_clock::now();
+    executeBwTreeCommands(commands, tree, result.latencies);
+    result.duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - starttime);
     if (block) BLOCK();
 
-    return duration;
+    return result;
 }
 
 template<typename Key>
-void executeBwTreeCommands(const std::vector<std::vector<BwTreeCommand<Key, Key>>> &commands, BwTree::Tree<Key, Key> &tree) {
+void executeBwTreeCommands(const std::vector<std::vector<BwTreeCommand<Key, Key>>> &commands, BwTree::Tree<Key, Key> &tree, std::array<BwTree::LatencyHistogram, bwTreeCommandTypes> &latencies) {
+    std::vector<std::array<BwTree::LatencyHistogram, bwTreeCommandTypes>> threadLatencies(commands.size());
     std::vector<std::thread> threads;
-    for (auto &cmds : commands) {
-        threads.push_back(std::thread([&tree, &cmds]() {
+    for (std::size_t thread_i = 0; thread_i < commands.size(); ++thread_i) {
+        threads.push_back(std::thread([&tree, &cmds = commands[thread_i], &histograms = threadLatencies[thread_i]]() {
             BwTree::ThreadInfo<Key, Key> threadInfo = tree.getThreadInfo();
-            for (auto &command : cmds) {
-                switch (command.type) {
-                    case BwTreeCommandType::insert:
-                        tree.insert(command.key, command.data, threadInfo);
-                        break;
-                    case BwTreeCommandType::search:
-                        tree.search(command.key, threadInfo);
-                        break;
+            {
+                // the operations of the thread do not publish their epoche one by one
+                BwTree::EpocheSession<Key, Key> session(threadInfo);
+                auto last = std::chrono::steady_clock::now();
+                for (auto &command : cmds) {
+                    switch (command.type) {
+                        case BwTreeCommandType::insert:
+                            tree.insert(command.key, command.data, threadInfo);
+                            break;
+                        case BwTreeCommandType::search:
+                            tree.search(command.key, threadInfo);
+                            break;
+                        case BwTreeCommandType::update:
+                            tree.insert(command.key, command.data, threadInfo);
+                            break;
+                        case BwTreeCommandType::scan: {
+                            BwTree::ForwardIterator<Key, Key> iterator(tree, command.key, std::numeric_limits<Key>::max(), threadInfo);
+                            for (std::size_t i = 0; i < command.length && iterator.valid(); ++i) {
+                                iterator.next();
+                            }
+                            break;
+                        }
+                        case BwTreeCommandType::readModifyWrite: {
+                            Key value;
+                            if (tree.lookup(command.key, value, threadInfo)) {
+                                ++value;
+                                tree.insert(command.key, &value, threadInfo);
+                            }
+                            break;
+                        }
+                    }
+                    // the end of an operation is the start of the next one, one clock read per operation
+                    const auto now = std::chrono::steady_clock::now();
+                    histograms[static_cast<std::size_t>(command.type)].record(std::chrono::duration_cast<std::chrono::nanoseconds>(now - last).count());
+                    last = now;
                 }
             }
-            tree.threadFinishedWithTree();
+            tree.threadFinishedWithTree(threadInfo);
         }));
     }
 
     for (auto &thread : threads) {
         thread.join();
     }
+    for (auto &histograms : threadLatencies) {
+        for (std::size_t type = 0; type < bwTreeCommandTypes; ++type) {
+            latencies[type].merge(histograms[type]);
+        }
+    }
 }
 
-int main() {
+/**
+* runs the given YCSB workloads with 1 to maxThreads threads, distribution overrides the distribution of the workloads if set
+*/
+template<typename Key>
+void testYcsb(const std::vector<YcsbWorkload> &workloads, const KeyDistribution *distribution, const std::size_t maxThreads, const std::size_t recordCount, const std::size_t operations) {
+    std::cout << "workload, distribution, threads, records, operations, settings, time in ms, operations per s, exchange collisions";
+    for (std::size_t type = 0; type < bwTreeCommandTypes; ++type) {
+        const char *name = bwTreeCommandTypeName(static_cast<BwTreeCommandType>(type));
+        std::cout << ", " << name << " operations, " << name << " p50 (ns), " << name << " p99 (ns), " << name << " p99.9 (ns), " << name << " max (ns)";
+    }
+    std::cout << std::endl;
+
+    std::vector<BwTree::Settings> settingsList{{
+            BwTree::Settings("400, 200, 7, 7", 400, {200}, 7, {7}),
+            BwTree::Settings("400, 200, 7, 7, adaptive", 400, {200}, 7, {7}, 0, BwTree::SMOPolicyType::adaptive),
+    }};
+    for (const YcsbWorkload &workload : workloads) {
+        const KeyDistribution keyDistribution = distribution != nullptr ? *distribution : workload.distribution;
+        for (std::size_t numberOfThreads = 1; numberOfThreads <= maxThreads; ++numberOfThreads) {
+            std::vector<Key> keys;
+            const auto commands = createYcsbCommands<Key>(workload, keyDistribution, numberOfThreads, recordCount, operations, keys);
+            std::vector<KeyValue<Key, Key>> initialRecords;
+            for (std::size_t i = 0; i < recordCount; ++i) {
+                initialRecords.push_back(KeyValue<Key, Key>(keys[i], &keys[i]));
+            }
+            std::sort(initialRecords.begin(), initialRecords.end(), [](const KeyValue<Key, Key> &t1, const KeyValue<Key, Key> &t2) {
+                return t1.key < t2.key;
+            });
+
+            for (auto &settings : settingsList) {
+                Tree<Key, Key> tree(settings);
+                {
+                    BwTree::ThreadInfo<Key, Key> threadInfo = tree.getThreadInfo();
+                    tree.bulkLoad(initialRecords.begin(), initialRecords.end(), 0.8, threadInfo, std::thread::hardware_concurrency());
+                }
+                std::array<BwTree::LatencyHistogram, bwTreeCommandTypes> latencies;
+                auto starttime = std::chrono::steady_clock::now();
+                executeBwTreeCommands(commands, tree, latencies);
+                auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - starttime);
+
+                std::cout << workload.name << "," << keyDistributionName(keyDistribution) << "," << numberOfThreads << "," << recordCount << "," << operations << "," << settings.getName() << ",";
+                std::cout << duration.count() << "," << (duration.count() > 0 ? (operations * 1000 / duration.count()) : 0) << ",";
+                std::cout << tree.getAtomicCollisions();
+                for (const BwTree::LatencyHistogram &histogram : latencies) {
+                    std::cout << "," << histogram.getCount() << "," << histogram.percentile(50) << "," << histogram.percentile(99) << "," << histogram.percentile(99.9) << "," << histogram.getMax();
+                }
+                std::cout << std::endl;
+            }
+        }
+    }
+}
+
+/**
+* returns false unless text is a positive decimal number
+*/
+bool parseCount(const char *text, std::size_t &count) {
+    if (!std::isdigit(static_cast<unsigned char>(text[0]))) {
+        return false;
+    }
+    errno = 0;
+    char *end;
+    const unsigned long long value = std::strtoull(text, &end, 10);
+    if (errno != 0 || *end != '\0' || value == 0 || value > std::numeric_limits<std::size_t>::max()) {
+        return false;
+    }
+    count = static_cast<std::size_t>(value);
+    return true;
+}
+
+/**
+* BwTree ycsb [workloads] [distribution] [threads] [records] [operations]
+*/
+int runYcsb(int argc, char **argv) {
+    const char *usage = "usage: BwTree ycsb [workloads] [distribution] [threads] [records] [operations]";
+    std::vector<YcsbWorkload> workloads;
+    const std::string names = argc > 0 ? argv[0] : "ABCDEF";
+    for (char name : names) {
+        auto workload = std::find_if(ycsbWorkloads().begin(), ycsbWorkloads().end(), [name](const YcsbWorkload &workload) {
+            return workload.name == std::toupper(name);
+        });
+        if (workload == ycsbWorkloads().end()) {
+            std::cerr << "unknown workload " << name << ", expected some of ABCDEF" << std::endl << usage << std::endl;
+            return EXIT_FAILURE;
+        }
+        workloads.push_back(*workload);
+    }
+    KeyDistribution distribution;
+    const bool overrideDistribution = argc > 1 && std::string(argv[1]) != "default";
+    if (overrideDistribution && !parseKeyDistribution(argv[1], distribution)) {
+        std::cerr << "unknown distribution " << argv[1] << ", expected default, uniform, zipfian, scrambled, latest or hotspot" << std::endl << usage << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::size_t counts[] = {8, 1000000, 10000000};
+    const char *countNames[] = {"threads", "records", "operations"};
+    for (int i = 0; i < 3 && i + 2 < argc; ++i) {
+        if (!parseCount(argv[i + 2], counts[i])) {
+            std::cerr << "invalid number of " << countNames[i] << " " << argv[i + 2] << ", expected a positive number" << std::endl << usage << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    testYcsb<unsigned long long>(workloads, overrideDistribution ? &distribution : nullptr, counts[0], counts[1], counts[2]);
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1 && std::string(argv[1]) == "ycsb") {
+        return runYcsb(argc - 2, argv + 2);
+    }
 //    testBwTreeNew<unsigned long long>(293);
 //    for (std::size_t i = 20; i < 300; ++i) {
 //        std::cout << i << std::endl;
@@ -228,5 +1167,16 @@ int main() {
 //    }
 //    return EXIT_SUCCESS;
     testBwTree<unsigned long long>();
+    testBwTreeScan<unsigned long long>();
+    testBwTreeBatchInsert<unsigned long long>();
+    testBwTreeVarKey();
+    testBwTreeMissingKeys<unsigned long long>();
+    testBwTreeEpocheSession<unsigned long long>();
+    testBwTreeCheckpoint<unsigned long long>();
+    testBwTreeRecovery<unsigned long long>();
+    testBwTreeImage<unsigned long long>();
+    testBwTreePageStore<unsigned long long>();
+    testSearchKernels<unsigned long long>();
+    testSearchKernels<std::uint32_t>();
     return EXIT_SUCCESS;
 }
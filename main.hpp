@@ -1,22 +1,63 @@
+#ifndef MAIN_HPP
+#define MAIN_HPP
+
 #define BLOCK(){std::string c;std::cout << "...";std::cin >> c;}
 
 enum class BwTreeCommandType : std::int8_t {
     insert,
-    search
+    search,
+    // insert of an existing key
+    update,
+    // reads length records starting at key
+    scan,
+    // lookup of the value followed by an update with the incremented value
+    readModifyWrite
 };
 
+constexpr std::size_t bwTreeCommandTypes = 5;
+
+inline const char *bwTreeCommandTypeName(BwTreeCommandType type) {
+    switch (type) {
+        case BwTreeCommandType::insert:
+            return "insert";
+        case BwTreeCommandType::search:
+            return "search";
+        case BwTreeCommandType::update:
+            return "update";
+        case BwTreeCommandType::scan:
+            return "scan";
+        case BwTreeCommandType::readModifyWrite:
+            return "read-modify-write";
+    }
+    return "unknown";
+}
+
 template<typename Key, typename Data>
 struct BwTreeCommand {
     const BwTreeCommandType type;
     const Key key;
     const Data *data;
+    const std::size_t length;
 
-    BwTreeCommand(BwTreeCommandType const &type, Key const key, Data const *data) : type(type), key(key), data(data) {
+    BwTreeCommand(BwTreeCommandType const &type, Key const key, Data const *data, std::size_t const length = 0) : type(type), key(key), data(data), length(length) {
     }
 };
 
+/**
+* wall time of a run and the latencies in ns of its operations by BwTreeCommandType
+*/
+struct BwTreeCommandsResult {
+    std::chrono::milliseconds duration;
+    std::array<BwTree::LatencyHistogram, bwTreeCommandTypes> latencies;
+};
+
 template<typename Key>
-std::chrono::milliseconds createBwTreeCommands(const std::size_t numberOfThreads, const std::vector<Key> &values, const std::vector<Key> &initial_values, const std::size_t operations, const unsigned percentRead, BwTree::Tree<Key, Key> &tree, bool block);
+BwTreeCommandsResult createBwTreeCommands(const std::size_t numberOfThreads, const std::vector<Key> &values, const std::vector<Key> &initial_values, const std::size_t operations, const unsigned percentRead, BwTree::Tree<Key, Key> &tree, bool block);
 
+/**
+* every thread times its operations on the steady clock into its own histograms, they are merged into latencies after the run
+*/
 template<typename Key>
-void executeBwTreeCommands(const std::vector<std::vector<BwTreeCommand<Key, Key>>> &commands, BwTree::Tree<Key, Key> &tree);
+void executeBwTreeCommands(const std::vector<std::vector<BwTreeCommand<Key, Key>>> &commands, BwTree::Tree<Key, Key> &tree, std::array<BwTree::LatencyHistogram, bwTreeCommandTypes> &latencies);
+
+#endif
@@ -0,0 +1,244 @@
+#ifndef MAPPING_HPP
+#define MAPPING_HPP
+
+#include <atomic>
+#include <new>
+#include <stdexcept>
+#include <cstdint>
+#include <sys/mman.h>
+#include "nodes.hpp"
+#include "metrics.hpp"
+
+namespace BwTree {
+
+    /**
+    * Lock free, growable mapping table from PIDs to nodes.
+    *
+    * The table is a two level directory: the upper bits of a PID select a segment, the lower bits the entry in that segment.
+    * Segments are allocated on first use and are never moved or freed while the table exists,
+    * so resolving a PID needs no locks and only the load of the entry (the directory slot is write once and stays in cache).
+    * Directory and segments are backed by huge pages if available to reduce TLB misses.
+    */
+    template<typename Key, typename Data>
+    class MappingTable {
+        using Entry = std::atomic<Node<Key, Data> *>;
+
+        static constexpr std::size_t hugePageSize = 2 * 1024 * 1024;
+        static constexpr std::size_t segmentBits = 18;
+        static constexpr std::size_t segmentSize = std::size_t(1) << segmentBits;
+        static constexpr std::size_t segmentMask = segmentSize - 1;
+        static constexpr std::size_t segmentBytes = segmentSize * sizeof(Entry); // exactly one huge page
+        static constexpr std::size_t directorySize = hugePageSize / sizeof(std::atomic<Entry *>);
+
+        std::atomic<Entry *> *const directory;
+        // one flag per PID for the second chance of the evictor, only trees with a page store use it, so the directory and
+        // its segments of flags are allocated when first needed
+        std::atomic<std::atomic<std::atomic<std::uint8_t> *> *> referencedDirectory{nullptr};
+        char padding1[64];
+        // every new page increments next, keep it off the cache line of the directory pointer and of the tree's members
+        std::atomic<PID> next{0};
+        char padding2[64];
+
+        static void *allocateHugePages(std::size_t size) {
+#ifdef MAP_HUGETLB
+            void *mem = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (mem != MAP_FAILED) {
+                return mem;
+            }
+#endif
+            // no reserved huge pages, map an aligned region and let transparent huge pages back it
+            char *raw = static_cast<char *>(mmap(nullptr, size + hugePageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+            if (raw == MAP_FAILED) {
+                throw std::bad_alloc();
+            }
+            char *aligned = reinterpret_cast<char *>((reinterpret_cast<std::uintptr_t>(raw) + hugePageSize - 1) & ~(hugePageSize - 1));
+            if (aligned != raw) {
+                munmap(raw, aligned - raw);
+            }
+            munmap(aligned + size, (raw + hugePageSize) - aligned);
+#ifdef MADV_HUGEPAGE
+            madvise(aligned, size, MADV_HUGEPAGE);
+#endif
+            return aligned;
+        }
+
+        static void freeHugePages(void *mem, std::size_t size) {
+            munmap(mem, size);
+        }
+
+        Entry *getSegment(std::size_t index) {
+            Entry *segment = directory[index].load(std::memory_order_acquire);
+            if (segment != nullptr) {
+                return segment;
+            }
+            // mmap returns zeroed memory, so all entries of a new segment are nullptr
+            Entry *newSegment = static_cast<Entry *>(allocateHugePages(segmentBytes));
+            if (directory[index].compare_exchange_strong(segment, newSegment)) {
+                return newSegment;
+            }
+            freeHugePages(newSegment, segmentBytes);
+            return segment;
+        }
+
+        std::atomic<std::atomic<std::uint8_t> *> *getReferencedDirectory() {
+            std::atomic<std::atomic<std::uint8_t> *> *flagsDirectory = referencedDirectory.load(std::memory_order_acquire);
+            if (flagsDirectory != nullptr) {
+                return flagsDirectory;
+            }
+            std::atomic<std::atomic<std::uint8_t> *> *newDirectory = static_cast<std::atomic<std::atomic<std::uint8_t> *> *>(allocateHugePages(hugePageSize));
+            if (referencedDirectory.compare_exchange_strong(flagsDirectory, newDirectory)) {
+                return newDirectory;
+            }
+            freeHugePages(newDirectory, hugePageSize);
+            return flagsDirectory;
+        }
+
+        std::atomic<std::uint8_t> *getReferencedSegment(std::size_t index) {
+            std::atomic<std::atomic<std::uint8_t> *> *flagsDirectory = getReferencedDirectory();
+            std::atomic<std::uint8_t> *flags = flagsDirectory[index].load(std::memory_order_acquire);
+            if (flags != nullptr) {
+                return flags;
+            }
+            void *mem = mmap(nullptr, segmentSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (mem == MAP_FAILED) {
+                throw std::bad_alloc();
+            }
+            std::atomic<std::uint8_t> *newFlags = static_cast<std::atomic<std::uint8_t> *>(mem);
+            if (flagsDirectory[index].compare_exchange_strong(flags, newFlags)) {
+                return newFlags;
+            }
+            munmap(newFlags, segmentSize);
+            return flags;
+        }
+
+    public:
+        MappingTable() : directory(static_cast<std::atomic<Entry *> *>(allocateHugePages(hugePageSize))) {
+        }
+
+        MappingTable(const MappingTable &) = delete;
+
+        MappingTable &operator=(const MappingTable &) = delete;
+
+        ~MappingTable() {
+            std::atomic<std::atomic<std::uint8_t> *> *flagsDirectory = referencedDirectory.load();
+            for (std::size_t i = 0; i < directorySize; ++i) {
+                Entry *segment = directory[i].load();
+                if (segment != nullptr) {
+                    freeHugePages(segment, segmentBytes);
+                }
+                std::atomic<std::uint8_t> *flags = flagsDirectory != nullptr ? flagsDirectory[i].load() : nullptr;
+                if (flags != nullptr) {
+                    munmap(flags, segmentSize);
+                }
+            }
+            freeHugePages(directory, hugePageSize);
+            if (flagsDirectory != nullptr) {
+                freeHugePages(flagsDirectory, hugePageSize);
+            }
+        }
+
+        /**
+        * entry of an already handed out PID
+        */
+        Entry &operator[](const PID pid) {
+            return directory[pid >> segmentBits].load(std::memory_order_acquire)[pid & segmentMask];
+        }
+
+        Node<Key, Data> *get(const PID pid) {
+            return (*this)[pid].load();
+        }
+
+        /**
+        * like get, but nullptr for a PID whose segment is not allocated yet, e.g. while add allocates it
+        */
+        Node<Key, Data> *tryGet(const PID pid) {
+            Entry *segment = directory[pid >> segmentBits].load(std::memory_order_acquire);
+            return segment == nullptr ? nullptr : segment[pid & segmentMask].load();
+        }
+
+        /**
+        * the page was accessed, the flag is only written if it is not set yet so hot pages do not bounce its cache line
+        */
+        void setReferenced(const PID pid) {
+            std::atomic<std::uint8_t> &flag = getReferencedSegment(pid >> segmentBits)[pid & segmentMask];
+            if (flag.load(std::memory_order_relaxed) == 0) {
+                flag.store(1, std::memory_order_relaxed);
+            }
+        }
+
+        /**
+        * returns whether the page was accessed since the last call and clears the flag
+        */
+        bool testAndClearReferenced(const PID pid) {
+            std::atomic<std::uint8_t> &flag = getReferencedSegment(pid >> segmentBits)[pid & segmentMask];
+            return flag.load(std::memory_order_relaxed) != 0 && flag.exchange(0, std::memory_order_relaxed) != 0;
+        }
+
+        /**
+        * stores the node under a new PID, allocating a new segment if necessary
+        */
+        PID add(Node<Key, Data> *node) {
+            const PID pid = next++;
+            if (pid >= capacity()) {
+                throw std::length_error("BwTree mapping table exceeded its maximum size");
+            }
+            getSegment(pid >> segmentBits)[pid & segmentMask].store(node);
+            return pid;
+        }
+
+        /**
+        * hands out count consecutive PIDs, their entries stay nullptr until a node is stored
+        */
+        PID reserve(std::size_t count) {
+            const PID first = next.fetch_add(count);
+            if (first + count > capacity()) {
+                throw std::length_error("BwTree mapping table exceeded its maximum size");
+            }
+            for (std::size_t segment = first >> segmentBits; segment <= (first + count - 1) >> segmentBits; ++segment) {
+                getSegment(segment);
+            }
+            return first;
+        }
+
+        /**
+        * number of PIDs handed out so far
+        */
+        std::size_t size() const {
+            return next.load();
+        }
+
+        /**
+        * Counts the entries which map to a node by scanning all handed out PIDs, concurrent changes may or may not be seen.
+        */
+        MappingOccupancy occupancy() const {
+            MappingOccupancy occupancy;
+            occupancy.pids = size();
+            occupancy.pages = 0;
+            occupancy.segments = 0;
+            occupancy.segmentOccupancy.fill(0);
+            for (std::size_t index = 0; index * segmentSize < occupancy.pids; ++index) {
+                const Entry *segment = directory[index].load(std::memory_order_acquire);
+                if (segment == nullptr) {
+                    // add increments next before allocating the segment
+                    continue;
+                }
+                std::size_t pages = 0;
+                for (std::size_t i = 0; i < segmentSize; ++i) {
+                    if (segment[i].load(std::memory_order_relaxed) != nullptr) {
+                        ++pages;
+                    }
+                }
+                occupancy.pages += pages;
+                occupancy.segments++;
+                occupancy.segmentOccupancy[pages * 10 / segmentSize]++;
+            }
+            return occupancy;
+        }
+
+        static constexpr std::size_t capacity() {
+            return directorySize * segmentSize;
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,98 @@
+#include <new>
+#include <cstdlib>
+#include "metrics.hpp"
+
+namespace BwTree {
+
+    namespace {
+        std::atomic<std::size_t> nextShard{0};
+
+        template<typename Shard>
+        Shard *allocateShards() {
+            static_assert(sizeof(Shard) % 64 == 0, "shards have to fill whole cache lines");
+            void *mem;
+            if (posix_memalign(&mem, 64, metricShards * sizeof(Shard)) != 0) {
+                throw std::bad_alloc();
+            }
+            Shard *shards = static_cast<Shard *>(mem);
+            for (std::size_t i = 0; i < metricShards; ++i) {
+                new(&shards[i]) Shard();
+            }
+            return shards;
+        }
+    }
+
+    std::size_t metricShard() {
+        static thread_local std::size_t shard = nextShard.fetch_add(1, std::memory_order_relaxed) % metricShards;
+        return shard;
+    }
+
+    ShardedCounter::ShardedCounter() : shards(allocateShards<Shard>()) {
+        for (std::size_t i = 0; i < metricShards; ++i) {
+            shards[i].value.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    ShardedCounter::~ShardedCounter() {
+        free(shards);
+    }
+
+    unsigned long ShardedCounter::load() const {
+        unsigned long value = 0;
+        for (std::size_t i = 0; i < metricShards; ++i) {
+            value += shards[i].value.load(std::memory_order_relaxed);
+        }
+        return value;
+    }
+
+    std::uint64_t HistogramSnapshot::percentile(double percent) const {
+        if (count == 0) {
+            return 0;
+        }
+        const double rank = percent / 100.0 * count;
+        unsigned long seen = 0;
+        for (std::size_t i = 0; i < bucketCount; ++i) {
+            seen += buckets[i];
+            if (seen >= rank && buckets[i] > 0) {
+                const std::uint64_t upper = i == 0 ? 0 : (std::uint64_t(1) << i) - 1;
+                return upper < max ? upper : max;
+            }
+        }
+        return max;
+    }
+
+    Histogram::Histogram() : shards(allocateShards<Shard>()) {
+        for (std::size_t i = 0; i < metricShards; ++i) {
+            for (auto &bucket : shards[i].buckets) {
+                bucket.store(0, std::memory_order_relaxed);
+            }
+            shards[i].sum.store(0, std::memory_order_relaxed);
+            shards[i].max.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    Histogram::~Histogram() {
+        free(shards);
+    }
+
+    HistogramSnapshot Histogram::snapshot() const {
+        HistogramSnapshot snapshot;
+        snapshot.buckets.fill(0);
+        snapshot.count = 0;
+        snapshot.sum = 0;
+        snapshot.max = 0;
+        for (std::size_t i = 0; i < metricShards; ++i) {
+            for (std::size_t bucket = 0; bucket < HistogramSnapshot::bucketCount; ++bucket) {
+                const unsigned long count = shards[i].buckets[bucket].load(std::memory_order_relaxed);
+                snapshot.buckets[bucket] += count;
+                snapshot.count += count;
+            }
+            snapshot.sum += shards[i].sum.load(std::memory_order_relaxed);
+            const std::uint64_t max = shards[i].max.load(std::memory_order_relaxed);
+            if (max > snapshot.max) {
+                snapshot.max = max;
+            }
+        }
+        return snapshot;
+    }
+}
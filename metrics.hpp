@@ -0,0 +1,242 @@
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace BwTree {
+
+    /**
+    * Threads are spread over this many cache line padded shards, a thread keeps its shard for its lifetime.
+    */
+    constexpr std::size_t metricShards = 32;
+
+    /**
+    * shard of the calling thread
+    */
+    std::size_t metricShard();
+
+    /**
+    * Counter incremented by many threads, every thread increments the counter of its own shard. Reads add up all shards.
+    */
+    class ShardedCounter {
+        struct Shard {
+            std::atomic<unsigned long> value;
+            char padding[64 - sizeof(std::atomic<unsigned long>)];
+        };
+
+        Shard *shards;
+
+    public:
+        ShardedCounter();
+
+        ~ShardedCounter();
+
+        ShardedCounter(const ShardedCounter &) = delete;
+
+        ShardedCounter &operator=(const ShardedCounter &) = delete;
+
+        void add(unsigned long value) {
+            shards[metricShard()].value.fetch_add(value, std::memory_order_relaxed);
+        }
+
+        ShardedCounter &operator++() {
+            add(1);
+            return *this;
+        }
+
+        unsigned long load() const;
+
+        operator unsigned long() const {
+            return load();
+        }
+    };
+
+    /**
+    * Bucket 0 counts the value 0, bucket i the values in [2^(i-1), 2^i).
+    */
+    struct HistogramSnapshot {
+        static constexpr std::size_t bucketCount = 64;
+
+        std::array<unsigned long, bucketCount> buckets;
+        unsigned long count;
+        std::uint64_t sum;
+        std::uint64_t max;
+
+        double mean() const {
+            return count > 0 ? static_cast<double>(sum) / count : 0.0;
+        }
+
+        /**
+        * upper bound of the bucket which contains the given percentile, at most max
+        */
+        std::uint64_t percentile(double percent) const;
+    };
+
+    /**
+    * Histogram with power of two buckets, sharded like ShardedCounter.
+    */
+    class Histogram {
+        struct Shard {
+            std::atomic<unsigned long> buckets[HistogramSnapshot::bucketCount];
+            std::atomic<std::uint64_t> sum;
+            std::atomic<std::uint64_t> max;
+            char padding[64 - 2 * sizeof(std::atomic<std::uint64_t>)];
+        };
+
+        Shard *shards;
+
+    public:
+        Histogram();
+
+        ~Histogram();
+
+        Histogram(const Histogram &) = delete;
+
+        Histogram &operator=(const Histogram &) = delete;
+
+        static std::size_t bucket(std::uint64_t value) {
+            // values of 2^63 and above share the last bucket
+            const std::size_t bucket = value == 0 ? 0 : 64 - __builtin_clzll(value);
+            return bucket < HistogramSnapshot::bucketCount ? bucket : HistogramSnapshot::bucketCount - 1;
+        }
+
+        void record(std::uint64_t value) {
+            Shard &shard = shards[metricShard()];
+            shard.buckets[bucket(value)].fetch_add(1, std::memory_order_relaxed);
+            shard.sum.fetch_add(value, std::memory_order_relaxed);
+            // with more threads than shards a shard is shared, so a plain store could lower the maximum
+            std::uint64_t max = shard.max.load(std::memory_order_relaxed);
+            while (max < value && !shard.max.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+            }
+        }
+
+        HistogramSnapshot snapshot() const;
+    };
+
+    /**
+    * Histogram with HDR style log linear buckets for a single thread, e.g. of latencies in nanoseconds.
+    * Every power of two is split into 2^subBucketBits linear sub buckets, so recorded values are kept with
+    * a relative error below 2^-subBucketBits, values below 2^subBucketBits are kept exactly.
+    * Histograms of several threads are combined with merge.
+    */
+    class LatencyHistogram {
+        static constexpr unsigned subBucketBits = 5;
+        static constexpr std::size_t subBuckets = std::size_t(1) << subBucketBits;
+        static constexpr std::size_t bucketCount = (64 - subBucketBits + 1) * subBuckets;
+
+        std::array<std::uint64_t, bucketCount> buckets;
+        std::uint64_t count = 0;
+        std::uint64_t max = 0;
+
+        static std::size_t index(std::uint64_t value) {
+            if (value < subBuckets) {
+                return value;
+            }
+            const unsigned shift = 63 - __builtin_clzll(value) - subBucketBits;
+            return (shift + 1) * subBuckets + (value >> shift) - subBuckets;
+        }
+
+        /**
+        * largest value which is recorded in the bucket
+        */
+        static std::uint64_t highestValue(std::size_t index) {
+            if (index < subBuckets) {
+                return index;
+            }
+            const unsigned shift = index / subBuckets - 1;
+            const std::uint64_t lowest = (subBuckets + index % subBuckets) << shift;
+            return lowest + ((std::uint64_t(1) << shift) - 1);
+        }
+
+    public:
+        LatencyHistogram() {
+            buckets.fill(0);
+        }
+
+        void record(std::uint64_t value) {
+            buckets[index(value)]++;
+            count++;
+            if (value > max) {
+                max = value;
+            }
+        }
+
+        void merge(const LatencyHistogram &other) {
+            for (std::size_t i = 0; i < bucketCount; ++i) {
+                buckets[i] += other.buckets[i];
+            }
+            count += other.count;
+            if (other.max > max) {
+                max = other.max;
+            }
+        }
+
+        std::uint64_t getCount() const {
+            return count;
+        }
+
+        std::uint64_t getMax() const {
+            return max;
+        }
+
+        /**
+        * smallest recorded value, up to the bucket precision, which is at least as large as the given percentage of all values
+        */
+        std::uint64_t percentile(double percent) const {
+            if (count == 0) {
+                return 0;
+            }
+            const double rank = percent / 100.0 * count;
+            std::uint64_t seen = 0;
+            for (std::size_t i = 0; i < bucketCount; ++i) {
+                seen += buckets[i];
+                if (buckets[i] > 0 && seen >= rank) {
+                    const std::uint64_t value = highestValue(i);
+                    return value < max ? value : max;
+                }
+            }
+            return max;
+        }
+    };
+
+    struct MappingOccupancy {
+        // PIDs handed out so far and how many of them map to a page
+        std::size_t pids;
+        std::size_t pages;
+        std::size_t segments;
+        // segments by the share of their entries which map to a page, in steps of 10%
+        std::array<std::size_t, 11> segmentOccupancy;
+    };
+
+    /**
+    * Snapshot of the statistics of a tree. The counters and histograms are not read atomically as a whole,
+    * concurrent operations may be counted in some of them but not yet in others.
+    */
+    struct Metrics {
+        unsigned long atomicCollisions;
+        unsigned long successfulLeafConsolidate;
+        unsigned long successfulInnerConsolidate;
+        unsigned long failedLeafConsolidate;
+        unsigned long failedInnerConsolidate;
+        unsigned long successfulLeafSplit;
+        unsigned long successfulInnerSplit;
+        unsigned long failedLeafSplit;
+        unsigned long failedInnerSplit;
+        // delta summaries looked at and skipped by a sample of the walks
+        unsigned long deltaSummaryChecks;
+        unsigned long deltaSummarySkips;
+        // deltas above the leaf of a sample of the walks which reached the leaf
+        HistogramSnapshot deltaChainLength;
+        // levels including the leaf level of a sample of the walks which reached a leaf
+        HistogramSnapshot treeHeight;
+        HistogramSnapshot consolidationNs;
+        MappingOccupancy mapping;
+        // retired nodes which have not been freed yet
+        std::size_t pendingGarbageBytes;
+    };
+}
+
+#endif
@@ -0,0 +1,398 @@
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+#include "bwtree.hpp"
+
+/**
+* Microbenchmarks of the internal hot paths of the tree: search inside a node, walking a delta chain,
+* leaf and inner consolidation and splits. Every benchmark is repeated, the median and minimum ns/op of the repetitions are reported
+* together with the node allocations (NodeAllocator) and heap allocations (operator new) per operation.
+* Setup work, like building the tree a split is done in, is not measured.
+*
+*     BwTreeMicroBench [filter]
+*
+* only runs the benchmarks whose name contains filter.
+*/
+
+namespace {
+    thread_local std::uint64_t heapAllocations = 0;
+
+    // results of benchmarked functions are written here so they are not optimized away
+    volatile std::size_t sink;
+}
+
+void *operator new(std::size_t size) {
+    heapAllocations++;
+    if (void *mem = std::malloc(size > 0 ? size : 1)) {
+        return mem;
+    }
+    throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void *ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void *ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+namespace BwTree {
+
+    /**
+    * access to the private parts of the tree the benchmarks exercise
+    */
+    template<typename Key, typename Data>
+    class TreeMicroBench {
+    public:
+        static std::size_t binarySearch(const Key *keys, std::size_t length, const Key &key) {
+            return Tree<Key, Data>::binarySearch(keys, length, key);
+        }
+
+        static PID root(Tree<Key, Data> &tree) {
+            return tree.root.load();
+        }
+
+        static Node<Key, Data> *node(Tree<Key, Data> &tree, PID pid) {
+            return tree.PIDToNodePtr(pid);
+        }
+
+        static Leaf<Key, Data> *consolidateLeaf(Tree<Key, Data> &tree, Node<Key, Data> *startNode, std::vector<KeyValue<Key, Data>> &records) {
+            records.clear();
+            PID prev, next;
+            std::tie(prev, next) = tree.getConsolidatedLeafData(startNode, records);
+            return Helper<Key, Data>::CreateLeafNodeFromSorted(records.begin(), records.end(), prev, next);
+        }
+
+        static InnerNode<Key, Data> *consolidateInner(Tree<Key, Data> &tree, PID pid, Node<Key, Data> *startNode, std::vector<KeyPid<Key, Data>> &nodes) {
+            nodes.clear();
+            PID prev, next, infinityChild;
+            std::tie(prev, next, infinityChild) = tree.getConsolidatedInnerData(startNode, pid, nodes);
+            return Helper<Key, Data>::CreateInnerNodeFromUnsorted(nodes.begin(), nodes.end(), prev, next, infinityChild);
+        }
+
+        static void splitPage(Tree<Key, Data> &tree, PID pid, PID parent, ThreadInfo<Key, Data> &threadInfo) {
+            EpocheGuard<Key, Data> epocheGuard(threadInfo);
+            tree.splitPage(pid, parent, threadInfo);
+        }
+
+        static void consolidatePage(Tree<Key, Data> &tree, PID pid, ThreadInfo<Key, Data> &threadInfo) {
+            EpocheGuard<Key, Data> epocheGuard(threadInfo);
+            tree.consolidatePage(pid, threadInfo);
+        }
+    };
+}
+
+using namespace BwTree;
+
+using Key = unsigned long long;
+using Internals = TreeMicroBench<Key, Key>;
+
+namespace {
+    constexpr unsigned repetitions = 7;
+
+    /**
+    * time and allocations of the measured parts of one repetition
+    */
+    class Measurement {
+        std::uint64_t ns = 0;
+        std::uint64_t operations = 0;
+        std::uint64_t nodeAllocations = 0;
+        std::uint64_t heapAllocationCount = 0;
+
+    public:
+        template<typename Function>
+        void measure(std::uint64_t operationCount, Function function) {
+            const std::uint64_t nodeAllocationsBefore = NodeAllocator::threadAllocations();
+            const std::uint64_t heapAllocationsBefore = heapAllocations;
+            const auto start = std::chrono::steady_clock::now();
+            function();
+            const auto end = std::chrono::steady_clock::now();
+            heapAllocationCount += heapAllocations - heapAllocationsBefore;
+            nodeAllocations += NodeAllocator::threadAllocations() - nodeAllocationsBefore;
+            ns += std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+            operations += operationCount;
+        }
+
+        double nsPerOperation() const {
+            return operations > 0 ? static_cast<double>(ns) / operations : 0.0;
+        }
+
+        double nodeAllocationsPerOperation() const {
+            return operations > 0 ? static_cast<double>(nodeAllocations) / operations : 0.0;
+        }
+
+        double heapAllocationsPerOperation() const {
+            return operations > 0 ? static_cast<double>(heapAllocationCount) / operations : 0.0;
+        }
+    };
+
+    std::string filter;
+
+    /**
+    * runs the repetitions of the benchmark, repetition gets a fresh Measurement each time
+    */
+    template<typename Repetition>
+    void benchmark(const std::string &name, Repetition repetition) {
+        if (name.find(filter) == std::string::npos) {
+            return;
+        }
+        // warm up caches and the node allocator
+        {
+            Measurement warmup;
+            repetition(warmup);
+        }
+        std::vector<Measurement> measurements(repetitions);
+        for (auto &measurement : measurements) {
+            repetition(measurement);
+        }
+        std::sort(measurements.begin(), measurements.end(), [](const Measurement &m1, const Measurement &m2) {
+            return m1.nsPerOperation() < m2.nsPerOperation();
+        });
+        const Measurement &median = measurements[repetitions / 2];
+        std::cout << std::left << std::setw(40) << name << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(12) << median.nsPerOperation() << std::setw(12) << measurements.front().nsPerOperation()
+                  << std::setprecision(2) << std::setw(14) << median.nodeAllocationsPerOperation() << std::setw(14) << median.heapAllocationsPerOperation() << std::endl;
+    }
+
+    std::vector<Key> randomKeys(std::size_t count, std::uint64_t seed) {
+        std::mt19937_64 random(seed);
+        std::vector<Key> keys(count);
+        for (auto &key : keys) {
+            // even keys, the odd ones in between are missing
+            key = (random() >> 2) << 1;
+        }
+        std::sort(keys.begin(), keys.end());
+        keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+        return keys;
+    }
+
+    std::vector<KeyValue<Key, Key>> records(const std::vector<Key> &keys) {
+        std::vector<KeyValue<Key, Key>> records;
+        for (const Key &key : keys) {
+            records.push_back(KeyValue<Key, Key>(key, &key));
+        }
+        return records;
+    }
+
+    /**
+    * half of the lookups hit a key, the other half falls between two keys
+    */
+    std::vector<Key> lookups(const std::vector<Key> &keys, std::size_t count) {
+        std::mt19937_64 random(7);
+        std::uniform_int_distribution<std::size_t> index(0, keys.size() - 1);
+        std::vector<Key> lookups(count);
+        for (std::size_t i = 0; i < count; ++i) {
+            lookups[i] = keys[index(random)] + (i % 2);
+        }
+        return lookups;
+    }
+
+    void benchmarkNodeSearch() {
+        for (std::size_t size : {8, 32, 128, 512, 2048}) {
+            const std::vector<Key> keys = randomKeys(size, size);
+            const std::vector<Key> probes = lookups(keys, 4096);
+            benchmark("search node size " + std::to_string(keys.size()), [&](Measurement &measurement) {
+                std::size_t sum = 0;
+                const std::size_t operations = 1 << 20;
+                measurement.measure(operations, [&]() {
+                    for (std::size_t i = 0; i < operations; ++i) {
+                        sum += Internals::binarySearch(keys.data(), keys.size(), probes[i % probes.size()]);
+                    }
+                });
+                sink = sum;
+            });
+        }
+    }
+
+    /**
+    * Tree with a single leaf of leafSize records and depth insert deltas above it. Splits and consolidations are disabled.
+    * keys gets the keys of all records.
+    */
+    void buildChain(Tree<Key, Key> &tree, std::size_t leafSize, std::size_t depth, std::vector<Key> &keys) {
+        keys = randomKeys(leafSize + depth, leafSize * 31 + depth);
+        std::vector<Key> base(keys);
+        std::mt19937_64 random(depth);
+        std::shuffle(base.begin(), base.end(), random);
+        std::vector<Key> deltas(base.end() - depth, base.end());
+        base.resize(leafSize);
+        std::sort(base.begin(), base.end());
+        ThreadInfo<Key, Key> threadInfo = tree.getThreadInfo();
+        const auto baseRecords = records(base);
+        tree.bulkLoad(baseRecords.begin(), baseRecords.end(), 1.0, threadInfo);
+        for (const Key &key : deltas) {
+            tree.insert(key, &key, threadInfo);
+        }
+    }
+
+    /**
+    * root of a two level tree, the only leaf below it if the tree has one leaf
+    */
+    PID firstChild(Tree<Key, Key> &tree) {
+        return static_cast<InnerNode<Key, Key> *>(Internals::node(tree, Internals::root(tree)))->children()[0];
+    }
+
+    void benchmarkChainWalk() {
+        for (std::size_t depth : {0, 1, 2, 4, 8, 16, 32}) {
+            Settings settings("chain", 1 << 20, {1 << 20}, 1 << 20, {1 << 20});
+            Tree<Key, Key> tree(settings);
+            std::vector<Key> keys;
+            buildChain(tree, 256, depth, keys);
+            const std::vector<Key> probes = lookups(keys, 4096);
+            ThreadInfo<Key, Key> threadInfo = tree.getThreadInfo();
+            benchmark("search chain depth " + std::to_string(depth), [&](Measurement &measurement) {
+                const std::size_t operations = 1 << 18;
+                std::size_t found = 0;
+                measurement.measure(operations, [&]() {
+                    for (std::size_t i = 0; i < operations; ++i) {
+                        found += static_cast<bool>(tree.search(probes[i % probes.size()], threadInfo));
+                    }
+                });
+                if (found != operations / 2) {
+                    std::cerr << "chain walk found " << found << " of " << operations / 2 << std::endl;
+                }
+            });
+        }
+    }
+
+    void benchmarkLeafConsolidation() {
+        for (auto sizeDepth : {std::make_pair(64, 8), std::make_pair(256, 8), std::make_pair(1024, 8), std::make_pair(256, 1), std::make_pair(256, 32)}) {
+            Settings settings("consolidate leaf", 1 << 20, {1 << 20}, 1 << 20, {1 << 20});
+            Tree<Key, Key> tree(settings);
+            std::vector<Key> keys;
+            buildChain(tree, sizeDepth.first, sizeDepth.second, keys);
+            Node<Key, Key> *startNode = Internals::node(tree, firstChild(tree));
+            std::vector<KeyValue<Key, Key>> consolidated;
+            std::vector<Leaf<Key, Key> *> leaves;
+            benchmark("consolidate leaf " + std::to_string(sizeDepth.first) + " depth " + std::to_string(sizeDepth.second), [&](Measurement &measurement) {
+                const std::size_t operations = 1024;
+                measurement.measure(operations, [&]() {
+                    for (std::size_t i = 0; i < operations; ++i) {
+                        leaves.push_back(Internals::consolidateLeaf(tree, startNode, consolidated));
+                    }
+                });
+                for (auto leaf : leaves) {
+                    freeNodeSingle<Key, Key>(leaf);
+                }
+                leaves.clear();
+            });
+        }
+    }
+
+    /**
+    * Tree with a root of fanout children, every leaf has leafSize records and their leaf split limit.
+    * depth leaves are split, which leaves depth index deltas on the root.
+    */
+    void buildInnerChain(Tree<Key, Key> &tree, std::size_t leafSize, std::size_t fanout, std::size_t depth) {
+        const std::vector<Key> keys = randomKeys(leafSize * fanout, fanout * 17 + depth);
+        ThreadInfo<Key, Key> threadInfo = tree.getThreadInfo();
+        const auto allRecords = records(keys);
+        tree.bulkLoad(allRecords.begin(), allRecords.end(), 1.0, threadInfo);
+        const PID root = Internals::root(tree);
+        const InnerNode<Key, Key> *rootNode = static_cast<InnerNode<Key, Key> *>(Internals::node(tree, root));
+        std::vector<PID> leaves(rootNode->children(), rootNode->children() + rootNode->nodeCount);
+        for (std::size_t i = 0; i < depth; ++i) {
+            Internals::splitPage(tree, leaves[i * leaves.size() / depth], root, threadInfo);
+        }
+    }
+
+    void benchmarkInnerConsolidation() {
+        for (auto fanoutDepth : {std::make_pair(64, 8), std::make_pair(256, 8), std::make_pair(1024, 8), std::make_pair(256, 1), std::make_pair(256, 32)}) {
+            const std::size_t fanout = fanoutDepth.first;
+            Settings settings("consolidate inner", 8, {fanout}, 1 << 20, {1 << 20});
+            Tree<Key, Key> tree(settings);
+            buildInnerChain(tree, 8, fanout, fanoutDepth.second);
+            const PID root = Internals::root(tree);
+            Node<Key, Key> *startNode = Internals::node(tree, root);
+            std::vector<KeyPid<Key, Key>> consolidated;
+            std::vector<InnerNode<Key, Key> *> nodes;
+            benchmark("consolidate inner " + std::to_string(fanout) + " depth " + std::to_string(fanoutDepth.second), [&](Measurement &measurement) {
+                const std::size_t operations = 1024;
+                measurement.measure(operations, [&]() {
+                    for (std::size_t i = 0; i < operations; ++i) {
+                        nodes.push_back(Internals::consolidateInner(tree, root, startNode, consolidated));
+                    }
+                });
+                for (auto node : nodes) {
+                    freeNodeSingle<Key, Key>(node);
+                }
+                nodes.clear();
+            });
+        }
+    }
+
+    /**
+    * splits all pages of the level below the root, the root is consolidated after each split outside of the measurement
+    * so every split sees a consolidated parent
+    */
+    void splitLevel(Tree<Key, Key> &tree, Measurement &measurement) {
+        ThreadInfo<Key, Key> threadInfo = tree.getThreadInfo();
+        const PID root = Internals::root(tree);
+        const InnerNode<Key, Key> *rootNode = static_cast<InnerNode<Key, Key> *>(Internals::node(tree, root));
+        const std::vector<PID> pages(rootNode->children(), rootNode->children() + rootNode->nodeCount);
+        for (PID page : pages) {
+            measurement.measure(1, [&]() {
+                Internals::splitPage(tree, page, root, threadInfo);
+            });
+            Internals::consolidatePage(tree, root, threadInfo);
+        }
+    }
+
+    void benchmarkSplits() {
+        for (std::size_t leafSize : {64, 256, 1024}) {
+            benchmark("split leaf " + std::to_string(leafSize), [&](Measurement &measurement) {
+                Settings settings("split leaf", leafSize, {1 << 20}, 1 << 20, {1 << 20});
+                Tree<Key, Key> tree(settings);
+                const auto allRecords = records(randomKeys(leafSize * 64, leafSize));
+                {
+                    ThreadInfo<Key, Key> threadInfo = tree.getThreadInfo();
+                    tree.bulkLoad(allRecords.begin(), allRecords.end(), 1.0, threadInfo);
+                }
+                splitLevel(tree, measurement);
+            });
+        }
+        for (std::size_t fanout : {64, 256, 1024}) {
+            benchmark("split inner " + std::to_string(fanout), [&](Measurement &measurement) {
+                Settings settings("split inner", 8, {fanout}, 1 << 20, {1 << 20});
+                Tree<Key, Key> tree(settings);
+                // 16 inner nodes below the root
+                const auto allRecords = records(randomKeys(8 * fanout * 16, fanout));
+                {
+                    ThreadInfo<Key, Key> threadInfo = tree.getThreadInfo();
+                    tree.bulkLoad(allRecords.begin(), allRecords.end(), 1.0, threadInfo);
+                }
+                splitLevel(tree, measurement);
+            });
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    filter = argc > 1 ? argv[1] : "";
+    std::cout << std::left << std::setw(40) << "benchmark" << std::right << std::setw(12) << "median ns" << std::setw(12) << "min ns"
+              << std::setw(14) << "node allocs" << std::setw(14) << "heap allocs" << std::endl;
+    benchmarkNodeSearch();
+    benchmarkChainWalk();
+    benchmarkLeafConsolidation();
+    benchmarkInnerConsolidation();
+    benchmarkSplits();
+    return EXIT_SUCCESS;
+}
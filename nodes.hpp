@@ -4,6 +4,13 @@
 #include <algorithm>
 #include <vector>
 #include <tuple>
+#include <array>
+#include <cassert>
+#include <limits>
+#include <type_traits>
+#include <new>
+#include "allocator.hpp"
+#include "key.hpp"
 
 namespace BwTree {
     using PID = std::size_t;
@@ -13,6 +20,7 @@ namespace BwTree {
         leaf,
         inner,
         deltaInsert,
+        deltaInsertBatch,
         deltaDelete,
         deltaIndex,
         deltaSplit,
@@ -23,52 +31,212 @@ namespace BwTree {
     struct Node {
     protected:
         PageType type;
+        // the log sequence number (wal.hpp) is stored in 56 bits in the padding behind type
+        std::uint8_t lsnHigh[3];
+        std::uint32_t lsnLow;
     public:
         const PageType &getType() const {
             return type;
         }
+
+        /**
+        * Record deltas get a higher LSN than the node they are put on, all other nodes the LSN of the node they replace or
+        * extend. So the LSNs of the modifications of a key increase in the order in which they were applied.
+        */
+        std::uint64_t getLSN() const {
+            return (std::uint64_t(lsnHigh[0]) << 48) | (std::uint64_t(lsnHigh[1]) << 40) | (std::uint64_t(lsnHigh[2]) << 32) | lsnLow;
+        }
+
+        void setLSN(std::uint64_t lsn) {
+            lsnHigh[0] = static_cast<std::uint8_t>(lsn >> 48);
+            lsnHigh[1] = static_cast<std::uint8_t>(lsn >> 40);
+            lsnHigh[2] = static_cast<std::uint8_t>(lsn >> 32);
+            lsnLow = static_cast<std::uint32_t>(lsn);
+        }
     };
 
 
     template<typename Key, typename Data>
     struct LinkedNode : Node<Key, Data> {
+        // the node lives in a mapped tree image (image.hpp), it is read only and never freed
+        bool mapped;
+        // number of leading bytes shared by all keys of the node, stored once at the start of its key area
+        std::uint32_t prefixLength;
+        // size of the key area behind the arrays of the node, always 0 for fixed size keys
+        std::uint32_t keyBytes;
         PID prev;
         PID next;
     };
 
+    /**
+    * Small trivially copyable values are stored inside the records, so a lookup needs no further pointer chase
+    * and the caller does not have to keep the value alive. Other values are stored as pointers to memory owned by the caller.
+    */
+    template<typename Data, bool Inline = std::is_trivially_copyable<Data>::value && sizeof(Data) <= 16>
+    struct ValueStorage;
+
+    template<typename Data>
+    struct ValueStorage<Data, true> {
+        static constexpr bool isInline = true;
+        Data value;
+
+        ValueStorage() { }
+
+        ValueStorage(const Data *const &data) : value(*data) { }
+
+        const Data *get() const {
+            return &value;
+        }
+    };
+
+    template<typename Data>
+    struct ValueStorage<Data, false> {
+        static constexpr bool isInline = false;
+        const Data *pointer;
+
+        ValueStorage() { }
+
+        ValueStorage(const Data *const &data) : pointer(data) { }
+
+        const Data *get() const {
+            return pointer;
+        }
+    };
+
+    /**
+    * Result of a search, holds a copy of an inline stored value or the pointer to a referenced one.
+    * It does not reference the tree, so it stays valid after the record has been updated or deleted.
+    */
+    template<typename Data>
+    struct SearchResult {
+        bool found;
+        ValueStorage<Data> value;
+
+        SearchResult() : found(false) { }
+
+        SearchResult(const Data *data) : found(true), value(data) { }
+
+        explicit operator bool() const {
+            return found;
+        }
+
+        const Data &operator*() const {
+            return *value.get();
+        }
+
+        const Data *operator->() const {
+            return value.get();
+        }
+    };
+
     template<typename Key, typename Data>
     struct KeyValue {
         Key key;
-        const Data *data;
+        ValueStorage<Data> value;
+
+        KeyValue(const Key &key, const Data *const & data) : key(key), value(data) { }
 
-        KeyValue(const Key &key, const Data *const & data) : key(key), data(data) { }
+        KeyValue(const Key &key, const ValueStorage<Data> &value) : key(key), value(value) { }
 
         KeyValue operator=(const KeyValue &keyValue) {
             key = keyValue.key;
-            data = keyValue.data;
+            value = keyValue.value;
             return *this;
         }
 
         KeyValue() { }
+
+        /**
+        * points into the record, for inline values only valid as long as the record is
+        */
+        const Data *data() const {
+            return value.get();
+        }
     };
 
+    /**
+    * size rounded up to whole cache lines, the arrays behind the node headers start on a cache line
+    */
+    constexpr std::size_t cacheLineAligned(std::size_t size) {
+        return (size + NodeAllocator::alignment - 1) & ~(NodeAllocator::alignment - 1);
+    }
+
+    /**
+    * Provides the memory of a new leaf or inner node, by default from the slabs of the NodeAllocator.
+    * Other allocations have to return cache line aligned memory as well.
+    */
+    struct NodeAllocation {
+        void *operator()(std::size_t size) const {
+            return NodeAllocator::allocate(size);
+        }
+    };
+
+    /**
+    * The header is followed by the array of all keys and the array of all values, both start on a cache line.
+    * A search only touches the cache lines of the keys, the value is only loaded for the matching key.
+    * The bytes of variable length keys are stored in the key area behind the values.
+    */
     template<typename Key, typename Data>
     struct Leaf : LinkedNode<Key, Data> {
         std::size_t recordCount;
-        // has to be last member for dynamic operator new() !!!
-        KeyValue<Key, Data> records[];
 
-        static Leaf<Key, Data> *create(std::size_t size, const PID &prev, const PID &next) {
-            size_t s = sizeof(Leaf<Key, Data>) + size * sizeof(std::tuple<Key, const Data *>);
-            Leaf<Key, Data> *output = (Leaf<Key, Data> *) operator new(s);
+        static std::size_t allocationSize(std::size_t size, std::size_t keyBytes = 0) {
+            return keyAreaOffset(size) + keyBytes;
+        }
+
+        Key *keys() {
+            return reinterpret_cast<Key *>(reinterpret_cast<char *>(this) + cacheLineAligned(sizeof(Leaf<Key, Data>)));
+        }
+
+        const Key *keys() const {
+            return const_cast<Leaf<Key, Data> *>(this)->keys();
+        }
+
+        ValueStorage<Data> *values() {
+            return reinterpret_cast<ValueStorage<Data> *>(reinterpret_cast<char *>(this) + valuesOffset(recordCount));
+        }
+
+        const ValueStorage<Data> *values() const {
+            return const_cast<Leaf<Key, Data> *>(this)->values();
+        }
+
+        unsigned char *keyArea() {
+            return reinterpret_cast<unsigned char *>(this) + keyAreaOffset(recordCount);
+        }
+
+        KeyValue<Key, Data> record(std::size_t i) const {
+            return KeyValue<Key, Data>(keys()[i], values()[i]);
+        }
+
+        const Data *data(std::size_t i) const {
+            return values()[i].get();
+        }
+
+        template<typename Allocation = NodeAllocation>
+        static Leaf<Key, Data> *create(std::size_t size, const PID &prev, const PID &next, std::size_t keyBytes = 0, Allocation allocation = Allocation()) {
+            Leaf<Key, Data> *output = (Leaf<Key, Data> *) allocation(allocationSize(size, keyBytes));
+            // the allocator aligns objects of at least one cache line to the cache line size
+            assert(reinterpret_cast<std::uintptr_t>(output) % NodeAllocator::alignment == 0);
             output->recordCount = size;
             output->type = PageType::leaf;
+            output->setLSN(0);
+            output->mapped = false;
+            output->prefixLength = 0;
+            output->keyBytes = static_cast<std::uint32_t>(keyBytes);
             output->next = next;
             output->prev = prev;
             return output;
         }
 
     private:
+        static std::size_t valuesOffset(std::size_t size) {
+            return cacheLineAligned(sizeof(Leaf<Key, Data>)) + cacheLineAligned(size * sizeof(Key));
+        }
+
+        static std::size_t keyAreaOffset(std::size_t size) {
+            return valuesOffset(size) + size * sizeof(ValueStorage<Data>);
+        }
+
         Leaf() = delete;
 
         ~Leaf() = delete;
@@ -82,23 +250,83 @@ namespace BwTree {
         KeyPid(const Key key, const PID pid) : key(key), pid(pid) { }
     };
 
+    /**
+    * The header is followed by the array of all separator keys and the array of all children, both start on a cache line.
+    * The bytes of variable length keys are stored in the key area behind the children.
+    */
     template<typename Key, typename Data>
     struct InnerNode : LinkedNode<Key, Data> {
         std::size_t nodeCount;
-        // has to be last member for dynamic operator new() !!!
-        KeyPid<Key, Data> nodes[];
 
-        static InnerNode<Key, Data> *create(std::size_t size, const PID &prev, const PID &next) {
-            size_t s = sizeof(InnerNode<Key, Data>) + size * sizeof(std::tuple<Key, PID>);
-            InnerNode<Key, Data> *output = (InnerNode<Key, Data> *) operator new(s);
+        static std::size_t allocationSize(std::size_t size, std::size_t keyBytes = 0) {
+            return keyAreaOffset(size) + keyBytes;
+        }
+
+        Key *keys() {
+            return reinterpret_cast<Key *>(reinterpret_cast<char *>(this) + cacheLineAligned(sizeof(InnerNode<Key, Data>)));
+        }
+
+        const Key *keys() const {
+            return const_cast<InnerNode<Key, Data> *>(this)->keys();
+        }
+
+        PID *children() {
+            return reinterpret_cast<PID *>(reinterpret_cast<char *>(this) + childrenOffset(nodeCount));
+        }
+
+        const PID *children() const {
+            return const_cast<InnerNode<Key, Data> *>(this)->children();
+        }
+
+        unsigned char *keyArea() {
+            return reinterpret_cast<unsigned char *>(this) + keyAreaOffset(nodeCount);
+        }
+
+        KeyPid<Key, Data> node(std::size_t i) const {
+            return KeyPid<Key, Data>(keys()[i], children()[i]);
+        }
+
+        /**
+        * the key is not copied into the key area, only for keys without bytes like the one of the infinity element
+        */
+        void setNode(std::size_t i, const KeyPid<Key, Data> &node) {
+            keys()[i] = node.key;
+            children()[i] = node.pid;
+        }
+
+        template<typename Allocation = NodeAllocation>
+        static InnerNode<Key, Data> *create(std::size_t size, const PID &prev, const PID &next, std::size_t keyBytes = 0, Allocation allocation = Allocation()) {
+            InnerNode<Key, Data> *output = (InnerNode<Key, Data> *) allocation(allocationSize(size, keyBytes));
+            // the allocator aligns objects of at least one cache line to the cache line size
+            assert(reinterpret_cast<std::uintptr_t>(output) % NodeAllocator::alignment == 0);
             output->nodeCount = size;
             output->type = PageType::inner;
+            output->setLSN(0);
+            output->mapped = false;
+            output->prefixLength = 0;
+            output->keyBytes = static_cast<std::uint32_t>(keyBytes);
             output->next = next;
             output->prev = prev;
             return output;
         }
 
+        /**
+        * The last entry of the rightmost node of a level is the infinity element, its key is meaningless.
+        * Returns the number of entries with a separator key.
+        */
+        std::size_t separatorCount() const {
+            return this->next == NotExistantPID ? nodeCount - 1 : nodeCount;
+        }
+
     private:
+        static std::size_t childrenOffset(std::size_t size) {
+            return cacheLineAligned(sizeof(InnerNode<Key, Data>)) + cacheLineAligned(size * sizeof(Key));
+        }
+
+        static std::size_t keyAreaOffset(std::size_t size) {
+            return childrenOffset(size) + size * sizeof(PID);
+        }
+
         InnerNode() = delete;
 
         ~InnerNode() = delete;
@@ -113,18 +341,103 @@ namespace BwTree {
         ~DeltaNode() = delete;
     };
 
+    /**
+    * Covers a run of record deltas (inserts, insert batches and deletes) from one delta down to the next split delta or the leaf.
+    * A key outside of [minKey, maxKey] or without all of its bits in filter is in none of the deltas of the run.
+    */
     template<typename Key, typename Data>
-    struct DeltaInsert : DeltaNode<Key, Data> {
+    struct DeltaSummary {
+        Key minKey;
+        Key maxKey;
+        std::uint64_t filter;
+        // first node below the run
+        Node<Key, Data> *base;
+        std::uint32_t depth;
+        // change of the record count by the run, every insert counts as a new record
+        long recordCount;
+
+        static std::uint64_t filterBits(const Key &key) {
+            const std::uint64_t hash = KeyTraits<Key>::hash(key);
+            return (std::uint64_t(1) << (hash >> 58)) | (std::uint64_t(1) << ((hash >> 52) & 63));
+        }
+
+        // bits is filterBits(key), computed once by the caller for all summaries of a walk
+        bool mayContain(const Key &key, std::uint64_t bits) const {
+            if (key < minKey || maxKey < key) {
+                return false;
+            }
+            return (filter & bits) == bits;
+        }
+    };
+
+    template<typename Key, typename Data>
+    struct RecordDelta : DeltaNode<Key, Data> {
+        DeltaSummary<Key, Data> summary;
+
+        static bool isRecordDelta(const Node<Key, Data> *node) {
+            switch (node->getType()) {
+                case PageType::deltaInsert: /* fallthrough */
+                case PageType::deltaInsertBatch: /* fallthrough */
+                case PageType::deltaDelete:
+                    return true;
+                default:
+                    return false;
+            }
+        }
+
+    protected:
+        /**
+        * extends the summary of origin if it is a record delta, otherwise starts a new run
+        */
+        void initSummary(const Key &minKey, const Key &maxKey, std::uint64_t filter, long recordCount) {
+            summary.minKey = minKey;
+            summary.maxKey = maxKey;
+            summary.filter = filter;
+            summary.base = this->origin;
+            summary.depth = 1;
+            summary.recordCount = recordCount;
+            if (isRecordDelta(this->origin)) {
+                const DeltaSummary<Key, Data> &below = static_cast<RecordDelta<Key, Data> *>(this->origin)->summary;
+                if (below.minKey < minKey) {
+                    summary.minKey = below.minKey;
+                }
+                if (maxKey < below.maxKey) {
+                    summary.maxKey = below.maxKey;
+                }
+                summary.filter |= below.filter;
+                summary.base = below.base;
+                summary.depth += below.depth;
+                summary.recordCount += below.recordCount;
+            }
+        }
+
+    private:
+        RecordDelta() = delete;
+
+        ~RecordDelta() = delete;
+    };
+
+    /**
+    * The bytes of a variable length key follow the delta.
+    */
+    template<typename Key, typename Data>
+    struct DeltaInsert : RecordDelta<Key, Data> {
         KeyValue<Key, Data> record;
         bool keyExistedBefore;
 
+        static std::size_t allocationSize(const Key &key) {
+            return sizeof(DeltaInsert<Key, Data>) + KeyTraits<Key>::storedSize(key, 0);
+        }
+
         static DeltaInsert<Key, Data> *create(Node<Key, Data> *origin, const KeyValue<Key, Data> record, bool keyExistedBefore) {
-            size_t s = sizeof(DeltaInsert<Key, Data>);
-            DeltaInsert<Key, Data> *output = (DeltaInsert<Key, Data> *) operator new(s);
+            DeltaInsert<Key, Data> *output = (DeltaInsert<Key, Data> *) NodeAllocator::allocate(allocationSize(record.key));
             output->type = PageType::deltaInsert;
             output->origin = origin;
-            output->record = record;
+            output->setLSN(origin->getLSN());
+            unsigned char *keyArea = reinterpret_cast<unsigned char *>(output + 1);
+            output->record = KeyValue<Key, Data>(KeyTraits<Key>::store(record.key, nullptr, 0, keyArea), record.value);
             output->keyExistedBefore = keyExistedBefore;
+            output->initSummary(output->record.key, output->record.key, DeltaSummary<Key, Data>::filterBits(record.key), 1);
             return output;
         }
 
@@ -135,16 +448,73 @@ namespace BwTree {
 
     };
 
+    /**
+    * inserts or updates several records of one leaf at once, the records are sorted and their keys are unique.
+    * The bytes of variable length keys follow the records.
+    */
+    template<typename Key, typename Data>
+    struct DeltaInsertBatch : RecordDelta<Key, Data> {
+        std::size_t recordCount;
+        std::size_t keyBytes;
+        // has to be last member for the dynamic allocation in create() !!!
+        KeyValue<Key, Data> records[];
+
+        static std::size_t allocationSize(std::size_t size, std::size_t keyBytes) {
+            return sizeof(DeltaInsertBatch<Key, Data>) + size * sizeof(KeyValue<Key, Data>) + keyBytes;
+        }
+
+        /**
+        * copies the records [begin, end), which have to be sorted by unique keys
+        */
+        template<typename Iterator>
+        static DeltaInsertBatch<Key, Data> *create(Node<Key, Data> *origin, Iterator begin, Iterator end) {
+            std::size_t keyBytes = 0;
+            for (auto it = begin; it != end; ++it) {
+                keyBytes += KeyTraits<Key>::storedSize(it->key, 0);
+            }
+            const std::size_t size = std::distance(begin, end);
+            assert(size > 0);
+            DeltaInsertBatch<Key, Data> *output = (DeltaInsertBatch<Key, Data> *) NodeAllocator::allocate(allocationSize(size, keyBytes));
+            output->type = PageType::deltaInsertBatch;
+            output->origin = origin;
+            output->setLSN(origin->getLSN());
+            output->recordCount = size;
+            output->keyBytes = keyBytes;
+            unsigned char *keyArea = reinterpret_cast<unsigned char *>(output->records + size);
+            std::uint64_t filter = 0;
+            for (std::size_t i = 0; i < size; ++i, ++begin) {
+                new(&output->records[i]) KeyValue<Key, Data>(KeyTraits<Key>::store(begin->key, nullptr, 0, keyArea), begin->value);
+                filter |= DeltaSummary<Key, Data>::filterBits(output->records[i].key);
+            }
+            output->initSummary(output->records[0].key, output->records[size - 1].key, filter, static_cast<long>(size));
+            return output;
+        }
+
+    private:
+        DeltaInsertBatch() = delete;
+
+        ~DeltaInsertBatch() = delete;
+    };
+
+    /**
+    * The bytes of a variable length key follow the delta.
+    */
     template<typename Key, typename Data>
-    struct DeltaDelete : DeltaNode<Key, Data> {
+    struct DeltaDelete : RecordDelta<Key, Data> {
         Key key;
 
+        static std::size_t allocationSize(const Key &key) {
+            return sizeof(DeltaDelete<Key, Data>) + KeyTraits<Key>::storedSize(key, 0);
+        }
+
         static DeltaDelete<Key, Data> *create(Node<Key, Data> *origin, Key key) {
-            size_t s = sizeof(DeltaDelete<Key, Data>);
-            DeltaDelete<Key, Data> *output = (DeltaDelete<Key, Data> *) operator new(s);
+            DeltaDelete<Key, Data> *output = (DeltaDelete<Key, Data> *) NodeAllocator::allocate(allocationSize(key));
             output->type = PageType::deltaDelete;
             output->origin = origin;
-            output->key = key;
+            output->setLSN(origin->getLSN());
+            unsigned char *keyArea = reinterpret_cast<unsigned char *>(output + 1);
+            output->key = KeyTraits<Key>::store(key, nullptr, 0, keyArea);
+            output->initSummary(output->key, output->key, DeltaSummary<Key, Data>::filterBits(key), -1);
             return output;
         }
 
@@ -154,22 +524,30 @@ namespace BwTree {
         ~DeltaDelete() = delete;
     };
 
+    /**
+    * The bytes of a variable length key follow the delta.
+    */
     template<typename Key, typename Data>
     struct DeltaSplit : DeltaNode<Key, Data> {
         Key key;
         PID sidelink;
         std::size_t removedElements;
 
+        static std::size_t allocationSize(const Key &splitKey) {
+            return sizeof(DeltaSplit<Key, Data>) + KeyTraits<Key>::storedSize(splitKey, 0);
+        }
+
         static DeltaSplit<Key, Data> *create(Node<Key, Data> *origin, Key splitKey, PID sidelink, std::size_t removedElements, bool leaf) {
-            size_t s = sizeof(DeltaSplit<Key, Data>);
-            DeltaSplit<Key, Data> *output = (DeltaSplit<Key, Data> *) operator new(s);
+            DeltaSplit<Key, Data> *output = (DeltaSplit<Key, Data> *) NodeAllocator::allocate(allocationSize(splitKey));
             if (leaf) {
                 output->type = PageType::deltaSplit;
             } else {
                 output->type = PageType::deltaSplitInner;
             }
             output->origin = origin;
-            output->key = splitKey;
+            output->setLSN(origin->getLSN());
+            unsigned char *keyArea = reinterpret_cast<unsigned char *>(output + 1);
+            output->key = KeyTraits<Key>::store(splitKey, nullptr, 0, keyArea);
             output->sidelink = sidelink;
             output->removedElements = removedElements;
 
@@ -182,20 +560,30 @@ namespace BwTree {
         ~DeltaSplit() = delete;
     };
 
+    /**
+    * The bytes of variable length keys follow the delta.
+    */
     template<typename Key, typename Data>
     struct DeltaIndex : DeltaNode<Key, Data> {
         Key keyLeft; // greater than
         Key keyRight; // less or equal than
+        bool keyRightInfinity; // child is the infinity element of the level, keyRight is meaningless
         PID child;
         PID oldChild;
 
-        static DeltaIndex<Key, Data> *create(Node<Key, Data> *origin, Key splitKeyLeft, Key splitKeyRight, PID child, PID oldChild) {
-            size_t s = sizeof(DeltaIndex<Key, Data>);
-            DeltaIndex<Key, Data> *output = (DeltaIndex<Key, Data> *) operator new(s);
+        static std::size_t allocationSize(const Key &keyLeft, const Key &keyRight) {
+            return sizeof(DeltaIndex<Key, Data>) + KeyTraits<Key>::storedSize(keyLeft, 0) + KeyTraits<Key>::storedSize(keyRight, 0);
+        }
+
+        static DeltaIndex<Key, Data> *create(Node<Key, Data> *origin, Key splitKeyLeft, Key splitKeyRight, bool keyRightInfinity, PID child, PID oldChild) {
+            DeltaIndex<Key, Data> *output = (DeltaIndex<Key, Data> *) NodeAllocator::allocate(allocationSize(splitKeyLeft, splitKeyRight));
             output->type = PageType::deltaIndex;
             output->origin = origin;
-            output->keyLeft = splitKeyLeft;
-            output->keyRight = splitKeyRight;
+            output->setLSN(origin->getLSN());
+            unsigned char *keyArea = reinterpret_cast<unsigned char *>(output + 1);
+            output->keyLeft = KeyTraits<Key>::store(splitKeyLeft, nullptr, 0, keyArea);
+            output->keyRight = KeyTraits<Key>::store(splitKeyRight, nullptr, 0, keyArea);
+            output->keyRightInfinity = keyRightInfinity;
             output->child = child;
             output->oldChild = oldChild;
             return output;
@@ -218,42 +606,154 @@ namespace BwTree {
     public:
         typedef typename std::vector<KeyPid<Key, Data>>::iterator InnerIterator;
 
-        static InnerNode<Key, Data> *CreateInnerNodeFromUnsorted(InnerIterator begin, InnerIterator end, const PID &prev, const PID &next, bool infinityElement) {
-            // construct a new node
-            auto newNode = InnerNode<Key, Data>::create(std::distance(begin, end), prev, next);
+        /**
+        * infinityChild is appended as the infinity element, without it the largest entry of a node without next becomes the infinity element
+        */
+        static InnerNode<Key, Data> *CreateInnerNodeFromUnsorted(InnerIterator begin, InnerIterator end, const PID &prev, const PID &next, PID infinityChild) {
             std::sort(begin, end, [](const KeyPid<Key, Data> &t1, const KeyPid<Key, Data> &t2) {
                 return t1.key < t2.key;
             });
-            int i = 0;
+            return CreateInnerNodeFromSorted(begin, end, prev, next, infinityChild);
+        }
+
+        template<typename Iterator, typename Allocation = NodeAllocation>
+        static InnerNode<Key, Data> *CreateInnerNodeFromSorted(Iterator begin, Iterator end, const PID &prev, const PID &next, PID infinityChild,
+                                                               Allocation allocation = Allocation()) {
+            assert(infinityChild == NotExistantPID || next == NotExistantPID);
+            const std::size_t count = std::distance(begin, end);
+            const std::size_t nodeCount = count + (infinityChild != NotExistantPID ? 1 : 0);
+            // the key of the infinity element is meaningless and does not share the prefix
+            const std::size_t separatorCount = next == NotExistantPID && nodeCount > 0 ? nodeCount - 1 : nodeCount;
+            std::uint32_t prefixLength;
+            const std::size_t keyBytes = keyAreaSize(begin, count, std::min(separatorCount, count), prefixLength);
+            auto newNode = InnerNode<Key, Data>::create(nodeCount, prev, next, keyBytes, allocation);
+            newNode->prefixLength = prefixLength;
+            storeKeys(newNode->keys(), newNode->keyArea(), begin, count, std::min(separatorCount, count), prefixLength);
+            std::size_t i = 0;
             for (auto it = begin; it != end; ++it) {
-                newNode->nodes[i++] = *it;
+                newNode->children()[i++] = it->pid;
             }
-            if (infinityElement) {
-                newNode->nodes[newNode->nodeCount - 1].key = std::numeric_limits<Key>::max();
+            if (infinityChild != NotExistantPID) {
+                newNode->setNode(i, KeyPid<Key, Data>(Key(), infinityChild));
             }
             return newNode;
         }
 
         typedef typename std::vector<KeyValue<Key, Data>>::iterator LeafIterator;
 
-        static Leaf<Key, Data> *CreateLeafNodeFromSorted(LeafIterator begin, LeafIterator end, const PID &prev,
-                                                         const PID &next) {
-            // construct a new node
-            auto newNode = Leaf<Key, Data>::create(std::distance(begin, end), prev, next);
-            int i = 0;
+        template<typename Iterator, typename Allocation = NodeAllocation>
+        static Leaf<Key, Data> *CreateLeafNodeFromSorted(Iterator begin, Iterator end, const PID &prev,
+                                                         const PID &next, Allocation allocation = Allocation()) {
+            const std::size_t count = std::distance(begin, end);
+            std::uint32_t prefixLength;
+            const std::size_t keyBytes = keyAreaSize(begin, count, count, prefixLength);
+            auto newNode = Leaf<Key, Data>::create(count, prev, next, keyBytes, allocation);
+            newNode->prefixLength = prefixLength;
+            storeKeys(newNode->keys(), newNode->keyArea(), begin, count, count, prefixLength);
+            std::size_t i = 0;
             for (auto it = begin; it != end; ++it) {
-                newNode->records[i++] = *it;
+                newNode->values()[i++] = it->value;
             }
             return newNode;
         }
+
+    private:
+        /**
+        * size of the key area for the keys of the entries [begin, begin + count), the first separatorCount of them share the
+        * prefix of the node which is stored once at the start of the area
+        */
+        template<typename Iterator>
+        static std::size_t keyAreaSize(Iterator begin, std::size_t count, std::size_t separatorCount, std::uint32_t &prefixLength) {
+            prefixLength = separatorCount > 1 ? KeyTraits<Key>::commonPrefixLength(begin->key, (begin + (separatorCount - 1))->key) : 0;
+            std::size_t size = prefixLength;
+            std::size_t i = 0;
+            for (auto it = begin; i < count; ++it, ++i) {
+                size += KeyTraits<Key>::storedSize(it->key, i < separatorCount ? prefixLength : 0);
+            }
+            return size;
+        }
+
+        template<typename Iterator>
+        static void storeKeys(Key *keys, unsigned char *area, Iterator begin, std::size_t count, std::size_t separatorCount, std::uint32_t prefixLength) {
+            const unsigned char *prefix = area;
+            if (count > 0) {
+                KeyTraits<Key>::storePrefix(begin->key, prefixLength, area);
+            }
+            area += prefixLength;
+            std::size_t i = 0;
+            for (auto it = begin; i < count; ++it, ++i) {
+                keys[i] = i < separatorCount ? KeyTraits<Key>::store(it->key, prefix, prefixLength, area)
+                                             : KeyTraits<Key>::store(it->key, nullptr, 0, area);
+            }
+        }
     };
 
     template<typename Key, typename Data>
     void freeNodeRecursively(Node<Key, Data> *node);
 
+    /**
+    * size of the allocation backing the node, the allocator needs it to find the size class
+    */
+    template<typename Key, typename Data>
+    std::size_t nodeSize(Node<Key, Data> *node) {
+        switch (node->getType()) {
+            case PageType::leaf: {
+                auto leaf = static_cast<Leaf<Key, Data> *>(node);
+                return Leaf<Key, Data>::allocationSize(leaf->recordCount, leaf->keyBytes);
+            }
+            case PageType::inner: {
+                auto inner = static_cast<InnerNode<Key, Data> *>(node);
+                return InnerNode<Key, Data>::allocationSize(inner->nodeCount, inner->keyBytes);
+            }
+            case PageType::deltaInsert:
+                return DeltaInsert<Key, Data>::allocationSize(static_cast<DeltaInsert<Key, Data> *>(node)->record.key);
+            case PageType::deltaInsertBatch: {
+                auto batch = static_cast<DeltaInsertBatch<Key, Data> *>(node);
+                return DeltaInsertBatch<Key, Data>::allocationSize(batch->recordCount, batch->keyBytes);
+            }
+            case PageType::deltaDelete:
+                return DeltaDelete<Key, Data>::allocationSize(static_cast<DeltaDelete<Key, Data> *>(node)->key);
+            case PageType::deltaIndex: {
+                auto index = static_cast<DeltaIndex<Key, Data> *>(node);
+                return DeltaIndex<Key, Data>::allocationSize(index->keyLeft, index->keyRight);
+            }
+            case PageType::deltaSplit: /* fallthrough */
+            case PageType::deltaSplitInner:
+                return DeltaSplit<Key, Data>::allocationSize(static_cast<DeltaSplit<Key, Data> *>(node)->key);
+        }
+        assert(false);//all nodes have to be handeled
+        return 0;
+    }
+
+    template<typename Key, typename Data>
+    bool isMapped(const Node<Key, Data> *node) {
+        return (node->getType() == PageType::leaf || node->getType() == PageType::inner) && static_cast<const LinkedNode<Key, Data> *>(node)->mapped;
+    }
+
+    /**
+    * bytes freed by freeNodeRecursively(node), the node and all nodes below it in its delta chain
+    */
+    template<typename Key, typename Data>
+    std::size_t chainSize(Node<Key, Data> *node) {
+        std::size_t size = 0;
+        while (node != nullptr) {
+            if (!isMapped(node)) {
+                size += nodeSize(node);
+            }
+            if (node->getType() == PageType::leaf || node->getType() == PageType::inner) {
+                break;
+            }
+            node = static_cast<DeltaNode<Key, Data> *>(node)->origin;
+        }
+        return size;
+    }
+
     template<typename Key, typename Data>
     void freeNodeSingle(Node<Key, Data> *node) {
-        operator delete(node);
+        if (isMapped(node)) {
+            return;
+        }
+        NodeAllocator::deallocate(node, nodeSize(node));
     }
 
     template<typename Key, typename Data>
@@ -269,6 +769,7 @@ namespace BwTree {
                 case PageType::deltaDelete: /* fallthrough */
                 case PageType::deltaSplitInner: /* fallthrough */
                 case PageType::deltaSplit: /* fallthrough */
+                case PageType::deltaInsertBatch: /* fallthrough */
                 case PageType::deltaInsert: {
                     auto node1 = static_cast<DeltaNode<Key, Data> *>(node);
                     node = node1->origin;
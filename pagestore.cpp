@@ -0,0 +1,147 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <system_error>
+#include "pagestore.hpp"
+#include "allocator.hpp"
+#include "fileio.hpp"
+
+namespace BwTree {
+
+    constexpr std::uint64_t PageStore::segmentSize;
+    constexpr std::chrono::milliseconds PageStore::sweepInterval;
+
+    PageStore::PageStore(const std::string &path) : path(path) {
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            throw std::system_error(errno, std::generic_category(), "BwTree::PageStore " + path);
+        }
+    }
+
+    PageStore::~PageStore() {
+        ::close(fd);
+        ::unlink(path.c_str());
+    }
+
+    std::size_t PageStore::maxPageSize() {
+        return segmentSize - sizeof(PageHeader);
+    }
+
+    std::size_t PageStore::recordSize(std::size_t pageSize) {
+        return (sizeof(PageHeader) + pageSize + NodeAllocator::alignment - 1) & ~(NodeAllocator::alignment - 1);
+    }
+
+    std::uint32_t PageStore::checksum(const PageHeader &header, const void *page) {
+        std::uint32_t crc = crc32c(&header.pid, sizeof(header.pid));
+        crc = crc32c(&header.size, sizeof(header.size), crc);
+        return crc32c(page, header.size, crc);
+    }
+
+    std::uintptr_t PageStore::stage(std::uint64_t pid, const void *page, std::size_t size) {
+        const std::size_t record = recordSize(size);
+        if (segmentFull || head / segmentSize != (head + record - 1) / segmentSize) {
+            segmentFull = true;
+            return 0;
+        }
+        PageHeader header;
+        header.pid = pid;
+        header.size = static_cast<std::uint32_t>(size);
+        header.checksum = checksum(header, page);
+        const std::size_t offset = staged.size();
+        staged.resize(offset + record);
+        std::memcpy(staged.data() + offset, &header, sizeof(header));
+        std::memcpy(staged.data() + offset + sizeof(header), page, size);
+        std::memset(staged.data() + offset + sizeof(header) + size, 0, record - sizeof(header) - size);
+        const std::uint64_t position = head;
+        head += record;
+        return static_cast<std::uintptr_t>(position) | 1;
+    }
+
+    void PageStore::writeStaged() {
+        writeAll(fd, staged.data(), staged.size(), stagedStart, "BwTree::PageStore " + path);
+        staged.clear();
+        if (segmentFull) {
+            // the rest of the segment stays a hole
+            head = (head + segmentSize - 1) / segmentSize * segmentSize;
+            segmentFull = false;
+        }
+        stagedStart = head;
+    }
+
+    void *PageStore::read(std::uintptr_t reference, std::uint64_t pid, std::size_t &size) {
+        const off_t offset = reference & ~static_cast<std::uintptr_t>(1);
+        PageHeader header;
+        int error;
+        if (!readAll(fd, &header, sizeof(header), offset, error)) {
+            if (error != 0) {
+                throw std::system_error(error, std::generic_category(), "BwTree::PageStore " + path);
+            }
+            return nullptr;
+        }
+        // a hole reads as zeros, size 0 is no page
+        if (header.pid != pid || header.size == 0 || header.size > maxPageSize()) {
+            return nullptr;
+        }
+        void *page = NodeAllocator::allocate(header.size);
+        if (!readAll(fd, page, header.size, offset + sizeof(header), error)) {
+            NodeAllocator::deallocate(page, header.size);
+            if (error != 0) {
+                throw std::system_error(error, std::generic_category(), "BwTree::PageStore " + path);
+            }
+            return nullptr;
+        }
+        // the segment was cleaned while the page was read
+        if (checksum(header, page) != header.checksum) {
+            NodeAllocator::deallocate(page, header.size);
+            return nullptr;
+        }
+        size = header.size;
+        return page;
+    }
+
+    bool PageStore::forEachPageOfOldestSegment(const Consumer &consumer) {
+        if (tailSegment == head / segmentSize) {
+            return false;
+        }
+        // the oldest segment is not the head segment anymore, all of its pages are written
+        segment.assign(segmentSize, 0);
+        const off_t segmentOffset = tailSegment * segmentSize;
+        std::size_t length = 0;
+        while (length < segmentSize) {
+            const ssize_t bytes = ::pread(fd, segment.data() + length, segmentSize - length, segmentOffset + length);
+            if (bytes < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw std::system_error(errno, std::generic_category(), "BwTree::PageStore " + path);
+            }
+            if (bytes == 0) {
+                break;
+            }
+            length += bytes;
+        }
+        std::size_t offset = 0;
+        while (offset + sizeof(PageHeader) <= length) {
+            PageHeader header;
+            std::memcpy(&header, segment.data() + offset, sizeof(header));
+            if (header.size == 0 || offset + sizeof(header) + header.size > length) {
+                break;
+            }
+            const char *page = segment.data() + offset + sizeof(header);
+            if (checksum(header, page) == header.checksum) {
+                consumer(header.pid, static_cast<std::uintptr_t>(segmentOffset + offset) | 1, page, header.size);
+            }
+            offset += recordSize(header.size);
+        }
+        return true;
+    }
+
+    void PageStore::releaseOldestSegment() {
+#ifdef FALLOC_FL_PUNCH_HOLE
+        // without hole punching, e.g. on file systems which do not support it, the space stays allocated
+        ::fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, tailSegment * segmentSize, segmentSize);
+#endif
+        ++tailSegment;
+    }
+}
@@ -0,0 +1,115 @@
+#ifndef PAGESTORE_HPP
+#define PAGESTORE_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace BwTree {
+
+    /**
+    * Log structured file of the pages evicted from memory.
+    *
+    * Pages are appended at the head of the file, which is divided into segments of segmentSize bytes. Every page starts
+    * on a cache line with a header holding its PID, size and checksum, no page crosses a segment boundary.
+    * The mapping table entry of an evicted page holds its reference: the file offset with the lowest bit set, which node
+    * pointers, being cache line aligned, never have.
+    *
+    * Offsets are never reused. Cleaning relocates the live pages of the oldest segment to the head and punches a hole
+    * into the file where the segment was, so a reader which still holds an outdated reference reads a hole or a page
+    * whose reference is no longer in the mapping table, and retries. The file is scratch space of a running tree,
+    * it is created empty and removed on destruction.
+    *
+    * Staging, writing and cleaning are done by one thread at a time, reading by any thread.
+    */
+    class PageStore {
+    public:
+        static constexpr std::uint64_t segmentSize = 8 * 1024 * 1024;
+        // the evictor looks at least this often whether the tree exceeds its memory budget
+        static constexpr std::chrono::milliseconds sweepInterval{10};
+
+        using Consumer = std::function<void(std::uint64_t pid, std::uintptr_t reference, const char *page, std::size_t size)>;
+
+        /**
+        * creates or truncates the file at path, throws std::system_error on I/O errors
+        */
+        PageStore(const std::string &path);
+
+        PageStore(const PageStore &) = delete;
+
+        PageStore &operator=(const PageStore &) = delete;
+
+        ~PageStore();
+
+        static bool isReference(const void *entry) {
+            return (reinterpret_cast<std::uintptr_t>(entry) & 1) != 0;
+        }
+
+        /**
+        * largest page which can be stored
+        */
+        static std::size_t maxPageSize();
+
+        /**
+        * Copies the page into the write buffer and returns its reference, which can be read once writeStaged returned.
+        * Returns 0 if the page does not fit into the current segment anymore, writeStaged moves on to the next one.
+        */
+        std::uintptr_t stage(std::uint64_t pid, const void *page, std::size_t size);
+
+        /**
+        * writes the staged pages, throws std::system_error on I/O errors
+        */
+        void writeStaged();
+
+        /**
+        * Reads the page of pid at reference into memory of the NodeAllocator and sets size to its allocation size.
+        * Returns nullptr if the page is no longer there, throws std::system_error on I/O errors.
+        */
+        void *read(std::uintptr_t reference, std::uint64_t pid, std::size_t &size);
+
+        /**
+        * bytes from the oldest segment to the head, including the pages which are no longer live
+        */
+        std::uint64_t usedBytes() const {
+            return head - tailSegment * segmentSize;
+        }
+
+        /**
+        * passes every page of the oldest segment to consumer, returns false if the oldest segment is the head segment
+        */
+        bool forEachPageOfOldestSegment(const Consumer &consumer);
+
+        /**
+        * removes the oldest segment from the file, its live pages have to be relocated before
+        */
+        void releaseOldestSegment();
+
+    private:
+        struct PageHeader {
+            std::uint64_t pid;
+            std::uint32_t size;
+            // of pid, size and the page
+            std::uint32_t checksum;
+        };
+
+        const std::string path;
+        int fd;
+        std::uint64_t tailSegment = 0;
+        // offset of the next page
+        std::uint64_t head = 0;
+        // offset of the first staged page
+        std::uint64_t stagedStart = 0;
+        std::vector<char> staged;
+        bool segmentFull = false;
+        std::vector<char> segment;
+
+        static std::size_t recordSize(std::size_t pageSize);
+
+        static std::uint32_t checksum(const PageHeader &header, const void *page);
+    };
+}
+
+#endif
@@ -0,0 +1,131 @@
+#ifndef SEARCH_HPP
+#define SEARCH_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace BwTree {
+
+    /**
+    * lower_bound on a sorted array of keys, less compares two keys.
+    */
+    template<typename Key, typename Less>
+    std::size_t lowerBoundScalar(const Key *keys, std::size_t length, const Key &key, Less less) {
+        //std cpp code lower_bound
+        std::size_t first = 0;
+        std::size_t i;
+        std::size_t count, step;
+        count = length;
+        while (count > 0) {
+            i = first;
+            step = count / 2;
+            i += step;
+            if (less(keys[i], key)) {
+                first = ++i;
+                count -= step + 1;
+            } else {
+                count = step;
+            }
+        }
+        return first;
+    }
+
+    /**
+    * lower_bound on a sorted array of fixed length keys.
+    *
+    * A branchless binary search narrows the array down to linearSearchBytes, the keys in the remaining range are
+    * counted linearly. For unsigned 32 and 64 bit keys the linear part compares whole AVX-512 or AVX2 vectors of keys,
+    * the instruction set is chosen by the compiler flags.
+    */
+    template<typename Key>
+    class SearchKernel {
+#if defined(__AVX512F__)
+        static constexpr std::size_t vectorBytes = 64;
+#elif defined(__AVX2__)
+        static constexpr std::size_t vectorBytes = 32;
+#else
+        static constexpr std::size_t vectorBytes = 0;
+#endif
+        static constexpr std::size_t linearSearchBytes = 256;
+        // only cheap comparisons are worth a linear search
+        static constexpr std::size_t linearSearchKeys = std::is_arithmetic<Key>::value ? linearSearchBytes / sizeof(Key) : 1;
+
+    public:
+        static constexpr bool vectorized = vectorBytes > 0 && std::is_integral<Key>::value && std::is_unsigned<Key>::value
+                && (sizeof(Key) == 4 || sizeof(Key) == 8);
+
+        static std::size_t lowerBound(const Key *keys, std::size_t length, const Key &key) {
+            const Key *base = keys;
+            std::size_t n = length;
+            while (n > linearSearchKeys) {
+                const std::size_t half = n / 2;
+                base = base[half] < key ? base + half : base;
+                n -= half;
+            }
+            return static_cast<std::size_t>(base - keys) + countLess(base, n, key, std::integral_constant<bool, vectorized>());
+        }
+
+        static const char *name() {
+            if (!vectorized) {
+                return "branchless";
+            }
+            return vectorBytes == 64 ? "avx512" : "avx2";
+        }
+
+    private:
+        static std::size_t countLess(const Key *keys, std::size_t count, const Key &key, std::false_type) {
+            std::size_t less = 0;
+            for (std::size_t i = 0; i < count; ++i) {
+                less += keys[i] < key;
+            }
+            return less;
+        }
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+        static std::size_t countLess(const Key *keys, std::size_t count, const Key &key, std::true_type) {
+            constexpr std::size_t keysPerVector = vectorBytes / sizeof(Key);
+            std::size_t less = 0;
+            std::size_t i = 0;
+            for (; i + keysPerVector <= count; i += keysPerVector) {
+                less += __builtin_popcountll(lessMask(keys + i, key, std::integral_constant<std::size_t, sizeof(Key)>()));
+            }
+            for (; i < count; ++i) {
+                less += keys[i] < key;
+            }
+            return less;
+        }
+
+#if defined(__AVX512F__)
+        static std::uint64_t lessMask(const Key *keys, const Key &key, std::integral_constant<std::size_t, 8>) {
+            return _mm512_cmplt_epu64_mask(_mm512_loadu_si512(keys), _mm512_set1_epi64(static_cast<long long>(key)));
+        }
+
+        static std::uint64_t lessMask(const Key *keys, const Key &key, std::integral_constant<std::size_t, 4>) {
+            return _mm512_cmplt_epu32_mask(_mm512_loadu_si512(keys), _mm512_set1_epi32(static_cast<int>(key)));
+        }
+#else
+        // AVX2 only compares signed integers, flipping the sign bit of both sides gives the unsigned order
+        static std::uint64_t lessMask(const Key *keys, const Key &key, std::integral_constant<std::size_t, 8>) {
+            const __m256i sign = _mm256_set1_epi64x(INT64_MIN);
+            const __m256i vector = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(keys)), sign);
+            const __m256i searchKey = _mm256_xor_si256(_mm256_set1_epi64x(static_cast<long long>(key)), sign);
+            return static_cast<std::uint64_t>(_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(searchKey, vector))));
+        }
+
+        static std::uint64_t lessMask(const Key *keys, const Key &key, std::integral_constant<std::size_t, 4>) {
+            const __m256i sign = _mm256_set1_epi32(INT32_MIN);
+            const __m256i vector = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(keys)), sign);
+            const __m256i searchKey = _mm256_xor_si256(_mm256_set1_epi32(static_cast<int>(key)), sign);
+            return static_cast<std::uint64_t>(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(searchKey, vector))));
+        }
+#endif
+#endif
+    };
+}
+
+#endif
@@ -0,0 +1,193 @@
+#ifndef SMO_HPP
+#define SMO_HPP
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <cstdint>
+#include <cassert>
+#include "nodes.hpp"
+
+namespace BwTree {
+
+    enum class SMOReason : std::uint8_t {
+        consolidate,
+        split
+    };
+
+    struct SMOHint {
+        PID pid;
+        PID parent;
+        SMOReason reason;
+        std::chrono::steady_clock::time_point queued;
+    };
+
+    struct SMOStatistics {
+        std::size_t queueDepth;
+        std::size_t maxQueueDepth;
+        unsigned long enqueued;
+        unsigned long deduplicated;
+        unsigned long executedInline; // queue was full
+        unsigned long executed;
+        unsigned long stale; // page was already consolidated or split when the hint was executed
+        unsigned long totalLatencyNs; // from hint to execution
+        unsigned long maxLatencyNs;
+    };
+
+    /**
+    * Bounded lock free multi producer multi consumer queue of structure modification hints.
+    *
+    * Hints for a page which is already queued are dropped. The pending set is a fixed size table of flags indexed by a hash
+    * of (PID, reason), a collision drops a hint as well. This is fine for hints, the page will be reported again by the next
+    * operation which walks its delta chain.
+    */
+    class SMOQueue {
+        struct Cell {
+            std::atomic<std::size_t> sequence;
+            SMOHint hint;
+        };
+
+        static constexpr std::size_t pendingSize = 1 << 16;
+
+        const std::size_t mask;
+        std::unique_ptr<Cell[]> buffer;
+        std::unique_ptr<std::atomic<bool>[]> pending;
+
+        // producers and consumers work on different cache lines
+        char padding0[64];
+        std::atomic<std::size_t> enqueuePos{0};
+        char padding1[64];
+        std::atomic<std::size_t> dequeuePos{0};
+        char padding2[64];
+
+        std::atomic<unsigned long> enqueued{0};
+        std::atomic<unsigned long> deduplicated{0};
+        std::atomic<unsigned long> executedInline{0};
+        std::atomic<std::size_t> maxQueueDepth{0};
+        char padding3[64];
+        std::atomic<unsigned long> executed{0};
+        std::atomic<unsigned long> stale{0};
+        std::atomic<unsigned long> totalLatencyNs{0};
+        std::atomic<unsigned long> maxLatencyNs{0};
+
+        static std::size_t pendingSlot(PID pid, SMOReason reason) {
+            std::uint64_t h = (static_cast<std::uint64_t>(pid) << 1 | static_cast<std::uint64_t>(reason)) * 0x9E3779B97F4A7C15ull;
+            return h >> (64 - 16);
+        }
+
+        template<typename T>
+        static void updateMax(std::atomic<T> &max, T value) {
+            T cur = max.load(std::memory_order_relaxed);
+            while (cur < value && !max.compare_exchange_weak(cur, value, std::memory_order_relaxed)) {
+            }
+        }
+
+    public:
+        /**
+        * capacity has to be a power of two
+        */
+        SMOQueue(std::size_t capacity) : mask(capacity - 1), buffer(new Cell[capacity]), pending(new std::atomic<bool>[pendingSize]) {
+            assert((capacity & mask) == 0);
+            for (std::size_t i = 0; i < capacity; ++i) {
+                buffer[i].sequence.store(i, std::memory_order_relaxed);
+            }
+            for (std::size_t i = 0; i < pendingSize; ++i) {
+                pending[i].store(false, std::memory_order_relaxed);
+            }
+        }
+
+        enum class PushResult {
+            queued,
+            duplicate,
+            full
+        };
+
+        PushResult push(PID pid, PID parent, SMOReason reason) {
+            std::atomic<bool> &pendingFlag = pending[pendingSlot(pid, reason)];
+            if (pendingFlag.load(std::memory_order_relaxed) || pendingFlag.exchange(true)) {
+                deduplicated.fetch_add(1, std::memory_order_relaxed);
+                return PushResult::duplicate;
+            }
+            std::size_t pos = enqueuePos.load(std::memory_order_relaxed);
+            Cell *cell;
+            while (true) {
+                cell = &buffer[pos & mask];
+                std::size_t seq = cell->sequence.load(std::memory_order_acquire);
+                std::intptr_t diff = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos);
+                if (diff == 0) {
+                    if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                        break;
+                    }
+                } else if (diff < 0) {
+                    pendingFlag.store(false);
+                    executedInline.fetch_add(1, std::memory_order_relaxed);
+                    return PushResult::full;
+                } else {
+                    pos = enqueuePos.load(std::memory_order_relaxed);
+                }
+            }
+            cell->hint.pid = pid;
+            cell->hint.parent = parent;
+            cell->hint.reason = reason;
+            cell->hint.queued = std::chrono::steady_clock::now();
+            cell->sequence.store(pos + 1, std::memory_order_release);
+            enqueued.fetch_add(1, std::memory_order_relaxed);
+            updateMax(maxQueueDepth, size());
+            return PushResult::queued;
+        }
+
+        /**
+        * returns false if the queue is empty. The hint is removed from the pending set,
+        * so the page can be reported again while the hint is executed.
+        */
+        bool pop(SMOHint &hint) {
+            std::size_t pos = dequeuePos.load(std::memory_order_relaxed);
+            Cell *cell;
+            while (true) {
+                cell = &buffer[pos & mask];
+                std::size_t seq = cell->sequence.load(std::memory_order_acquire);
+                std::intptr_t diff = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos + 1);
+                if (diff == 0) {
+                    if (dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                        break;
+                    }
+                } else if (diff < 0) {
+                    return false;
+                } else {
+                    pos = dequeuePos.load(std::memory_order_relaxed);
+                }
+            }
+            hint = cell->hint;
+            cell->sequence.store(pos + mask + 1, std::memory_order_release);
+            pending[pendingSlot(hint.pid, hint.reason)].store(false);
+            return true;
+        }
+
+        void markExecuted(const SMOHint &hint, bool wasStale) {
+            unsigned long latency = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - hint.queued).count();
+            executed.fetch_add(1, std::memory_order_relaxed);
+            if (wasStale) {
+                stale.fetch_add(1, std::memory_order_relaxed);
+            }
+            totalLatencyNs.fetch_add(latency, std::memory_order_relaxed);
+            updateMax(maxLatencyNs, latency);
+        }
+
+        std::size_t capacity() const {
+            return mask + 1;
+        }
+
+        std::size_t size() const {
+            std::size_t enqueue = enqueuePos.load(std::memory_order_relaxed);
+            std::size_t dequeue = dequeuePos.load(std::memory_order_relaxed);
+            return enqueue > dequeue ? enqueue - dequeue : 0;
+        }
+
+        SMOStatistics getStatistics() const {
+            return SMOStatistics{size(), maxQueueDepth.load(), enqueued.load(), deduplicated.load(), executedInline.load(),
+                                 executed.load(), stale.load(), totalLatencyNs.load(), maxLatencyNs.load()};
+        }
+    };
+}
+
+#endif
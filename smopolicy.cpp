@@ -0,0 +1,108 @@
+#include <algorithm>
+#include <cmath>
+#include "smopolicy.hpp"
+
+namespace BwTree {
+
+    SMOPolicy::SMOPolicy(std::size_t splitLeaf, const std::vector<std::size_t> &splitInner, std::size_t consolidateLeaf, const std::vector<std::size_t> &consolidateInner)
+            : configuredSplitLimitLeaf(splitLeaf), configuredConsolidateLimitLeaf(consolidateLeaf),
+              splitLimitLeaf(splitLeaf), consolidateLimitLeaf(consolidateLeaf) {
+        for (unsigned level = 0; level < maxLevels; ++level) {
+            configuredSplitLimitInner[level] = level < splitInner.size() ? splitInner[level] : splitInner.back();
+            configuredConsolidateLimitInner[level] = level < consolidateInner.size() ? consolidateInner[level] : consolidateInner.back();
+            splitLimitInner[level].store(configuredSplitLimitInner[level], std::memory_order_relaxed);
+            consolidateLimitInner[level].store(configuredConsolidateLimitInner[level], std::memory_order_relaxed);
+        }
+    }
+
+    namespace {
+        struct LocalStatistics {
+            const AdaptiveSMOPolicy *policy = nullptr;
+            AdaptiveSMOPolicy::Statistics statistics;
+        };
+
+        /**
+        * moves current halfway to target, target is kept within [configured / 2, configured * 4] and not below minimum or configured
+        */
+        std::size_t approach(std::size_t current, double target, std::size_t configured, std::size_t minimum) {
+            const double lower = std::max<double>(std::min(minimum, configured), configured / 2.0);
+            const double upper = std::max<double>(lower, configured * 4.0);
+            target = std::min(upper, std::max(lower, target));
+            const double next = (current + target) / 2;
+            // rounded towards target, so a limit one below or above its target still moves
+            return static_cast<std::size_t>(target < current ? std::floor(next) : std::ceil(next));
+        }
+    }
+
+    AdaptiveSMOPolicy::Statistics &AdaptiveSMOPolicy::localStatistics() {
+        static thread_local LocalStatistics local;
+        if (local.policy != this) {
+            // the thread switched to another tree, its observations of the last one are dropped
+            local = LocalStatistics();
+            local.policy = this;
+        }
+        return local.statistics;
+    }
+
+    void AdaptiveSMOPolicy::observeSMOBacklog(std::size_t depth, std::size_t capacity) {
+        Statistics &local = localStatistics();
+        local.smoHints++;
+        if (2 * depth > capacity) {
+            local.backloggedSMOHints++;
+        }
+    }
+
+    void AdaptiveSMOPolicy::observeRead() {
+        Statistics &local = localStatistics();
+        local.reads++;
+        observed(local);
+    }
+
+    void AdaptiveSMOPolicy::observeUpdate(bool success) {
+        Statistics &local = localStatistics();
+        local.updates++;
+        if (!success) {
+            local.failedUpdates++;
+        }
+        observed(local);
+    }
+
+    void AdaptiveSMOPolicy::observed(Statistics &local) {
+        if (local.reads + local.updates < foldInterval) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(adaptMutex);
+        shared.reads += local.reads;
+        shared.updates += local.updates;
+        shared.failedUpdates += local.failedUpdates;
+        shared.smoHints += local.smoHints;
+        shared.backloggedSMOHints += local.backloggedSMOHints;
+        sharedObservations += local.reads + local.updates;
+        local = Statistics();
+        if (sharedObservations >= adaptInterval) {
+            adapt(shared);
+            shared = Statistics();
+            sharedObservations = 0;
+        }
+    }
+
+    void AdaptiveSMOPolicy::adapt(const Statistics &statistics) {
+        const double operations = statistics.reads + statistics.updates;
+        const double writeRatio = operations > 0 ? statistics.updates / operations : 0.0;
+        const double failureRate = statistics.updates > 0 ? static_cast<double>(statistics.failedUpdates) / statistics.updates : 0.0;
+        // the backlog is a property of the queue, not of the limits, so it cannot ratchet them up like the chain lengths would
+        const double backlogRate = statistics.smoHints > 0 ? static_cast<double>(statistics.backloggedSMOHints) / statistics.smoHints : 0.0;
+        const double consolidateFactor = (0.5 + writeRatio) * (1.0 + 4.0 * failureRate) * (1.0 + backlogRate);
+        const double splitFactor = 1.0 - std::min(0.5, 2.0 * failureRate);
+
+        consolidateLimitLeaf.store(approach(consolidateLimitLeaf.load(std::memory_order_relaxed), configuredConsolidateLimitLeaf * consolidateFactor, configuredConsolidateLimitLeaf, 2), std::memory_order_relaxed);
+        splitLimitLeaf.store(approach(splitLimitLeaf.load(std::memory_order_relaxed), configuredSplitLimitLeaf * splitFactor, configuredSplitLimitLeaf, 8), std::memory_order_relaxed);
+
+        for (unsigned level = 0; level < maxLevels; ++level) {
+            consolidateLimitInner[level].store(approach(consolidateLimitInner[level].load(std::memory_order_relaxed), configuredConsolidateLimitInner[level] * consolidateFactor,
+                                                        configuredConsolidateLimitInner[level], 2), std::memory_order_relaxed);
+            splitLimitInner[level].store(approach(splitLimitInner[level].load(std::memory_order_relaxed), configuredSplitLimitInner[level] * splitFactor, configuredSplitLimitInner[level], 8), std::memory_order_relaxed);
+        }
+        adaptions.fetch_add(1, std::memory_order_relaxed);
+    }
+}
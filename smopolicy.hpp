@@ -0,0 +1,170 @@
+#ifndef SMOPOLICY_HPP
+#define SMOPOLICY_HPP
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace BwTree {
+
+    enum class SMOPolicyType : std::uint8_t {
+        fixed,
+        adaptive
+    };
+
+    /**
+    * Decides when a page is consolidated or split.
+    *
+    * The tree reads the current limits on every page it walks and reports what it observes through the observe functions.
+    * The limits are atomics so a policy can change them at runtime, levels of inner nodes are counted from the root,
+    * levels deeper than the configured ones use the limits of the last configured level.
+    */
+    class SMOPolicy {
+    public:
+        static constexpr unsigned maxLevels = 8;
+
+        SMOPolicy(std::size_t splitLeaf, const std::vector<std::size_t> &splitInner, std::size_t consolidateLeaf, const std::vector<std::size_t> &consolidateInner);
+
+        virtual ~SMOPolicy() { }
+
+        std::size_t getSplitLimitLeaf() const {
+            return splitLimitLeaf.load(std::memory_order_relaxed);
+        }
+
+        std::size_t getSplitLimitInner(unsigned level) const {
+            return splitLimitInner[levelIndex(level)].load(std::memory_order_relaxed);
+        }
+
+        std::size_t getConsolidateLimitLeaf() const {
+            return consolidateLimitLeaf.load(std::memory_order_relaxed);
+        }
+
+        std::size_t getConsolidateLimitInner(unsigned level) const {
+            return consolidateLimitInner[levelIndex(level)].load(std::memory_order_relaxed);
+        }
+
+        /**
+        * Inner pages are seen by every operation below them, only some of the threads which see a page above its limits
+        * try to consolidate or split it, less the closer the page is to the root.
+        */
+        bool tryInnerConsolidate(unsigned level) const {
+            return chance(40 + level);
+        }
+
+        bool tryInnerSplit(unsigned level) const {
+            return chance(30 + level * 5);
+        }
+
+        /**
+        * one SMO hint handed to the SMO workers, depth hints of capacity were queued after it, a full queue reports capacity
+        */
+        virtual void observeSMOBacklog(std::size_t, std::size_t) { }
+
+        virtual void observeRead() { }
+
+        /**
+        * one attempt to install a delta of a write operation, success is false if the CAS failed
+        */
+        virtual void observeUpdate(bool) { }
+
+        /**
+        * every thread draws from its own generator
+        */
+        static std::uint64_t random() {
+            static thread_local std::uint64_t state = reinterpret_cast<std::uintptr_t>(&state) | 1;
+            // xorshift64
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            return state;
+        }
+
+        /**
+        * true with the given probability in percent
+        */
+        static bool chance(unsigned percent) {
+            return random() % 100 < percent;
+        }
+
+    protected:
+        const std::size_t configuredSplitLimitLeaf;
+        const std::size_t configuredConsolidateLimitLeaf;
+        std::size_t configuredSplitLimitInner[maxLevels];
+        std::size_t configuredConsolidateLimitInner[maxLevels];
+
+        std::atomic<std::size_t> splitLimitLeaf;
+        std::atomic<std::size_t> consolidateLimitLeaf;
+        std::atomic<std::size_t> splitLimitInner[maxLevels];
+        std::atomic<std::size_t> consolidateLimitInner[maxLevels];
+
+        static unsigned levelIndex(unsigned level) {
+            return level < maxLevels ? level : maxLevels - 1;
+        }
+    };
+
+    /**
+    * uses the limits of the Settings
+    */
+    class FixedSMOPolicy : public SMOPolicy {
+    public:
+        using SMOPolicy::SMOPolicy;
+    };
+
+    /**
+    * Adapts the limits to the workload, starting from the limits of the Settings.
+    *
+    * Every thread counts its observations locally and adds them to the shared statistics every foldInterval observations.
+    * Once the shared statistics cover adaptInterval observations, the thread which folded them recomputes the limits:
+    * - consolidation limits shrink for read mostly workloads, which pay for every delta on each search, and grow for write
+    *   mostly workloads and when delta installations fail often, so fewer consolidations compete with the writers.
+    *   They also grow while the SMO queue is more than half full, the workers do not keep up then. Fewer consolidations
+    *   drain the queue, so the backlog stops raising the limits again.
+    * - split limits shrink when delta installations fail often, smaller pages spread the writers over more pages.
+    * The limits stay between half and four times the configured limits and move halfway to their target per adaption.
+    */
+    class AdaptiveSMOPolicy : public SMOPolicy {
+        static constexpr unsigned long foldInterval = 1024;
+        static constexpr unsigned long adaptInterval = 1 << 16;
+
+    public:
+        struct Statistics {
+            unsigned long reads = 0;
+            unsigned long updates = 0;
+            unsigned long failedUpdates = 0;
+            unsigned long smoHints = 0;
+            // hints which found the SMO queue more than half full
+            unsigned long backloggedSMOHints = 0;
+        };
+
+        using SMOPolicy::SMOPolicy;
+
+        void observeSMOBacklog(std::size_t depth, std::size_t capacity) override;
+
+        void observeRead() override;
+
+        void observeUpdate(bool success) override;
+
+        /**
+        * number of times the limits were recomputed
+        */
+        unsigned long getAdaptions() const {
+            return adaptions.load(std::memory_order_relaxed);
+        }
+
+    private:
+        std::mutex adaptMutex;
+        Statistics shared;
+        unsigned long sharedObservations = 0;
+        std::atomic<unsigned long> adaptions{0};
+
+        Statistics &localStatistics();
+
+        void observed(Statistics &local);
+
+        void adapt(const Statistics &statistics);
+    };
+}
+
+#endif
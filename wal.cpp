@@ -0,0 +1,306 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <system_error>
+#include "wal.hpp"
+#include "fileio.hpp"
+
+namespace BwTree {
+
+    namespace {
+        /**
+        * Every record starts with this header, followed by the key and the value and padded to 8 bytes.
+        * The checksum covers the rest of the header and the payload, it is computed by the log writer.
+        */
+        struct RecordHeader {
+            std::uint32_t checksum;
+            std::uint16_t keySize;
+            std::uint16_t valueSize;
+            std::uint64_t lsn;
+            WALRecordType type;
+            std::uint8_t padding[7];
+        };
+
+        static_assert(sizeof(RecordHeader) == 24, "the record header is part of the file format");
+
+        // size of the reads when a log is scanned
+        constexpr std::size_t readSize = 8 * 1024 * 1024;
+
+        constexpr std::size_t recordSize(std::uint32_t keySize, std::uint32_t valueSize) {
+            return (sizeof(RecordHeader) + keySize + valueSize + 7) & ~static_cast<std::size_t>(7);
+        }
+
+        std::uint32_t recordChecksum(const char *record) {
+            const RecordHeader *header = reinterpret_cast<const RecordHeader *>(record);
+            const std::size_t size = sizeof(RecordHeader) + header->keySize + header->valueSize;
+            return crc32c(record + sizeof(header->checksum), size - sizeof(header->checksum));
+        }
+
+        void copyToRing(char *buffer, std::uint64_t position, const void *data, std::size_t size) {
+            const std::size_t offset = position % WriteAheadLog::bufferSize;
+            const std::size_t first = std::min(size, WriteAheadLog::bufferSize - offset);
+            std::memcpy(buffer + offset, data, first);
+            std::memcpy(buffer, static_cast<const char *>(data) + first, size - first);
+        }
+    }
+
+    WriteAheadLog::WriteAheadLog(const std::string &path, WALSyncPolicy policy, std::chrono::microseconds syncInterval, std::size_t maxThreads)
+            : path(path), policy(policy), syncInterval(syncInterval), maxSlots(maxThreads), slots(new Slot[maxThreads]) {
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        if (fd < 0) {
+            const int openError = errno;
+            delete[] slots;
+            throw std::system_error(openError, std::generic_category(), "BwTree::WriteAheadLog " + path);
+        }
+        try {
+            end = scan(0, nullptr, &maxLSN);
+            // a record torn by a crash is dropped, new records follow the last valid one
+            if (::ftruncate(fd, end) != 0) {
+                throw std::system_error(errno, std::generic_category(), "BwTree::WriteAheadLog " + path);
+            }
+        } catch (...) {
+            ::close(fd);
+            delete[] slots;
+            throw;
+        }
+        writer = std::thread(&WriteAheadLog::runWriter, this);
+    }
+
+    WriteAheadLog::~WriteAheadLog() {
+        {
+            std::lock_guard<std::mutex> lock(writerMutex);
+            writerStop = true;
+        }
+        writerWakeup.notify_one();
+        writer.join();
+        writeRecords(true);
+        ::close(fd);
+        for (std::size_t i = 0; i < maxSlots; ++i) {
+            delete[] slots[i].buffer.load();
+        }
+        delete[] slots;
+    }
+
+    std::uint64_t WriteAheadLog::append(std::size_t slot, std::uint64_t lsn, WALRecordType type, const void *key, std::uint32_t keySize,
+                                        const void *value, std::uint32_t valueSize) {
+        Slot &s = slots[slot];
+        char *buffer = s.buffer.load(std::memory_order_relaxed);
+        if (buffer == nullptr) {
+            // the buffer is published before the slot count, so the log writer finds it once it looks at the slot
+            buffer = new char[bufferSize];
+            s.buffer.store(buffer, std::memory_order_release);
+            std::size_t count = slotCount.load();
+            while (count <= slot && !slotCount.compare_exchange_weak(count, slot + 1)) { }
+        }
+        const std::uint64_t head = s.head.load(std::memory_order_relaxed);
+        const std::size_t size = recordSize(keySize, valueSize);
+        while (head + size - s.cachedTail > bufferSize) {
+            s.cachedTail = s.tail.load(std::memory_order_acquire);
+            if (head + size - s.cachedTail <= bufferSize) {
+                break;
+            }
+            // the buffer is full, the records are taken by the log writer unless it failed
+            if (error.load() != 0) {
+                return head;
+            }
+            {
+                std::lock_guard<std::mutex> lock(writerMutex);
+                commitRequested = true;
+            }
+            writerWakeup.notify_one();
+            std::this_thread::yield();
+        }
+        RecordHeader header;
+        std::memset(&header, 0, sizeof(header));
+        header.keySize = static_cast<std::uint16_t>(keySize);
+        header.valueSize = static_cast<std::uint16_t>(valueSize);
+        header.lsn = lsn;
+        header.type = type;
+        copyToRing(buffer, head, &header, sizeof(header));
+        copyToRing(buffer, head + sizeof(header), key, keySize);
+        copyToRing(buffer, head + sizeof(header) + keySize, value, valueSize);
+        s.head.store(head + size, std::memory_order_release);
+        return head + size;
+    }
+
+    void WriteAheadLog::commit(std::size_t slot, std::uint64_t end) {
+        if (policy != WALSyncPolicy::commit) {
+            return;
+        }
+        Slot &s = slots[slot];
+        if (s.synced.load(std::memory_order_acquire) >= end) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(writerMutex);
+            commitRequested = true;
+        }
+        writerWakeup.notify_one();
+        std::unique_lock<std::mutex> lock(waitersMutex);
+        waitersWakeup.wait(lock, [&]() {
+            return s.synced.load(std::memory_order_acquire) >= end || error.load() != 0;
+        });
+        throwIfFailed();
+    }
+
+    std::uint64_t WriteAheadLog::position() {
+        // records are only taken under the mutex, everything appended later is written behind the current end
+        std::lock_guard<std::mutex> lock(writeMutex);
+        return end;
+    }
+
+    std::uint64_t WriteAheadLog::flush() {
+        const std::uint64_t result = writeRecords(true);
+        throwIfFailed();
+        return result;
+    }
+
+    void WriteAheadLog::read(std::uint64_t from, const Consumer &consumer) {
+        scan(from, &consumer, nullptr);
+    }
+
+    std::uint64_t WriteAheadLog::scan(std::uint64_t from, const Consumer *consumer, std::uint64_t *maxLSN) {
+        struct stat fileStat;
+        if (::fstat(fd, &fileStat) != 0) {
+            throw std::system_error(errno, std::generic_category(), "BwTree::WriteAheadLog " + path);
+        }
+        const std::uint64_t fileSize = static_cast<std::uint64_t>(fileStat.st_size);
+        std::vector<char> chunk;
+        std::uint64_t chunkStart = from;
+        // makes the bytes [position, position + size) available in chunk, false if the file ends before
+        auto ensure = [&](std::uint64_t position, std::size_t size) {
+            if (position + size <= chunkStart + chunk.size()) {
+                return true;
+            }
+            if (position + size > fileSize) {
+                return false;
+            }
+            chunk.erase(chunk.begin(), chunk.begin() + (position - chunkStart));
+            chunkStart = position;
+            const std::size_t have = chunk.size();
+            const std::size_t count = std::min<std::uint64_t>(std::max(size - have, readSize), fileSize - (chunkStart + have));
+            chunk.resize(have + count);
+            int readError;
+            if (!readAll(fd, chunk.data() + have, count, chunkStart + have, readError)) {
+                if (readError != 0) {
+                    throw std::system_error(readError, std::generic_category(), "BwTree::WriteAheadLog " + path);
+                }
+                chunk.resize(have);
+                return false;
+            }
+            return true;
+        };
+
+        std::uint64_t position = from;
+        while (ensure(position, sizeof(RecordHeader))) {
+            RecordHeader header;
+            std::memcpy(&header, chunk.data() + (position - chunkStart), sizeof(header));
+            if (header.keySize == 0 || (header.type != WALRecordType::insert && header.type != WALRecordType::remove)) {
+                break;
+            }
+            const std::size_t size = recordSize(header.keySize, header.valueSize);
+            if (!ensure(position, size)) {
+                break;
+            }
+            const char *record = chunk.data() + (position - chunkStart);
+            if (recordChecksum(record) != header.checksum) {
+                break;
+            }
+            if (consumer != nullptr) {
+                const char *key = record + sizeof(RecordHeader);
+                (*consumer)(position, header.lsn, header.type, key, header.keySize, key + header.keySize, header.valueSize);
+            }
+            if (maxLSN != nullptr) {
+                *maxLSN = std::max(*maxLSN, header.lsn);
+            }
+            position += size;
+        }
+        return position;
+    }
+
+    std::uint64_t WriteAheadLog::writeRecords(bool sync) {
+        std::lock_guard<std::mutex> lock(writeMutex);
+        if (error.load() != 0) {
+            return end;
+        }
+        const std::size_t count = slotCount.load();
+        takenHeads.assign(count, 0);
+        writeBuffer.clear();
+        for (std::size_t i = 0; i < count; ++i) {
+            Slot &s = slots[i];
+            const char *buffer = s.buffer.load(std::memory_order_acquire);
+            if (buffer == nullptr) {
+                continue;
+            }
+            const std::uint64_t head = s.head.load(std::memory_order_acquire);
+            std::uint64_t tail = s.tail.load(std::memory_order_relaxed);
+            while (tail != head) {
+                // records wrap around the end of the ring, so they are copied in up to two parts
+                const std::size_t offset = tail % bufferSize;
+                const std::size_t size = std::min<std::uint64_t>(head - tail, bufferSize - offset);
+                writeBuffer.insert(writeBuffer.end(), buffer + offset, buffer + offset + size);
+                tail += size;
+            }
+            takenHeads[i] = head;
+            // the records are copied, the appending thread may reuse their space
+            s.tail.store(head, std::memory_order_release);
+        }
+        for (std::size_t offset = 0; offset < writeBuffer.size();) {
+            char *record = writeBuffer.data() + offset;
+            RecordHeader *header = reinterpret_cast<RecordHeader *>(record);
+            header->checksum = recordChecksum(record);
+            offset += recordSize(header->keySize, header->valueSize);
+        }
+
+        try {
+            if (!writeBuffer.empty()) {
+                writeAll(fd, writeBuffer.data(), writeBuffer.size(), end, "BwTree::WriteAheadLog " + path);
+                end += writeBuffer.size();
+            }
+            if (sync && ::fdatasync(fd) != 0) {
+                throw std::system_error(errno, std::generic_category(), "BwTree::WriteAheadLog " + path);
+            }
+        } catch (const std::system_error &e) {
+            error.store(e.code().value() != 0 ? e.code().value() : EIO);
+        }
+        if (sync && error.load() == 0) {
+            for (std::size_t i = 0; i < count; ++i) {
+                if (takenHeads[i] != 0) {
+                    slots[i].synced.store(takenHeads[i], std::memory_order_release);
+                }
+            }
+        }
+        {
+            // waiters check their condition under this mutex, so none misses the notification
+            std::lock_guard<std::mutex> waitersLock(waitersMutex);
+        }
+        waitersWakeup.notify_all();
+        return end;
+    }
+
+    void WriteAheadLog::runWriter() {
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(writerMutex);
+                writerWakeup.wait_for(lock, syncInterval, [this]() {
+                    return commitRequested || writerStop;
+                });
+                if (writerStop) {
+                    return;
+                }
+                commitRequested = false;
+            }
+            writeRecords(policy != WALSyncPolicy::none);
+        }
+    }
+
+    void WriteAheadLog::throwIfFailed() {
+        const int failure = error.load();
+        if (failure != 0) {
+            throw std::system_error(failure, std::generic_category(), "BwTree::WriteAheadLog " + path);
+        }
+    }
+}
@@ -0,0 +1,163 @@
+#ifndef WAL_HPP
+#define WAL_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace BwTree {
+
+    enum class WALSyncPolicy {
+        // records are written every sync interval, the operating system decides when they reach the disk
+        none,
+        // records are written and synced every sync interval, operations do not wait for it
+        interval,
+        // operations return once their record is synced, the records of all threads waiting meanwhile are synced together
+        commit
+    };
+
+    enum class WALRecordType : std::uint8_t {
+        insert = 1,
+        remove = 2
+    };
+
+    /**
+    * Write ahead log with group commit.
+    *
+    * Every thread appends its records to its own ring buffer, selected by the slot of its ThreadInfo, which it shares
+    * only with the log writer. Appending copies the record and publishes the new end of the buffer, nothing else.
+    * The log writer, a background thread or a thread calling flush, takes the records of all buffers at once, writes them
+    * with one write at the end of the file and syncs it depending on the policy.
+    *
+    * A record is identified by its position in the file. Records are not ordered by their position across threads,
+    * their LSNs give the order of the modifications of a key. Opening a log drops a torn record at its end.
+    */
+    class WriteAheadLog {
+    public:
+        static constexpr std::size_t bufferSize = 1024 * 1024;
+
+        /**
+        * called for every record with its position, the payload is the key followed by the value
+        */
+        using Consumer = std::function<void(std::uint64_t position, std::uint64_t lsn, WALRecordType type,
+                                            const char *key, std::uint32_t keySize, const char *value, std::uint32_t valueSize)>;
+
+        /**
+        * opens or creates the log at path, throws std::system_error on I/O errors
+        */
+        WriteAheadLog(const std::string &path, WALSyncPolicy policy, std::chrono::microseconds syncInterval, std::size_t maxThreads);
+
+        WriteAheadLog(const WriteAheadLog &) = delete;
+
+        WriteAheadLog &operator=(const WriteAheadLog &) = delete;
+
+        /**
+        * writes and syncs all appended records
+        */
+        ~WriteAheadLog();
+
+        /**
+        * Appends a record to the buffer of the slot, only one thread at a time may append to a slot.
+        * Returns the end of the record in the buffer, commit waits for it. Does not throw, once the log failed a record
+        * which does not fit into the buffer anymore is dropped, writers check throwIfFailed before they append.
+        */
+        std::uint64_t append(std::size_t slot, std::uint64_t lsn, WALRecordType type, const void *key, std::uint32_t keySize,
+                             const void *value, std::uint32_t valueSize);
+
+        /**
+        * with WALSyncPolicy::commit waits until the records of the slot up to end are synced, returns immediately otherwise.
+        * Throws std::system_error if the log could not be written.
+        */
+        void commit(std::size_t slot, std::uint64_t end);
+
+        /**
+        * all records appended from now on are written at this position or behind
+        */
+        std::uint64_t position();
+
+        /**
+        * writes and syncs all records appended so far, returns the end of the file
+        */
+        std::uint64_t flush();
+
+        /**
+        * passes all records from position from on to consumer in the order of the file
+        */
+        void read(std::uint64_t from, const Consumer &consumer);
+
+        /**
+        * throws std::system_error if a write or sync of the log failed, no records are written after it
+        */
+        void throwIfFailed();
+
+        /**
+        * the highest LSN of the records which were in the file when it was opened
+        */
+        std::uint64_t getMaxLSN() const {
+            return maxLSN;
+        }
+
+    private:
+        struct Slot {
+            char padding0[64];
+            // end of the appended records, only written by the appending thread
+            std::atomic<std::uint64_t> head{0};
+            // tail as last seen by the appending thread
+            std::uint64_t cachedTail = 0;
+            char padding1[64];
+            // end of the records taken by the log writer
+            std::atomic<std::uint64_t> tail{0};
+            // end of the records which are synced
+            std::atomic<std::uint64_t> synced{0};
+            std::atomic<char *> buffer{nullptr};
+            char padding2[64];
+        };
+
+        const std::string path;
+        const WALSyncPolicy policy;
+        const std::chrono::microseconds syncInterval;
+        const std::size_t maxSlots;
+        Slot *const slots;
+        // slots above have never been appended to
+        std::atomic<std::size_t> slotCount{0};
+        int fd;
+        std::uint64_t maxLSN = 0;
+
+        // held while records are taken and written, end only changes under it
+        std::mutex writeMutex;
+        std::uint64_t end = 0;
+        std::vector<char> writeBuffer;
+        std::vector<std::uint64_t> takenHeads;
+        // errno of the first failed write or sync, the log is not written anymore after it
+        std::atomic<int> error{0};
+
+        std::mutex writerMutex;
+        std::condition_variable writerWakeup;
+        bool commitRequested = false;
+        bool writerStop = false;
+        std::mutex waitersMutex;
+        std::condition_variable waitersWakeup;
+        std::thread writer;
+
+        /**
+        * returns the end of the valid records, records are read from the file in chunks
+        */
+        std::uint64_t scan(std::uint64_t from, const Consumer *consumer, std::uint64_t *maxLSN);
+
+        /**
+        * takes the records of all slots and writes them, syncs them if sync is set. Returns the end of the file.
+        */
+        std::uint64_t writeRecords(bool sync);
+
+        void runWriter();
+    };
+}
+
+#endif
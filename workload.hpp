@@ -0,0 +1,232 @@
+#ifndef WORKLOAD_HPP
+#define WORKLOAD_HPP
+
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+#include "main.hpp"
+
+/**
+* YCSB style workloads (Cooper et al., Benchmarking Cloud Serving Systems with YCSB).
+*
+* Records are numbered in insertion order, record i has the key ycsbKey(i). The key of a record is a bijective hash
+* of its number like the default hashed insert order of YCSB, so the hot records of skewed distributions are spread over the leaves.
+*/
+enum class KeyDistribution : std::uint8_t {
+    uniform,
+    zipfian,
+    // zipfian, the popular records are scattered over all records instead of being the first ones
+    scrambledZipfian,
+    // zipfian over the age of the records, the most recently inserted ones are the most popular
+    latest,
+    // hotOperationFraction of the operations go to the first hotSetFraction of the records
+    hotspot
+};
+
+inline const char *keyDistributionName(KeyDistribution distribution) {
+    switch (distribution) {
+        case KeyDistribution::uniform:
+            return "uniform";
+        case KeyDistribution::zipfian:
+            return "zipfian";
+        case KeyDistribution::scrambledZipfian:
+            return "scrambled";
+        case KeyDistribution::latest:
+            return "latest";
+        case KeyDistribution::hotspot:
+            return "hotspot";
+    }
+    return "unknown";
+}
+
+/**
+* returns false if name is no distribution
+*/
+inline bool parseKeyDistribution(const std::string &name, KeyDistribution &distribution) {
+    for (KeyDistribution candidate : {KeyDistribution::uniform, KeyDistribution::zipfian, KeyDistribution::scrambledZipfian, KeyDistribution::latest, KeyDistribution::hotspot}) {
+        if (name == keyDistributionName(candidate)) {
+            distribution = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+* Operation mix of a workload in percent, scans read up to maxScanLength records.
+*/
+struct YcsbWorkload {
+    char name;
+    unsigned read;
+    unsigned update;
+    unsigned insert;
+    unsigned scan;
+    unsigned readModifyWrite;
+    KeyDistribution distribution;
+    std::size_t maxScanLength;
+};
+
+/**
+* the core workloads of YCSB
+*/
+inline const std::vector<YcsbWorkload> &ycsbWorkloads() {
+    static const std::vector<YcsbWorkload> workloads{{
+            {'A', 50, 50, 0, 0, 0, KeyDistribution::zipfian, 0},
+            {'B', 95, 5, 0, 0, 0, KeyDistribution::zipfian, 0},
+            {'C', 100, 0, 0, 0, 0, KeyDistribution::zipfian, 0},
+            {'D', 95, 0, 5, 0, 0, KeyDistribution::latest, 0},
+            {'E', 0, 0, 5, 95, 0, KeyDistribution::zipfian, 100},
+            {'F', 50, 0, 0, 0, 50, KeyDistribution::zipfian, 0}
+    }};
+    return workloads;
+}
+
+/**
+* key of record number i, a bijective 64 bit mix (finalizer of splitmix64)
+*/
+template<typename Key>
+Key ycsbKey(std::uint64_t i) {
+    i = (i ^ (i >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    i = (i ^ (i >> 27)) * 0x94d049bb133111ebULL;
+    return static_cast<Key>(i ^ (i >> 31));
+}
+
+/**
+* Zipfian distributed numbers in [0, items), 0 is the most popular one (Gray et al., Quickly Generating Billion-Record Synthetic Databases).
+* The number of items can grow, zeta is extended incrementally.
+*/
+class ZipfianGenerator {
+    const double theta;
+    const double alpha;
+    const double zeta2;
+    std::uint64_t items = 0;
+    double zetan = 0.0;
+    double eta = 0.0;
+    std::uniform_real_distribution<double> uniform{0.0, 1.0};
+
+public:
+    static constexpr double defaultTheta = 0.99;
+
+    ZipfianGenerator(std::uint64_t items, double theta = defaultTheta)
+            : theta(theta), alpha(1.0 / (1.0 - theta)), zeta2(1.0 + std::pow(0.5, theta)) {
+        grow(items);
+    }
+
+    void grow(std::uint64_t newItems) {
+        for (std::uint64_t i = items + 1; i <= newItems; ++i) {
+            zetan += 1.0 / std::pow(static_cast<double>(i), theta);
+        }
+        if (newItems > items) {
+            items = newItems;
+            eta = (1.0 - std::pow(2.0 / items, 1.0 - theta)) / (1.0 - zeta2 / zetan);
+        }
+    }
+
+    std::uint64_t getItems() const {
+        return items;
+    }
+
+    template<typename Random>
+    std::uint64_t next(Random &random) {
+        const double u = uniform(random);
+        const double uz = u * zetan;
+        if (uz < 1.0) {
+            return 0;
+        }
+        if (uz < zeta2) {
+            return 1;
+        }
+        const std::uint64_t value = static_cast<std::uint64_t>(items * std::pow(eta * u - eta + 1.0, alpha));
+        return value < items ? value : items - 1;
+    }
+};
+
+/**
+* Chooses the record number of the next read, update, scan or read-modify-write among the records inserted so far.
+*/
+class KeyChooser {
+    const KeyDistribution distribution;
+    ZipfianGenerator zipfian;
+
+public:
+    static constexpr double hotSetFraction = 0.2;
+    static constexpr double hotOperationFraction = 0.8;
+
+    KeyChooser(KeyDistribution distribution, std::uint64_t records) : distribution(distribution), zipfian(distribution == KeyDistribution::zipfian || distribution == KeyDistribution::scrambledZipfian || distribution == KeyDistribution::latest ? records : 0) {
+    }
+
+    /**
+    * records are the number of records inserted so far, at least 1
+    */
+    template<typename Random>
+    std::uint64_t next(Random &random, std::uint64_t records) {
+        switch (distribution) {
+            case KeyDistribution::uniform:
+                return std::uniform_int_distribution<std::uint64_t>(0, records - 1)(random);
+            case KeyDistribution::zipfian:
+                zipfian.grow(records);
+                return zipfian.next(random);
+            case KeyDistribution::scrambledZipfian:
+                zipfian.grow(records);
+                return ycsbKey<std::uint64_t>(zipfian.next(random)) % records;
+            case KeyDistribution::latest:
+                zipfian.grow(records);
+                return records - 1 - zipfian.next(random);
+            case KeyDistribution::hotspot: {
+                const std::uint64_t hotRecords = std::max<std::uint64_t>(1, static_cast<std::uint64_t>(records * hotSetFraction));
+                if (std::uniform_real_distribution<double>(0.0, 1.0)(random) < hotOperationFraction || hotRecords == records) {
+                    return std::uniform_int_distribution<std::uint64_t>(0, hotRecords - 1)(random);
+                }
+                return std::uniform_int_distribution<std::uint64_t>(hotRecords, records - 1)(random);
+            }
+        }
+        return 0;
+    }
+};
+
+/**
+* Generates the commands of operations operations of the workload for threads threads, after recordCount records have been loaded.
+* The operations are dealt round robin to the threads. keys gets the keys of the loaded records followed by those of the inserted ones,
+* it must not be resized as long as the commands are used, they point to their keys as data.
+*/
+template<typename Key>
+std::vector<std::vector<BwTreeCommand<Key, Key>>> createYcsbCommands(const YcsbWorkload &workload, KeyDistribution distribution, const std::size_t threads, const std::size_t recordCount, const std::size_t operations, std::vector<Key> &keys) {
+    std::default_random_engine random;
+    std::uniform_int_distribution<unsigned> percent(0, 99);
+    std::uniform_int_distribution<std::size_t> scanLength(1, workload.maxScanLength > 0 ? workload.maxScanLength : 1);
+    KeyChooser chooser(distribution, recordCount);
+
+    const std::size_t maxInserts = operations * workload.insert / 100 + operations / 100 + 1;
+    keys.resize(recordCount + maxInserts);
+    for (std::size_t i = 0; i < keys.size(); ++i) {
+        keys[i] = ycsbKey<Key>(i);
+    }
+
+    std::vector<std::vector<BwTreeCommand<Key, Key>>> commands(threads);
+    std::size_t records = recordCount;
+    for (std::size_t op_i = 0; op_i < operations; ++op_i) {
+        std::vector<BwTreeCommand<Key, Key>> &cmds = commands[op_i % threads];
+        unsigned choice = percent(random);
+        if (choice < workload.insert && records < keys.size()) {
+            cmds.push_back(BwTreeCommand<Key, Key>(BwTreeCommandType::insert, keys[records], &keys[records]));
+            records++;
+            continue;
+        }
+        choice -= std::min(choice, workload.insert);
+        const std::size_t record = chooser.next(random, records);
+        if (choice < workload.read) {
+            cmds.push_back(BwTreeCommand<Key, Key>(BwTreeCommandType::search, keys[record], nullptr));
+        } else if (choice < workload.read + workload.update) {
+            cmds.push_back(BwTreeCommand<Key, Key>(BwTreeCommandType::update, keys[record], &keys[record]));
+        } else if (choice < workload.read + workload.update + workload.scan) {
+            cmds.push_back(BwTreeCommand<Key, Key>(BwTreeCommandType::scan, keys[record], nullptr, scanLength(random)));
+        } else {
+            cmds.push_back(BwTreeCommand<Key, Key>(BwTreeCommandType::readModifyWrite, keys[record], nullptr));
+        }
+    }
+    return commands;
+}
+
+#endif